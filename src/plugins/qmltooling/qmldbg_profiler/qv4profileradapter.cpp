@@ -37,7 +37,7 @@
 QT_BEGIN_NAMESPACE
 
 QV4ProfilerAdapter::QV4ProfilerAdapter(QQmlProfilerService *service, QV4::ExecutionEngine *engine) :
-    QQmlAbstractProfilerAdapter(service), dataPos(0), memoryPos(0)
+    QQmlAbstractProfilerAdapter(service), dataPos(0), memoryPos(0), gcPos(0)
 {
     engine->enableProfiler();
     connect(this, SIGNAL(profilingEnabled(quint64)),
@@ -51,22 +51,45 @@ QV4ProfilerAdapter::QV4ProfilerAdapter(QQmlProfilerService *service, QV4::Execut
     connect(this, SIGNAL(referenceTimeKnown(QElapsedTimer)),
             engine->profiler, SLOT(setTimer(QElapsedTimer)));
     connect(engine->profiler, SIGNAL(dataReady(QVector<QV4::Profiling::FunctionCallProperties>,
-                                               QVector<QV4::Profiling::MemoryAllocationProperties>)),
+                                               QVector<QV4::Profiling::MemoryAllocationProperties>,
+                                               QVector<QV4::Profiling::GarbageCollectionProperties>)),
             this, SLOT(receiveData(QVector<QV4::Profiling::FunctionCallProperties>,
-                                   QVector<QV4::Profiling::MemoryAllocationProperties>)));
+                                   QVector<QV4::Profiling::MemoryAllocationProperties>,
+                                   QVector<QV4::Profiling::GarbageCollectionProperties>)));
 }
 
 qint64 QV4ProfilerAdapter::appendMemoryEvents(qint64 until, QList<QByteArray> &messages)
 {
     QByteArray message;
-    while (memory_data.length() > memoryPos && memory_data[memoryPos].timestamp <= until) {
-        QQmlDebugStream d(&message, QIODevice::WriteOnly);
-        QV4::Profiling::MemoryAllocationProperties &props = memory_data[memoryPos];
-        d << props.timestamp << MemoryAllocation << props.type << props.size;
-        ++memoryPos;
+    while (true) {
+        bool memoryPending = memory_data.length() > memoryPos
+                && memory_data[memoryPos].timestamp <= until;
+        bool gcPending = gc_data.length() > gcPos && gc_data[gcPos].timestamp <= until;
+        if (gcPending && (!memoryPending
+                          || gc_data[gcPos].timestamp <= memory_data[memoryPos].timestamp)) {
+            QQmlDebugStream d(&message, QIODevice::WriteOnly);
+            QV4::Profiling::GarbageCollectionProperties &props = gc_data[gcPos];
+            d << props.timestamp << GarbageCollection << props.markTime << props.sweepTime
+              << props.bytesFreed << props.unmanagedHeapSize << props.itemsInUse
+              << props.availableItems;
+            ++gcPos;
+        } else if (memoryPending) {
+            QQmlDebugStream d(&message, QIODevice::WriteOnly);
+            QV4::Profiling::MemoryAllocationProperties &props = memory_data[memoryPos];
+            d << props.timestamp << MemoryAllocation << props.type << props.size;
+            ++memoryPos;
+        } else {
+            break;
+        }
         messages.append(message);
+        message.clear();
     }
-    return memory_data.length() == memoryPos ? -1 : memory_data[memoryPos].timestamp;
+
+    qint64 memoryNext = memory_data.length() == memoryPos ? -1 : memory_data[memoryPos].timestamp;
+    qint64 gcNext = gc_data.length() == gcPos ? -1 : gc_data[gcPos].timestamp;
+    if (memoryNext == -1)
+        return gcNext;
+    return gcNext == -1 ? memoryNext : qMin(memoryNext, gcNext);
 }
 
 qint64 QV4ProfilerAdapter::finalizeMessages(qint64 until, QList<QByteArray> &messages,
@@ -82,6 +105,8 @@ qint64 QV4ProfilerAdapter::finalizeMessages(qint64 until, QList<QByteArray> &mes
     if (memoryNext == -1) {
         memory_data.clear();
         memoryPos = 0;
+        gc_data.clear();
+        gcPos = 0;
         return callNext;
     }
 
@@ -132,7 +157,8 @@ qint64 QV4ProfilerAdapter::sendMessages(qint64 until, QList<QByteArray> &message
 
 void QV4ProfilerAdapter::receiveData(
         const QVector<QV4::Profiling::FunctionCallProperties> &new_data,
-        const QVector<QV4::Profiling::MemoryAllocationProperties> &new_memory_data)
+        const QVector<QV4::Profiling::MemoryAllocationProperties> &new_memory_data,
+        const QVector<QV4::Profiling::GarbageCollectionProperties> &new_gc_data)
 {
     // In rare cases it could be that another flush or stop event is processed while data from
     // the previous one is still pending. In that case we just append the data.
@@ -147,6 +173,11 @@ void QV4ProfilerAdapter::receiveData(
     else
         memory_data.append(new_memory_data);
 
+    if (gc_data.isEmpty())
+        gc_data = new_gc_data;
+    else
+        gc_data.append(new_gc_data);
+
     service->dataReady(this);
 }
 
@@ -1538,6 +1538,9 @@ QVector<int> JSCodeGen::generateJSCodeForFunctionsAndBindings(const QList<Compil
         int idx = defineFunction(name, node,
                                  function ? function->formals : 0,
                                  body);
+        // Bindings are evaluated when the object is created, while functions and signal
+        // handlers may never run.
+        _module->functions.at(idx)->compileOnFirstCall = function != 0;
         runtimeFunctionIndices[i] = idx;
     }
 
@@ -1599,7 +1602,9 @@ static QV4::IR::Type resolveQmlType(QQmlEnginePrivate *qmlEngine, QV4::IR::Membe
     }
 
     if (type->isCompositeSingleton()) {
-        QQmlRefPointer<QQmlTypeData> tdata = qmlEngine->typeLoader.getType(type->singletonInstanceInfo()->url);
+        // This may run on a thread optimizing functions for the loader thread, which would wait
+        // for that one to finish loading the type
+        QQmlRefPointer<QQmlTypeData> tdata = qmlEngine->typeLoader.getType(type->singletonInstanceInfo()->url, QQmlTypeLoader::Asynchronous);
         Q_ASSERT(tdata);
         tdata->release(); // Decrease the reference count added from QQmlTypeLoader::getType()
         // When a singleton tries to reference itself, it may not be complete yet.
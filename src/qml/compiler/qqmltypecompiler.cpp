@@ -215,10 +215,15 @@ bool QQmlTypeCompiler::compile()
         pass.reduceTranslationBindings();
 
         QV4::ExecutionEngine *v4 = engine->v4engine();
-        QScopedPointer<QV4::EvalInstructionSelection> isel(v4->iselFactory->create(engine, v4->executableAllocator, &document->jsModule, &document->jsGenerator));
+        QScopedPointer<QV4::EvalInstructionSelection> isel(v4->createTieredInstructionSelection(engine, &document->jsModule, &document->jsGenerator));
         isel->setUseFastLookups(false);
         isel->setUseTypeInference(true);
+        isel->setUseLazyCompilation(!v4->debugger);
         document->javaScriptCompilationUnit = isel->compile(/*generated unit data*/false);
+        // The document stays with the compiled data for as long as functions are pending or can
+        // tier up
+        if (isel->hasDeferredCompilation())
+            document->javaScriptCompilationUnit->lazyCompiler.reset(isel.take());
     }
 
     // Generate QML compiled type data structures
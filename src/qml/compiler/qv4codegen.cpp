@@ -1930,6 +1930,35 @@ bool Codegen::visit(FunctionDeclaration * ast)
     return false;
 }
 
+// Recognizes function(a, b) { return a - b; } and function(a, b) { return b - a; }, returning
+// 1 or -1 respectively. Array.prototype.sort can compare numbers without calling those.
+static int formalDifference(AST::FormalParameterList *formals, AST::SourceElements *body)
+{
+    if (!formals || !formals->next || formals->next->next || formals->name == formals->next->name)
+        return 0;
+    if (!body || body->next)
+        return 0;
+    AST::StatementSourceElement *element = AST::cast<AST::StatementSourceElement *>(body->element);
+    if (!element)
+        return 0;
+    AST::ReturnStatement *returnStatement = AST::cast<AST::ReturnStatement *>(element->statement);
+    if (!returnStatement)
+        return 0;
+    AST::BinaryExpression *difference = AST::cast<AST::BinaryExpression *>(returnStatement->expression);
+    if (!difference || difference->op != QSOperator::Sub)
+        return 0;
+    AST::IdentifierExpression *left = AST::cast<AST::IdentifierExpression *>(difference->left);
+    AST::IdentifierExpression *right = AST::cast<AST::IdentifierExpression *>(difference->right);
+    if (!left || !right)
+        return 0;
+
+    if (left->name == formals->name && right->name == formals->next->name)
+        return 1;
+    if (left->name == formals->next->name && right->name == formals->name)
+        return -1;
+    return 0;
+}
+
 int Codegen::defineFunction(const QString &name, AST::Node *ast,
                             AST::FormalParameterList *formals,
                             AST::SourceElements *body,
@@ -1955,6 +1984,13 @@ int Codegen::defineFunction(const QString &name, AST::Node *ast,
     function->maxNumberOfArguments = qMax(_env->maxNumberOfArguments, (int)QV4::Global::ReservedArgumentCount);
     function->isStrict = _env->isStrict;
     function->isNamedExpression = _env->isNamedFunctionExpression;
+    // Only the code of the program itself runs for sure
+    function->compileOnFirstCall = function->outer != 0;
+    if (!_module->debugMode) {
+        int difference = formalDifference(formals, body);
+        function->isNumericComparator = difference > 0;
+        function->isReversedNumericComparator = difference < 0;
+    }
 
     AST::SourceLocation loc = ast->firstSourceLocation();
     function->line = loc.startLine;
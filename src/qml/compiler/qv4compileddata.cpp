@@ -33,6 +33,7 @@
 
 #include "qv4compileddata_p.h"
 #include "qv4jsir_p.h"
+#include "qv4isel_p.h"
 #include <private/qv4value_p.h>
 #ifndef V4_BOOTSTRAP
 #include <private/qv4engine_p.h>
@@ -44,6 +45,9 @@
 #endif
 #include <private/qqmlirbuilder_p.h>
 #include <QCoreApplication>
+#ifndef V4_BOOTSTRAP
+#include <QFile>
+#endif
 
 #include <algorithm>
 
@@ -54,6 +58,63 @@ namespace QV4 {
 namespace CompiledData {
 
 #ifndef V4_BOOTSTRAP
+namespace {
+
+QV4::Heap::RegExpObject *createRegExp(ExecutionEngine *engine, const CompiledData::RegExp &re, const QString &pattern)
+{
+    int flags = 0;
+    if (re.flags & CompiledData::RegExp::RegExp_Global)
+        flags |= IR::RegExp::RegExp_Global;
+    if (re.flags & CompiledData::RegExp::RegExp_IgnoreCase)
+        flags |= IR::RegExp::RegExp_IgnoreCase;
+    if (re.flags & CompiledData::RegExp::RegExp_Multiline)
+        flags |= IR::RegExp::RegExp_Multiline;
+    return engine->newRegExpObject(pattern, flags);
+}
+
+// Expects l to be zeroed
+void initializeLookup(QV4::Lookup *l, const CompiledData::Lookup &compiledLookup, ExecutionEngine *engine)
+{
+    Lookup::Type type = Lookup::Type(compiledLookup.type_and_flags);
+    if (type == CompiledData::Lookup::Type_Getter)
+        l->getter = QV4::Lookup::getterGeneric;
+    else if (type == CompiledData::Lookup::Type_Setter)
+        l->setter = QV4::Lookup::setterGeneric;
+    else if (type == CompiledData::Lookup::Type_GlobalGetter)
+        l->globalGetter = QV4::Lookup::globalGetterGeneric;
+    else if (type == CompiledData::Lookup::Type_IndexedGetter)
+        l->indexedGetter = QV4::Lookup::indexedGetterGeneric;
+    else if (type == CompiledData::Lookup::Type_IndexedSetter)
+        l->indexedSetter = QV4::Lookup::indexedSetterGeneric;
+
+    for (int j = 0; j < QV4::Lookup::Size; ++j)
+        l->classList[j] = 0;
+    l->level = -1;
+    l->index = UINT_MAX;
+    l->nameIndex = compiledLookup.nameIndex;
+    if (type == CompiledData::Lookup::Type_IndexedGetter || type == CompiledData::Lookup::Type_IndexedSetter)
+        l->engine = engine;
+}
+
+QV4::InternalClass *createClass(ExecutionEngine *engine, const CompiledData::JSClassMember *member, int memberCount,
+                                QV4::Heap::String **runtimeStrings)
+{
+    QV4::InternalClass *klass = engine->emptyClass;
+    for (int j = 0; j < memberCount; ++j, ++member)
+        klass = klass->addMember(runtimeStrings[member->nameOffset]->identifier, member->isAccessor ? QV4::Attr_Accessor : QV4::Attr_Data);
+    return klass;
+}
+
+// The code of functions that are compiled when first called. The code data is the function itself.
+ReturnedValue compileOnFirstCall(ExecutionEngine *engine, const uchar *codeData)
+{
+    QV4::Function *function = reinterpret_cast<QV4::Function *>(const_cast<uchar *>(codeData));
+    function->compilationUnit->compilePendingFunction(function);
+    return function->code(engine, function->codeData);
+}
+
+}
+
 CompilationUnit::CompilationUnit()
     : data(0)
     , engine(0)
@@ -61,6 +122,13 @@ CompilationUnit::CompilationUnit()
     , runtimeLookups(0)
     , runtimeRegularExpressions(0)
     , runtimeClasses(0)
+    , runtimeConstants(0)
+    , runtimeStringCount(0)
+    , runtimeRegularExpressionCount(0)
+    , runtimeLookupCount(0)
+    , runtimeClassCount(0)
+    , runtimeConstantCount(0)
+    , isCompilingLazily(false)
 {}
 
 CompilationUnit::~CompilationUnit()
@@ -75,71 +143,57 @@ QV4::Function *CompilationUnit::linkToEngine(ExecutionEngine *engine)
 
     Q_ASSERT(!runtimeStrings);
     Q_ASSERT(data);
-    runtimeStrings = (QV4::Heap::String **)malloc(data->stringTableSize * sizeof(QV4::Heap::String*));
+    runtimeStringCount = data->stringTableSize;
+    runtimeStrings = (QV4::Heap::String **)malloc(runtimeStringCount * sizeof(QV4::Heap::String*));
     // memset the strings to 0 in case a GC run happens while we're within the loop below
-    memset(runtimeStrings, 0, data->stringTableSize * sizeof(QV4::Heap::String*));
-    for (uint i = 0; i < data->stringTableSize; ++i)
+    memset(runtimeStrings, 0, runtimeStringCount * sizeof(QV4::Heap::String*));
+    for (uint i = 0; i < runtimeStringCount; ++i)
         runtimeStrings[i] = engine->newIdentifier(data->stringAt(i));
 
-    runtimeRegularExpressions = new QV4::Value[data->regexpTableSize];
+    runtimeRegularExpressionCount = data->regexpTableSize;
+    runtimeRegularExpressions = new QV4::Value[runtimeRegularExpressionCount];
     // memset the regexps to 0 in case a GC run happens while we're within the loop below
-    memset(runtimeRegularExpressions, 0, data->regexpTableSize * sizeof(QV4::Value));
-    for (uint i = 0; i < data->regexpTableSize; ++i) {
+    memset(runtimeRegularExpressions, 0, runtimeRegularExpressionCount * sizeof(QV4::Value));
+    for (uint i = 0; i < runtimeRegularExpressionCount; ++i) {
         const CompiledData::RegExp *re = data->regexpAt(i);
-        int flags = 0;
-        if (re->flags & CompiledData::RegExp::RegExp_Global)
-            flags |= IR::RegExp::RegExp_Global;
-        if (re->flags & CompiledData::RegExp::RegExp_IgnoreCase)
-            flags |= IR::RegExp::RegExp_IgnoreCase;
-        if (re->flags & CompiledData::RegExp::RegExp_Multiline)
-            flags |= IR::RegExp::RegExp_Multiline;
-        runtimeRegularExpressions[i] = engine->newRegExpObject(data->stringAt(re->stringIndex), flags);
+        runtimeRegularExpressions[i] = createRegExp(engine, *re, data->stringAt(re->stringIndex));
     }
 
-    if (data->lookupTableSize) {
-        runtimeLookups = new QV4::Lookup[data->lookupTableSize];
-        memset(runtimeLookups, 0, data->lookupTableSize * sizeof(QV4::Lookup));
+    runtimeLookupCount = data->lookupTableSize;
+    if (runtimeLookupCount) {
+        runtimeLookups = new QV4::Lookup[runtimeLookupCount];
+        memset(runtimeLookups, 0, runtimeLookupCount * sizeof(QV4::Lookup));
         const CompiledData::Lookup *compiledLookups = data->lookupTable();
-        for (uint i = 0; i < data->lookupTableSize; ++i) {
-            QV4::Lookup *l = runtimeLookups + i;
-
-            Lookup::Type type = Lookup::Type(compiledLookups[i].type_and_flags);
-            if (type == CompiledData::Lookup::Type_Getter)
-                l->getter = QV4::Lookup::getterGeneric;
-            else if (type == CompiledData::Lookup::Type_Setter)
-                l->setter = QV4::Lookup::setterGeneric;
-            else if (type == CompiledData::Lookup::Type_GlobalGetter)
-                l->globalGetter = QV4::Lookup::globalGetterGeneric;
-            else if (type == CompiledData::Lookup::Type_IndexedGetter)
-                l->indexedGetter = QV4::Lookup::indexedGetterGeneric;
-            else if (type == CompiledData::Lookup::Type_IndexedSetter)
-                l->indexedSetter = QV4::Lookup::indexedSetterGeneric;
-
-            for (int j = 0; j < QV4::Lookup::Size; ++j)
-                l->classList[j] = 0;
-            l->level = -1;
-            l->index = UINT_MAX;
-            l->nameIndex = compiledLookups[i].nameIndex;
-            if (type == CompiledData::Lookup::Type_IndexedGetter || type == CompiledData::Lookup::Type_IndexedSetter)
-                l->engine = engine;
-        }
+        for (uint i = 0; i < runtimeLookupCount; ++i)
+            initializeLookup(runtimeLookups + i, compiledLookups[i], engine);
     }
 
-    if (data->jsClassTableSize) {
-        runtimeClasses = (QV4::InternalClass**)malloc(data->jsClassTableSize * sizeof(QV4::InternalClass*));
-        for (uint i = 0; i < data->jsClassTableSize; ++i) {
+    runtimeClassCount = data->jsClassTableSize;
+    if (runtimeClassCount) {
+        runtimeClasses = (QV4::InternalClass**)malloc(runtimeClassCount * sizeof(QV4::InternalClass*));
+        for (uint i = 0; i < runtimeClassCount; ++i) {
             int memberCount = 0;
             const CompiledData::JSClassMember *member = data->jsClassAt(i, &memberCount);
-            QV4::InternalClass *klass = engine->emptyClass;
-            for (int j = 0; j < memberCount; ++j, ++member)
-                klass = klass->addMember(runtimeStrings[member->nameOffset]->identifier, member->isAccessor ? QV4::Attr_Accessor : QV4::Attr_Data);
-
-            runtimeClasses[i] = klass;
+            runtimeClasses[i] = createClass(engine, member, memberCount, runtimeStrings);
         }
     }
 
+    runtimeConstantCount = data->constantTableSize;
+    runtimeConstants = data->constants();
+
     linkBackendToEngine(engine);
 
+    if (lazyCompiler) {
+        engine->lazyCompilingUnits.insert(this);
+        for (int i = 0; i < runtimeFunctions.size(); ++i) {
+            if (!lazyCompiler->isPendingFunction(i))
+                continue;
+            QV4::Function *function = runtimeFunctions.at(i);
+            function->code = compileOnFirstCall;
+            function->codeData = reinterpret_cast<const uchar *>(function);
+        }
+    }
+
 #if 0
     runtimeFunctionsSortedByAddress.resize(runtimeFunctions.size());
     memcpy(runtimeFunctionsSortedByAddress.data(), runtimeFunctions.data(), runtimeFunctions.size() * sizeof(QV4::Function*));
@@ -152,37 +206,197 @@ QV4::Function *CompilationUnit::linkToEngine(ExecutionEngine *engine)
         return 0;
 }
 
+void CompilationUnit::compilePendingFunction(QV4::Function *function)
+{
+    Q_ASSERT(engine);
+    Q_ASSERT(lazyCompiler);
+    isCompilingLazily = true;
+    lazyCompiler->compilePendingFunction(runtimeFunctions.indexOf(function), this);
+    linkLazilyGeneratedData();
+    isCompilingLazily = false;
+
+    // The context of the call was set up before the lookup table grew
+    if (engine->current->compilationUnit == this)
+        engine->current->lookups = runtimeLookups;
+
+    if (!lazyCompiler->hasDeferredCompilation())
+        releaseLazyCompiler();
+}
+
+bool CompilationUnit::tierUpFunction(QV4::Function *function)
+{
+    Q_ASSERT(engine);
+    if (!lazyCompiler)
+        return false;
+    const int functionIndex = runtimeFunctions.indexOf(function);
+    if (!lazyCompiler->canTierUp(functionIndex))
+        return false;
+
+    isCompilingLazily = true;
+    lazyCompiler->tierUpFunction(functionIndex, function);
+    linkLazilyGeneratedData();
+    isCompilingLazily = false;
+
+    if (engine->current->compilationUnit == this)
+        engine->current->lookups = runtimeLookups;
+
+    if (!lazyCompiler->hasDeferredCompilation())
+        releaseLazyCompiler();
+    return true;
+}
+
+void CompilationUnit::finishLazyCompilation()
+{
+    if (!lazyCompiler)
+        return;
+    if (engine) {
+        isCompilingLazily = true;
+        for (int i = 0; i < runtimeFunctions.size(); ++i) {
+            if (lazyCompiler->isPendingFunction(i))
+                lazyCompiler->compilePendingFunction(i, this);
+        }
+        linkLazilyGeneratedData();
+        isCompilingLazily = false;
+    }
+    releaseLazyCompiler();
+}
+
+void CompilationUnit::dropColdTierUpCode()
+{
+    Q_ASSERT(lazyCompiler);
+    if (isCompilingLazily)
+        return;
+
+    lazyCompiler->dropColdTierUpFunctions(runtimeFunctions);
+    if (!lazyCompiler->hasDeferredCompilation())
+        releaseLazyCompiler();
+}
+
+void CompilationUnit::releaseLazyCompiler()
+{
+    if (lazyCompiler && engine)
+        engine->lazyCompilingUnits.remove(this);
+    lazyCompiler.reset();
+    lazyCompilerDocument.reset();
+    lazyCompilerDependencies.clear();
+}
+
+void CompilationUnit::linkLazilyGeneratedData()
+{
+    const Compiler::JSUnitGenerator *generator = lazyCompiler->jsUnitGenerator();
+
+    const uint stringCount = generator->stringTable.stringCount();
+    if (stringCount > runtimeStringCount) {
+        runtimeStrings = (QV4::Heap::String **)realloc(runtimeStrings, stringCount * sizeof(QV4::Heap::String*));
+        memset(runtimeStrings + runtimeStringCount, 0, (stringCount - runtimeStringCount) * sizeof(QV4::Heap::String*));
+        const uint first = runtimeStringCount;
+        runtimeStringCount = stringCount;
+        for (uint i = first; i < stringCount; ++i)
+            runtimeStrings[i] = engine->newIdentifier(generator->stringForIndex(i));
+    }
+
+    const QVector<CompiledData::RegExp> &regexps = generator->regexpTable();
+    if (uint(regexps.size()) > runtimeRegularExpressionCount) {
+        QV4::Value *expressions = new QV4::Value[regexps.size()];
+        memcpy(expressions, runtimeRegularExpressions, runtimeRegularExpressionCount * sizeof(QV4::Value));
+        memset(expressions + runtimeRegularExpressionCount, 0, (regexps.size() - runtimeRegularExpressionCount) * sizeof(QV4::Value));
+        delete [] runtimeRegularExpressions;
+        runtimeRegularExpressions = expressions;
+        const uint first = runtimeRegularExpressionCount;
+        runtimeRegularExpressionCount = regexps.size();
+        for (uint i = first; i < runtimeRegularExpressionCount; ++i) {
+            const CompiledData::RegExp &re = regexps.at(i);
+            runtimeRegularExpressions[i] = createRegExp(engine, re, generator->stringForIndex(re.stringIndex));
+        }
+    }
+
+    const QList<CompiledData::Lookup> &lookups = generator->lookupTable();
+    if (uint(lookups.size()) > runtimeLookupCount) {
+        QV4::Lookup *newLookups = new QV4::Lookup[lookups.size()];
+        memcpy(newLookups, runtimeLookups, runtimeLookupCount * sizeof(QV4::Lookup));
+        memset(newLookups + runtimeLookupCount, 0, (lookups.size() - runtimeLookupCount) * sizeof(QV4::Lookup));
+        for (int i = runtimeLookupCount; i < lookups.size(); ++i)
+            initializeLookup(newLookups + i, lookups.at(i), engine);
+        if (runtimeLookups)
+            retiredLookupTables.append(runtimeLookups);
+        runtimeLookups = newLookups;
+        runtimeLookupCount = lookups.size();
+    }
+
+    const QList<QList<CompiledData::JSClassMember> > &classes = generator->jsClassTable();
+    if (uint(classes.size()) > runtimeClassCount) {
+        runtimeClasses = (QV4::InternalClass**)realloc(runtimeClasses, classes.size() * sizeof(QV4::InternalClass*));
+        for (int i = runtimeClassCount; i < classes.size(); ++i) {
+            const QVector<CompiledData::JSClassMember> members = classes.at(i).toVector();
+            runtimeClasses[i] = createClass(engine, members.constData(), members.size(), runtimeStrings);
+        }
+        runtimeClassCount = classes.size();
+    }
+
+    const QVector<ReturnedValue> &constants = generator->constantTable();
+    if (uint(constants.size()) > runtimeConstantCount) {
+        // Shares the data with the generator, which detaches when it registers more constants
+        constantTables.append(constants);
+        runtimeConstants = reinterpret_cast<const QV4::Value *>(constantTables.last().constData());
+        runtimeConstantCount = constants.size();
+    }
+}
+
 void CompilationUnit::unlink()
 {
+    releaseLazyCompiler();
+    tierUpCode = QQmlRefPointer<CompilationUnit>();
     if (engine)
         engine->compilationUnits.erase(engine->compilationUnits.find(this));
     engine = 0;
-    if (data && !(data->flags & QV4::CompiledData::Unit::StaticData))
+    if (data && !(data->flags & QV4::CompiledData::Unit::StaticData) && !backingFile && backingData.isNull())
         free(data);
     data = 0;
     free(runtimeStrings);
     runtimeStrings = 0;
+    runtimeStringCount = 0;
     delete [] runtimeLookups;
     runtimeLookups = 0;
+    runtimeLookupCount = 0;
+    for (int i = 0; i < retiredLookupTables.size(); ++i)
+        delete [] retiredLookupTables.at(i);
+    retiredLookupTables.clear();
     delete [] runtimeRegularExpressions;
     runtimeRegularExpressions = 0;
+    runtimeRegularExpressionCount = 0;
     free(runtimeClasses);
     runtimeClasses = 0;
+    runtimeClassCount = 0;
+    runtimeConstants = 0;
+    runtimeConstantCount = 0;
+    constantTables.clear();
     qDeleteAll(runtimeFunctions);
     runtimeFunctions.clear();
 }
 
 void CompilationUnit::markObjects(QV4::ExecutionEngine *e)
 {
-    for (uint i = 0; i < data->stringTableSize; ++i)
+    for (uint i = 0; i < runtimeStringCount; ++i)
         if (runtimeStrings[i])
             runtimeStrings[i]->mark(e);
     if (runtimeRegularExpressions) {
-        for (uint i = 0; i < data->regexpTableSize; ++i)
+        for (uint i = 0; i < runtimeRegularExpressionCount; ++i)
             runtimeRegularExpressions[i].mark(e);
     }
 }
 
+bool CompilationUnit::saveCodeToDisk(QIODevice *, QString *errorString) const
+{
+    *errorString = QStringLiteral("The backend does not support saving code to disk");
+    return false;
+}
+
+bool CompilationUnit::loadCodeFromDisk(uchar *, quint32, QString *errorString)
+{
+    *errorString = QStringLiteral("The backend does not support loading code from disk");
+    return false;
+}
+
 #endif // V4_BOOTSTRAP
 
 Unit *CompilationUnit::createUnitData(QmlIR::Document *irDocument)
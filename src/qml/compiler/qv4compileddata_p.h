@@ -45,6 +45,7 @@
 //
 
 #include <QtCore/qstring.h>
+#include <QtCore/qscopedpointer.h>
 #include <QVector>
 #include <QStringList>
 #include <QHash>
@@ -57,6 +58,8 @@
 
 QT_BEGIN_NAMESPACE
 
+class QIODevice;
+class QFile;
 class QQmlPropertyCache;
 class QQmlPropertyData;
 
@@ -70,6 +73,7 @@ struct Function;
 }
 
 struct Function;
+class EvalInstructionSelection;
 
 namespace CompiledData {
 
@@ -157,7 +161,9 @@ struct Function
         UsesArgumentsObject = 0x2,
         IsStrict            = 0x4,
         IsNamedExpression   = 0x8,
-        HasCatchOrWith      = 0x10
+        HasCatchOrWith      = 0x10,
+        IsNumericComparator = 0x20, // function(a, b) { return a - b; }
+        IsReversedNumericComparator = 0x40 // function(a, b) { return b - a; }
     };
 
     quint32 index; // in CompilationUnit's function table
@@ -605,9 +611,38 @@ struct Q_QML_PRIVATE_EXPORT CompilationUnit : public QQmlRefCount
     QV4::Lookup *runtimeLookups;
     QV4::Value *runtimeRegularExpressions;
     QV4::InternalClass **runtimeClasses;
+    const QV4::Value *runtimeConstants;
     QVector<QV4::Function *> runtimeFunctions;
     mutable QQmlNullableValue<QUrl> m_url;
 
+    // The tables above grow when functions are compiled after linking, so their sizes may
+    // exceed the ones in data.
+    uint runtimeStringCount;
+    uint runtimeRegularExpressionCount;
+    uint runtimeLookupCount;
+    uint runtimeClassCount;
+    uint runtimeConstantCount;
+
+    // The IR of lazyCompiler of a QML unit points into its document, which is kept here as long as
+    // lazyCompiler. When the QML type that compiled the unit goes away while the functions can
+    // still be called, its property caches are kept as well.
+    QScopedPointer<QmlIR::Document> lazyCompilerDocument;
+    QVector<QQmlRefPointer<QQmlRefCount> > lazyCompilerDependencies;
+    // Owns the instruction selection and the IR of the functions that are compiled when first
+    // called, or compiled again when they tier up. Set before linkToEngine().
+    QScopedPointer<QV4::EvalInstructionSelection> lazyCompiler;
+    void compilePendingFunction(QV4::Function *function);
+    // Returns false if the function can't tier up anymore
+    bool tierUpFunction(QV4::Function *function);
+    void finishLazyCompilation();
+    // Called at the end of each tier-up window, see ExecutionEngine::dropColdTierUpCode(). Drops
+    // the IR of the functions that didn't run during the window, so that lazyCompiler can go away
+    // once nothing else is left to compile.
+    void dropColdTierUpCode();
+    void releaseLazyCompiler();
+    // The code of the functions that tiered up, in a unit of the other backend that is never linked
+    QQmlRefPointer<CompilationUnit> tierUpCode;
+
     // index is object index. This allows fast access to the
     // property data when initializing bindings, avoiding expensive
     // lookups by string (property name).
@@ -620,8 +655,30 @@ struct Q_QML_PRIVATE_EXPORT CompilationUnit : public QQmlRefCount
 
     void markObjects(QV4::ExecutionEngine *e);
 
+    // Used by QQmlDiskCache. Backends that generate native code can't store it and return false.
+    // loadCodeFromDisk() is given the code section of a privately mapped or read cache file, which
+    // may be modified in place and stays valid as long as backingFile or backingData.
+    virtual bool saveCodeToDisk(QIODevice *device, QString *errorString) const;
+    virtual bool loadCodeFromDisk(uchar *code, quint32 size, QString *errorString);
+
+    // Set when data points into a memory mapped cache file, or into one read from resources,
+    // instead of being allocated.
+    QScopedPointer<QFile> backingFile;
+    QByteArray backingData;
+
 protected:
     virtual void linkBackendToEngine(QV4::ExecutionEngine *engine) = 0;
+
+private:
+    void linkLazilyGeneratedData();
+
+    // Contexts and interpreter frames that are running keep pointers to the tables that were
+    // current when they were set up.
+    QVector<QV4::Lookup *> retiredLookupTables;
+    QList<QVector<QV4::ReturnedValue> > constantTables;
+
+    // Set while lazyCompiler compiles, which may run the garbage collector
+    bool isCompilingLazily;
 #endif // V4_BOOTSTRAP
 };
 
@@ -321,6 +321,10 @@ int QV4::Compiler::JSUnitGenerator::writeFunction(char *f, int index, QV4::IR::F
         function->flags |= CompiledData::Function::IsNamedExpression;
     if (irFunction->hasTry || irFunction->hasWith)
         function->flags |= CompiledData::Function::HasCatchOrWith;
+    if (irFunction->isNumericComparator)
+        function->flags |= CompiledData::Function::IsNumericComparator;
+    if (irFunction->isReversedNumericComparator)
+        function->flags |= CompiledData::Function::IsReversedNumericComparator;
     function->nFormals = irFunction->formals.size();
     function->formalsOffset = currentOffset;
     currentOffset += function->nFormals * sizeof(quint32);
@@ -110,6 +110,13 @@ struct Q_QML_PRIVATE_EXPORT JSUnitGenerator {
     // Returns bytes written
     int writeFunction(char *f, int index, IR::Function *irFunction);
 
+    // Entries registered after generateUnit() are appended, so the tables of a generated unit
+    // are prefixes of these.
+    const QList<CompiledData::Lookup> &lookupTable() const { return lookups; }
+    const QVector<CompiledData::RegExp> &regexpTable() const { return regexps; }
+    const QVector<ReturnedValue> &constantTable() const { return constants; }
+    const QList<QList<CompiledData::JSClassMember> > &jsClassTable() const { return jsClasses; }
+
     StringTableGenerator stringTable;
 private:
     IR::Module *irModule;
@@ -40,6 +40,7 @@
 #include <private/qv4regexpobject_p.h>
 #include <private/qv4compileddata_p.h>
 #include <private/qqmlengine_p.h>
+#include <QtCore/qiodevice.h>
 
 #undef USE_TYPE_INFO
 
@@ -304,6 +305,20 @@ protected:
 #endif // defined(QT_NO_DEBUG)
     }
 };
+
+// Functions that can still tier up run through VME::execCounting(), which counts their calls
+void setInterpreterCode(QV4::Function *function, const QByteArray &code, bool canTierUp)
+{
+    function->interpreterCode = reinterpret_cast<const uchar *>(code.constData());
+    if (canTierUp) {
+        function->code = &VME::execCounting;
+        function->codeData = reinterpret_cast<const uchar *>(function);
+    } else {
+        function->code = &VME::exec;
+        function->codeData = function->interpreterCode;
+    }
+}
+
 } // anonymous namespace
 
 InstructionSelection::InstructionSelection(QQmlEnginePrivate *qmlEngine, QV4::ExecutableAllocator *execAllocator, IR::Module *module, QV4::Compiler::JSUnitGenerator *jsGenerator)
@@ -317,12 +332,39 @@ InstructionSelection::InstructionSelection(QQmlEnginePrivate *qmlEngine, QV4::Ex
     , compilationUnit(new CompilationUnit)
 {
     setUseTypeInference(false);
+    optimizedFunctions.resize(module->functions.size());
 }
 
 InstructionSelection::~InstructionSelection()
 {
 }
 
+void InstructionSelection::optimizeFunction(int functionIndex)
+{
+    IR::Function *function = irModule->functions[functionIndex];
+    OptimizedFunction &optimized = optimizedFunctions[functionIndex];
+
+    IR::Optimizer opt(function);
+    opt.run(qmlEngine, useTypeInference, /*peelLoops =*/ false);
+    if (opt.isInSSA()) {
+        static const bool doStackSlotAllocation =
+                qgetenv("QV4_NO_INTERPRETER_STACK_SLOT_ALLOCATION").isEmpty();
+
+        if (doStackSlotAllocation) {
+            AllocateStackSlots(opt.lifeTimeIntervals()).forFunction(function);
+        } else {
+            opt.convertOutOfSSA();
+            ConvertTemps().toStackSlots(function);
+        }
+        opt.showMeTheCode(function, "After stack slot allocation");
+    } else {
+        ConvertTemps().toStackSlots(function);
+    }
+
+    optimized.removableJumps = opt.calculateOptionalJumps();
+    optimized.isOptimized = true;
+}
+
 void InstructionSelection::run(int functionIndex)
 {
     IR::Function *function = irModule->functions[functionIndex];
@@ -346,24 +388,10 @@ void InstructionSelection::run(int functionIndex)
     qSwap(codeNext, _codeNext);
     qSwap(codeEnd, _codeEnd);
 
-    IR::Optimizer opt(_function);
-    opt.run(qmlEngine, useTypeInference, /*peelLoops =*/ false);
-    if (opt.isInSSA()) {
-        static const bool doStackSlotAllocation =
-                qgetenv("QV4_NO_INTERPRETER_STACK_SLOT_ALLOCATION").isEmpty();
-
-        if (doStackSlotAllocation) {
-            AllocateStackSlots(opt.lifeTimeIntervals()).forFunction(_function);
-        } else {
-            opt.convertOutOfSSA();
-            ConvertTemps().toStackSlots(_function);
-        }
-        opt.showMeTheCode(_function, "After stack slot allocation");
-    } else {
-        ConvertTemps().toStackSlots(_function);
-    }
-
-    QSet<IR::Jump *> removableJumps = opt.calculateOptionalJumps();
+    if (!optimizedFunctions.at(functionIndex).isOptimized)
+        optimizeFunction(functionIndex);
+    QSet<IR::Jump *> removableJumps = optimizedFunctions.at(functionIndex).removableJumps;
+    optimizedFunctions[functionIndex] = OptimizedFunction();
     qSwap(_removableJumps, removableJumps);
 
     IR::Stmt *cs = 0;
@@ -451,6 +479,31 @@ QQmlRefPointer<QV4::CompiledData::CompilationUnit> InstructionSelection::backend
     return result;
 }
 
+void InstructionSelection::backendCompileFunction(int functionIndex, QV4::CompiledData::CompilationUnit *unit)
+{
+    run(functionIndex);
+
+    CompilationUnit *mothUnit = static_cast<CompilationUnit *>(unit);
+    mothUnit->codeRefs[functionIndex] = codeRefs.take(irModule->functions.at(functionIndex));
+
+    setInterpreterCode(unit->runtimeFunctions.at(functionIndex), mothUnit->codeRefs.at(functionIndex), canTierUp(functionIndex));
+}
+
+void InstructionSelection::backendCompileForTierUp(int functionIndex, QV4::Function *runtimeFunction)
+{
+    QV4::CompiledData::CompilationUnit *unit = runtimeFunction->compilationUnit;
+    if (!unit->tierUpCode) {
+        compilationUnit->codeRefs.resize(irModule->functions.size());
+        unit->tierUpCode.adopt(compilationUnit.take());
+    }
+    CompilationUnit *codeUnit = static_cast<CompilationUnit *>(unit->tierUpCode.data());
+
+    run(functionIndex);
+    codeUnit->codeRefs[functionIndex] = codeRefs.take(irModule->functions.at(functionIndex));
+
+    setInterpreterCode(runtimeFunction, codeUnit->codeRefs.at(functionIndex), /*canTierUp*/false);
+}
+
 void InstructionSelection::callValue(IR::Expr *value, IR::ExprList *args, IR::Expr *result)
 {
     Instruction::CallValue call;
@@ -1565,7 +1618,192 @@ void CompilationUnit::linkBackendToEngine(QV4::ExecutionEngine *engine)
         const QV4::CompiledData::Function *compiledFunction = data->functionAt(i);
 
         QV4::Function *runtimeFunction = new QV4::Function(engine, this, compiledFunction, &VME::exec);
-        runtimeFunction->codeData = reinterpret_cast<const uchar *>(codeRefs.at(i).constData());
+        setInterpreterCode(runtimeFunction, codeRefs.at(i), lazyCompiler && lazyCompiler->canTierUp(i));
         runtimeFunctions[i] = runtimeFunction;
     }
 }
+
+namespace {
+
+// Code stored on disk has the handler addresses of the threaded interpreter replaced by the
+// instruction type, and the runtime functions of binary operations by their index in these
+// tables. Any change to the instructions changes the fingerprint and invalidates cached code.
+const QV4::Runtime::BinaryOperation binaryOperations[] = {
+    QV4::Runtime::bitAnd, QV4::Runtime::bitOr, QV4::Runtime::bitXor, QV4::Runtime::sub,
+    QV4::Runtime::mul, QV4::Runtime::div, QV4::Runtime::mod, QV4::Runtime::shl,
+    QV4::Runtime::shr, QV4::Runtime::ushr, QV4::Runtime::greaterThan, QV4::Runtime::lessThan,
+    QV4::Runtime::greaterEqual, QV4::Runtime::lessEqual, QV4::Runtime::equal,
+    QV4::Runtime::notEqual, QV4::Runtime::strictEqual, QV4::Runtime::strictNotEqual
+};
+
+const QV4::Runtime::BinaryOperationContext contextBinaryOperations[] = {
+    QV4::Runtime::instanceof, QV4::Runtime::in, QV4::Runtime::add
+};
+
+#define MOTH_COUNT_INSTR(I, FMT) + 1
+const quintptr InstructionCount = 0 FOR_EACH_MOTH_INSTR(MOTH_COUNT_INSTR);
+#undef MOTH_COUNT_INSTR
+
+quint32 instructionSetFingerprint()
+{
+    quint32 fingerprint = sizeof(Instr);
+#define MOTH_HASH_INSTR_SIZE(I, FMT) fingerprint = 31 * fingerprint + InstrMeta<(int)Instr::I>::Size;
+    FOR_EACH_MOTH_INSTR(MOTH_HASH_INSTR_SIZE)
+#undef MOTH_HASH_INSTR_SIZE
+    fingerprint = 31 * fingerprint + sizeof(binaryOperations) / sizeof(binaryOperations[0]);
+    fingerprint = 31 * fingerprint + sizeof(contextBinaryOperations) / sizeof(contextBinaryOperations[0]);
+    return fingerprint;
+}
+
+struct CodeHeader
+{
+    quint32 fingerprint;
+    quint32 functionCount;
+    // followed by functionCount + 1 offsets of the code of each function, relative to the header
+};
+
+// Code of each function starts at a multiple of this, relative to the header
+const quint32 CodeAlignment = 16;
+
+template <typename T>
+inline quintptr loadIndex(const T *field)
+{
+    Q_STATIC_ASSERT(sizeof(T) == sizeof(quintptr));
+    quintptr index;
+    memcpy(&index, field, sizeof(index));
+    return index;
+}
+
+template <typename T>
+inline void storeIndex(T *field, quintptr index)
+{
+    Q_STATIC_ASSERT(sizeof(T) == sizeof(quintptr));
+    memcpy(field, &index, sizeof(index));
+}
+
+template <typename T, int N>
+bool relocate(T *field, const T (&table)[N], bool toDisk)
+{
+    if (toDisk) {
+        for (int i = 0; i < N; ++i) {
+            if (*field == table[i]) {
+                storeIndex(field, i);
+                return true;
+            }
+        }
+        return false;
+    }
+    const quintptr index = loadIndex(field);
+    if (index >= quintptr(N))
+        return false;
+    *field = table[index];
+    return true;
+}
+
+bool relocateCode(uchar *code, uchar *end, bool toDisk)
+{
+    while (code < end) {
+        Instr *instr = reinterpret_cast<Instr *>(code);
+        if (end - code < int(sizeof(Instr::instr_common)))
+            return false;
+
+        quintptr type;
+#ifdef MOTH_THREADED_INTERPRETER
+        void **jumpTable = VME::instructionJumpTable();
+        if (toDisk) {
+            for (type = 0; type < InstructionCount && jumpTable[type] != instr->common.code; ++type) {}
+            storeIndex(&instr->common.code, type);
+        } else {
+            type = loadIndex(&instr->common.code);
+            if (type < InstructionCount)
+                instr->common.code = jumpTable[type];
+        }
+#else
+        type = instr->common.instructionType;
+#endif
+        if (type >= InstructionCount || end - code < Instr::size(Instr::Type(type)))
+            return false;
+
+        if (type == Instr::Binop) {
+            if (!relocate(&instr->binop.alu, binaryOperations, toDisk))
+                return false;
+        } else if (type == Instr::BinopContext) {
+            if (!relocate(&instr->binopContext.alu, contextBinaryOperations, toDisk))
+                return false;
+        }
+        code += Instr::size(Instr::Type(type));
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+bool CompilationUnit::saveCodeToDisk(QIODevice *device, QString *errorString) const
+{
+    CodeHeader header;
+    header.fingerprint = instructionSetFingerprint();
+    header.functionCount = codeRefs.size();
+
+    QVector<quint32> offsets;
+    offsets.reserve(codeRefs.size() + 1);
+    quint32 offset = sizeof(CodeHeader) + (codeRefs.size() + 1) * sizeof(quint32);
+    for (int i = 0; i < codeRefs.size(); ++i) {
+        offset = (offset + CodeAlignment - 1) & ~(CodeAlignment - 1);
+        offsets.append(offset);
+        offset += codeRefs.at(i).size();
+    }
+    offsets.append(offset);
+
+    if (device->write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)
+            || device->write(reinterpret_cast<const char *>(offsets.constData()), offsets.size() * sizeof(quint32))
+                != qint64(offsets.size() * sizeof(quint32))) {
+        *errorString = device->errorString();
+        return false;
+    }
+
+    quint32 written = sizeof(CodeHeader) + offsets.size() * sizeof(quint32);
+    for (int i = 0; i < codeRefs.size(); ++i) {
+        QByteArray code(offsets.at(i) - written, '\0');
+        code.append(codeRefs.at(i));
+        uchar *start = reinterpret_cast<uchar *>(code.data()) + offsets.at(i) - written;
+        if (!relocateCode(start, start + codeRefs.at(i).size(), /*toDisk*/true)) {
+            *errorString = QStringLiteral("Function %1 contains an unknown instruction").arg(i);
+            return false;
+        }
+        if (device->write(code) != code.size()) {
+            *errorString = device->errorString();
+            return false;
+        }
+        written += code.size();
+    }
+    return true;
+}
+
+bool CompilationUnit::loadCodeFromDisk(uchar *code, quint32 size, QString *errorString)
+{
+    const CodeHeader *header = reinterpret_cast<const CodeHeader *>(code);
+    if (size < sizeof(CodeHeader) || header->fingerprint != instructionSetFingerprint()) {
+        *errorString = QStringLiteral("The code was generated for a different set of instructions");
+        return false;
+    }
+    if (header->functionCount != data->functionTableSize
+            || size < sizeof(CodeHeader) + (header->functionCount + 1) * sizeof(quint32)) {
+        *errorString = QStringLiteral("The code does not match the compilation unit");
+        return false;
+    }
+
+    const quint32 *offsets = reinterpret_cast<const quint32 *>(header + 1);
+    codeRefs.resize(header->functionCount);
+    for (quint32 i = 0; i < header->functionCount; ++i) {
+        const quint32 start = offsets[i];
+        const quint32 end = offsets[i + 1];
+        if (start % CodeAlignment || start > end || end > size
+                || !relocateCode(code + start, code + end, /*toDisk*/false)) {
+            *errorString = QStringLiteral("The code of function %1 is invalid").arg(i);
+            codeRefs.clear();
+            return false;
+        }
+        codeRefs[i] = QByteArray::fromRawData(reinterpret_cast<const char *>(code + start), end - start);
+    }
+    return true;
+}
@@ -61,6 +61,8 @@ struct CompilationUnit : public QV4::CompiledData::CompilationUnit
 {
     virtual ~CompilationUnit();
     virtual void linkBackendToEngine(QV4::ExecutionEngine *engine);
+    virtual bool saveCodeToDisk(QIODevice *device, QString *errorString) const;
+    virtual bool loadCodeFromDisk(uchar *code, quint32 size, QString *errorString);
 
     QVector<QByteArray> codeRefs;
 
@@ -77,7 +79,10 @@ public:
     virtual void run(int functionIndex);
 
 protected:
+    virtual void optimizeFunction(int functionIndex);
     virtual QQmlRefPointer<CompiledData::CompilationUnit> backendCompileStep();
+    virtual void backendCompileFunction(int functionIndex, CompiledData::CompilationUnit *unit);
+    virtual void backendCompileForTierUp(int functionIndex, QV4::Function *runtimeFunction);
 
     virtual void visitJump(IR::Jump *);
     virtual void visitCJump(IR::CJump *);
@@ -188,6 +193,14 @@ private:
     QSet<IR::Jump *> _removableJumps;
     IR::Stmt *_currentStatement;
 
+    // What optimizeFunction() leaves for run(), by function index
+    struct OptimizedFunction {
+        OptimizedFunction() : isOptimized(false) {}
+        bool isOptimized;
+        QSet<IR::Jump *> removableJumps;
+    };
+    QVector<OptimizedFunction> optimizedFunctions;
+
     QScopedPointer<CompilationUnit> compilationUnit;
     QHash<IR::Function *, QByteArray> codeRefs;
 };
@@ -200,6 +213,10 @@ public:
     { return new InstructionSelection(qmlEngine, execAllocator, module, jsGenerator); }
     virtual bool jitCompileRegexps() const
     { return false; }
+    virtual bool canLoadUnits() const
+    { return true; }
+    virtual QV4::CompiledData::CompilationUnit *createUnitForLoading()
+    { return new CompilationUnit; }
 };
 
 template<int InstrT>
@@ -39,6 +39,11 @@
 #include <private/qv4value_p.h>
 #ifndef V4_BOOTSTRAP
 #include <private/qqmlpropertycache_p.h>
+#include <private/qv4function_p.h>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QRunnable>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThreadPool>
 #endif
 
 #include <QString>
@@ -49,8 +54,11 @@ using namespace QV4::IR;
 EvalInstructionSelection::EvalInstructionSelection(QV4::ExecutableAllocator *execAllocator, Module *module, QV4::Compiler::JSUnitGenerator *jsGenerator)
     : useFastLookups(true)
     , useTypeInference(true)
+    , useLazyCompilation(false)
     , executableAllocator(execAllocator)
     , irModule(module)
+    , tierUpFactory(0)
+    , tierUpQmlEngine(0)
 {
     if (!jsGenerator) {
         jsGenerator = new QV4::Compiler::JSUnitGenerator(module);
@@ -64,15 +72,35 @@ EvalInstructionSelection::EvalInstructionSelection(QV4::ExecutableAllocator *exe
 }
 
 EvalInstructionSelection::~EvalInstructionSelection()
-{}
+{
+    qDeleteAll(tierUpFunctions);
+}
 
 EvalISelFactory::~EvalISelFactory()
 {}
 
 QQmlRefPointer<CompiledData::CompilationUnit> EvalInstructionSelection::compile(bool generateUnitData)
 {
-    for (int i = 0; i < irModule->functions.size(); ++i)
-        run(i);
+    QVector<int> functionIndexes;
+    functionIndexes.reserve(irModule->functions.size());
+    pendingFunctions.resize(irModule->functions.size());
+    for (int i = 0; i < irModule->functions.size(); ++i) {
+        IR::Function *function = irModule->functions.at(i);
+        if (useLazyCompilation && function->compileOnFirstCall) {
+            pendingFunctions.setBit(i);
+        } else {
+            // Compiled now, so its dependencies can still be written into the unit data
+            function->compileOnFirstCall = false;
+            keepForTierUp(i);
+            functionIndexes.append(i);
+        }
+    }
+
+    // Code generation adds to the unit generator, so it stays in order on this thread. That keeps
+    // the unit the same no matter how the optimization was spread.
+    optimizeFunctions(functionIndexes);
+    foreach (int functionIndex, functionIndexes)
+        run(functionIndex);
 
     QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit = backendCompileStep();
     if (generateUnitData)
@@ -80,6 +108,157 @@ QQmlRefPointer<CompiledData::CompilationUnit> EvalInstructionSelection::compile(
     return unit;
 }
 
+void EvalInstructionSelection::compilePendingFunction(int functionIndex, CompiledData::CompilationUnit *unit)
+{
+    Q_ASSERT(isPendingFunction(functionIndex));
+    pendingFunctions.clearBit(functionIndex);
+    keepForTierUp(functionIndex);
+    backendCompileFunction(functionIndex, unit);
+}
+
+#ifndef V4_BOOTSTRAP
+namespace QV4 {
+
+struct FunctionsToOptimize
+{
+    FunctionsToOptimize(const QVector<int> &functionIndexes)
+        : functionIndexes(functionIndexes)
+        , next(0)
+    {}
+
+    // Hands the functions out one at a time, so that a thread that got big ones doesn't hold up
+    // the others
+    int take()
+    {
+        const int i = next.fetchAndAddRelaxed(1);
+        return i < functionIndexes.size() ? functionIndexes.at(i) : -1;
+    }
+
+    const QVector<int> functionIndexes;
+    QAtomicInt next;
+    QSemaphore finishedJobs;
+};
+
+class OptimizeFunctionsJob : public QRunnable
+{
+public:
+    OptimizeFunctionsJob(EvalInstructionSelection *isel, FunctionsToOptimize *functions, QQmlJS::MemoryPool *pool)
+        : isel(isel)
+        , functions(functions)
+        , pool(pool)
+    {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        // The optimizer allocates from the pool of the function, and the one of the module
+        // belongs to the compiling thread
+        for (int functionIndex = functions->take(); functionIndex != -1; functionIndex = functions->take()) {
+            IR::Function *function = isel->irModule->functions.at(functionIndex);
+            function->pool = pool;
+            isel->optimizeFunction(functionIndex);
+            function->pool = &isel->irModule->pool;
+        }
+        functions->finishedJobs.release();
+    }
+
+private:
+    EvalInstructionSelection *isel;
+    FunctionsToOptimize *functions;
+    QQmlJS::MemoryPool *pool;
+};
+
+} // namespace QV4
+#endif // V4_BOOTSTRAP
+
+void EvalInstructionSelection::optimizeFunctions(const QVector<int> &functionIndexes)
+{
+#ifndef V4_BOOTSTRAP
+    // Below that, handing the functions to other threads takes longer than optimizing them
+    const int MinimumFunctionsPerThread = 8;
+    static const bool inParallel = qgetenv("QV4_NO_PARALLEL_COMPILATION").isEmpty();
+    if (!inParallel)
+        return;
+
+    QThreadPool *threadPool = QThreadPool::globalInstance();
+    const int threadCount = qMin(threadPool->maxThreadCount(), functionIndexes.size() / MinimumFunctionsPerThread);
+    if (threadCount < 2)
+        return;
+
+    // This thread takes part, so jobs only start where a thread is free right away. Waiting for a
+    // queued one could take longer than doing its share here.
+    FunctionsToOptimize functions(functionIndexes);
+    int startedJobs = 0;
+    for (int i = 1; i < threadCount; ++i) {
+        QQmlJS::MemoryPool *pool = new QQmlJS::MemoryPool;
+        OptimizeFunctionsJob *job = new OptimizeFunctionsJob(this, &functions, pool);
+        if (!threadPool->tryStart(job)) {
+            delete job;
+            delete pool;
+            break;
+        }
+        irModule->workerPools.append(pool);
+        ++startedJobs;
+    }
+
+    for (int functionIndex = functions.take(); functionIndex != -1; functionIndex = functions.take())
+        optimizeFunction(functionIndex);
+    functions.finishedJobs.acquire(startedJobs);
+#else
+    Q_UNUSED(functionIndexes);
+#endif
+}
+
+void EvalInstructionSelection::setTierUpBackend(EvalISelFactory *factory, QQmlEnginePrivate *qmlEngine)
+{
+    tierUpFactory = factory;
+    tierUpQmlEngine = qmlEngine;
+}
+
+void EvalInstructionSelection::keepForTierUp(int functionIndex)
+{
+    IR::Function *function = irModule->functions.at(functionIndex);
+    // The code of the program itself runs only once
+    if (tierUpFactory && function != irModule->rootFunction)
+        tierUpFunctions.insert(functionIndex, function->clone());
+}
+
+void EvalInstructionSelection::tierUpFunction(int functionIndex, QV4::Function *runtimeFunction)
+{
+    Q_ASSERT(canTierUp(functionIndex));
+    IR::Function *function = tierUpFunctions.take(functionIndex);
+
+    if (!tierUpSelection) {
+        tierUpSelection.reset(tierUpFactory->create(tierUpQmlEngine, executableAllocator, irModule, jsGenerator));
+        tierUpSelection->setUseFastLookups(useFastLookups);
+        tierUpSelection->setUseTypeInference(useTypeInference);
+    }
+
+    // Backends find the functions they run in the module. The optimizer already ran on the one
+    // there, so the copy takes its place meanwhile.
+    qSwap(irModule->functions[functionIndex], function);
+    tierUpSelection->backendCompileForTierUp(functionIndex, runtimeFunction);
+    qSwap(irModule->functions[functionIndex], function);
+    delete function;
+}
+
+#ifndef V4_BOOTSTRAP
+void EvalInstructionSelection::dropColdTierUpFunctions(const QVector<QV4::Function *> &runtimeFunctions)
+{
+    QHash<int, IR::Function *>::Iterator it = tierUpFunctions.begin();
+    while (it != tierUpFunctions.end()) {
+        QV4::Function *runtimeFunction = runtimeFunctions.at(it.key());
+        if (!runtimeFunction->interpreterCallCount && !runtimeFunction->interpreterBackEdgeCount) {
+            delete it.value();
+            it = tierUpFunctions.erase(it);
+        } else {
+            runtimeFunction->interpreterCallCount = 0;
+            runtimeFunction->interpreterBackEdgeCount = 0;
+            ++it;
+        }
+    }
+}
+#endif // V4_BOOTSTRAP
+
 void IRDecoder::visitMove(IR::Move *s)
 {
     if (IR::Name *n = s->target->asName()) {
@@ -140,7 +319,9 @@ void IRDecoder::visitMove(IR::Move *s)
                 const int attachedPropertiesId = m->attachedPropertiesId;
                 const bool isSingletonProperty = m->kind == IR::Member::MemberOfSingletonObject;
 
-                if (_function && attachedPropertiesId == 0 && !m->property->isConstant()) {
+                // Dependencies are written into the unit data before functions compiled on
+                // first call are compiled, so those capture the properties they read instead.
+                if (_function && !_function->compileOnFirstCall && attachedPropertiesId == 0 && !m->property->isConstant()) {
                     if (m->kind == IR::Member::MemberOfQmlContextObject) {
                         _function->contextObjectPropertyDependencies.insert(m->property->coreIndex, m->property->notifyIndex);
                         captureRequired = false;
@@ -51,6 +51,7 @@
 #include <private/qv4compiler_p.h>
 
 #include <qglobal.h>
+#include <QBitArray>
 #include <QHash>
 
 QT_BEGIN_NAMESPACE
@@ -61,6 +62,8 @@ namespace QV4 {
 
 class ExecutableAllocator;
 struct Function;
+class EvalISelFactory;
+class OptimizeFunctionsJob;
 
 class Q_QML_PRIVATE_EXPORT EvalInstructionSelection
 {
@@ -73,6 +76,35 @@ public:
     void setUseFastLookups(bool b) { useFastLookups = b; }
     void setUseTypeInference(bool onoff) { useTypeInference = onoff; }
 
+    // With lazy compilation, compile() leaves out the functions marked compileOnFirstCall. The
+    // unit it returns must then own this instruction selection, see
+    // CompiledData::CompilationUnit::lazyCompiler, and with it everything the IR module and the
+    // unit generator point into.
+    void setUseLazyCompilation(bool onoff) { useLazyCompilation = onoff; }
+    bool hasPendingFunctions() const { return pendingFunctions.count(true) > 0; }
+    bool isPendingFunction(int functionIndex) const { return pendingFunctions.testBit(functionIndex); }
+    // Compiles a function left out by compile() into the unit it returned
+    void compilePendingFunction(int functionIndex, QV4::CompiledData::CompilationUnit *unit);
+    // Makes this instruction selection delete the IR module given to the constructor
+    void adoptIRModule() { ownIRModule.reset(irModule); }
+
+    // With tier-up, this keeps a copy of the IR of the functions it compiles, so that they can be
+    // compiled again by the backend of the factory when they turn out to run often. The unit must
+    // own this instruction selection just like with lazy compilation.
+    void setTierUpBackend(EvalISelFactory *factory, QQmlEnginePrivate *qmlEngine);
+    bool canTierUp(int functionIndex) const { return tierUpFunctions.contains(functionIndex); }
+    // Deletes the IR kept for the functions that were neither called nor ran a loop since the last
+    // time, which then stay with the backend that compiled them first. The others start counting
+    // their calls and loops again.
+    void dropColdTierUpFunctions(const QVector<QV4::Function *> &runtimeFunctions);
+    // Compiles a function again with the tier-up backend and points the runtime function to the
+    // new code, which lives as long as this instruction selection
+    void tierUpFunction(int functionIndex, QV4::Function *runtimeFunction);
+
+    // Whether functions are left to be compiled after compile(), either when first called or when
+    // they tier up
+    bool hasDeferredCompilation() const { return hasPendingFunctions() || !tierUpFunctions.isEmpty(); }
+
     int registerString(const QString &str) { return jsGenerator->registerString(str); }
     uint registerIndexedGetterLookup() { return jsGenerator->registerIndexedGetterLookup(); }
     uint registerIndexedSetterLookup() { return jsGenerator->registerIndexedSetterLookup(); }
@@ -85,14 +117,38 @@ public:
 
 protected:
     virtual void run(int functionIndex) = 0;
+    // Runs the passes in front of code generation for run(), which runs them itself for functions
+    // that didn't go through this. Several functions may be optimized at the same time on
+    // different threads, so this must not touch anything but the function and the results kept
+    // for it.
+    virtual void optimizeFunction(int functionIndex) = 0;
     virtual QQmlRefPointer<QV4::CompiledData::CompilationUnit> backendCompileStep() = 0;
+    // Runs a function after backendCompileStep() and adds its code to the unit returned by that
+    // and to the unit's runtime function
+    virtual void backendCompileFunction(int functionIndex, QV4::CompiledData::CompilationUnit *unit) = 0;
+    // Runs a function for the runtime function of a unit of another backend. The code stays with
+    // this instruction selection.
+    virtual void backendCompileForTierUp(int functionIndex, QV4::Function *runtimeFunction) = 0;
 
     bool useFastLookups;
     bool useTypeInference;
+    bool useLazyCompilation;
     QV4::ExecutableAllocator *executableAllocator;
     QV4::Compiler::JSUnitGenerator *jsGenerator;
     QScopedPointer<QV4::Compiler::JSUnitGenerator> ownJSGenerator;
     IR::Module *irModule;
+    QScopedPointer<IR::Module> ownIRModule;
+    QBitArray pendingFunctions;
+
+private:
+    friend class OptimizeFunctionsJob;
+    void optimizeFunctions(const QVector<int> &functionIndexes);
+    void keepForTierUp(int functionIndex);
+
+    EvalISelFactory *tierUpFactory;
+    QQmlEnginePrivate *tierUpQmlEngine;
+    QScopedPointer<EvalInstructionSelection> tierUpSelection;
+    QHash<int, IR::Function *> tierUpFunctions;
 };
 
 class Q_QML_PRIVATE_EXPORT EvalISelFactory
@@ -101,6 +157,11 @@ public:
     virtual ~EvalISelFactory() = 0;
     virtual EvalInstructionSelection *create(QQmlEnginePrivate *qmlEngine, QV4::ExecutableAllocator *execAllocator, IR::Module *module, QV4::Compiler::JSUnitGenerator *jsGenerator) = 0;
     virtual bool jitCompileRegexps() const = 0;
+    // Whether createUnitForLoading() returns units, that is, whether cached code can be used
+    virtual bool canLoadUnits() const { return false; }
+    // Returns an empty compilation unit of this backend for loading cached code into, or 0 if
+    // the backend doesn't support that.
+    virtual QV4::CompiledData::CompilationUnit *createUnitForLoading() { return 0; }
 };
 
 namespace IR {
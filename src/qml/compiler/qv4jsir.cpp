@@ -374,6 +374,7 @@ Function *Module::newFunction(const QString &name, Function *outer)
 Module::~Module()
 {
     qDeleteAll(functions);
+    qDeleteAll(workerPools);
 }
 
 void Module::setFileName(const QString &name)
@@ -398,6 +399,9 @@ Function::Function(Module *module, Function *outer, const QString &name)
     , isNamedExpression(false)
     , hasTry(false)
     , hasWith(false)
+    , isNumericComparator(false)
+    , isReversedNumericComparator(false)
+    , compileOnFirstCall(false)
     , unused(0)
     , line(-1)
     , column(-1)
@@ -472,6 +476,94 @@ int Function::indexOfArgument(const QStringRef &string) const
     return -1;
 }
 
+Function *Function::clone()
+{
+    Q_ASSERT(!_allBasicBlocks);
+
+    Function *f = new Function(module, outer, *name);
+    f->tempCount = tempCount;
+    f->maxNumberOfArguments = maxNumberOfArguments;
+    f->formals = formals;
+    f->locals = locals;
+    f->nestedFunctions = nestedFunctions;
+    f->insideWithOrCatch = insideWithOrCatch;
+    f->hasDirectEval = hasDirectEval;
+    f->usesArgumentsObject = usesArgumentsObject;
+    f->usesThis = usesThis;
+    f->isStrict = isStrict;
+    f->isNamedExpression = isNamedExpression;
+    f->hasTry = hasTry;
+    f->hasWith = hasWith;
+    f->isNumericComparator = isNumericComparator;
+    f->isReversedNumericComparator = isReversedNumericComparator;
+    f->compileOnFirstCall = compileOnFirstCall;
+    f->line = line;
+    f->column = column;
+    f->idObjectDependencies = idObjectDependencies;
+    f->contextObjectPropertyDependencies = contextObjectPropertyDependencies;
+    f->scopeObjectPropertyDependencies = scopeObjectPropertyDependencies;
+
+    // Blocks refer to each other, so they all exist before their statements and edges are copied
+    QVector<BasicBlock *> blocks;
+    blocks.reserve(basicBlockCount());
+    for (int i = 0, ei = basicBlockCount(); i != ei; ++i)
+        blocks.append(f->newBasicBlock(0));
+
+    CloneExpr clone;
+    foreach (BasicBlock *bb, basicBlocks()) {
+        BasicBlock *newBlock = blocks.at(bb->index());
+        if (bb->isRemoved()) {
+            f->removeBasicBlock(newBlock);
+            continue;
+        }
+
+        newBlock->catchBlock = bb->catchBlock ? blocks.at(bb->catchBlock->index()) : 0;
+        newBlock->setExceptionHandler(bb->isExceptionHandler());
+        if (bb->containingGroup())
+            newBlock->setContainingGroup(blocks.at(bb->containingGroup()->index()));
+        newBlock->markAsGroupStart(bb->isGroupStart());
+        foreach (BasicBlock *in, bb->in)
+            newBlock->in.append(blocks.at(in->index()));
+        foreach (BasicBlock *out, bb->out)
+            newBlock->out.append(blocks.at(out->index()));
+
+        clone.setBasicBlock(newBlock);
+        foreach (Stmt *s, bb->statements()) {
+            Stmt *newStmt = 0;
+            if (Exp *e = s->asExp()) {
+                Exp *newExp = f->NewStmt<Exp>();
+                newExp->init(clone(e->expr));
+                newStmt = newExp;
+            } else if (Move *m = s->asMove()) {
+                Move *newMove = f->NewStmt<Move>();
+                newMove->init(clone(m->target), clone(m->source));
+                newMove->swap = m->swap;
+                newStmt = newMove;
+            } else if (Jump *j = s->asJump()) {
+                Jump *newJump = f->NewStmt<Jump>();
+                newJump->init(blocks.at(j->target->index()));
+                newStmt = newJump;
+            } else if (CJump *c = s->asCJump()) {
+                CJump *newCJump = f->NewStmt<CJump>();
+                newCJump->init(clone(c->cond), blocks.at(c->iftrue->index()), blocks.at(c->iffalse->index()), newBlock);
+                newStmt = newCJump;
+            } else if (Ret *r = s->asRet()) {
+                Ret *newRet = f->NewStmt<Ret>();
+                newRet->init(clone(r->expr));
+                newStmt = newRet;
+            } else {
+                // Phi nodes only exist while the optimizer runs
+                Q_UNREACHABLE();
+            }
+            newBlock->appendStatement(newStmt);
+            newStmt->location = s->location;
+        }
+        newBlock->nextLocation = bb->nextLocation;
+    }
+
+    return f;
+}
+
 void Function::setScheduledBlocks(const QVector<BasicBlock *> &scheduled)
 {
     Q_ASSERT(!_allBasicBlocks);
@@ -931,7 +1023,10 @@ void CloneExpr::visitSubscript(Subscript *e)
 void CloneExpr::visitMember(Member *e)
 {
     Expr *clonedBase = clone(e->base);
-    cloned = block->MEMBER(clonedBase, e->name, e->property, e->kind, e->idIndex);
+    Member *clonedMember = static_cast<Member *>(block->MEMBER(clonedBase, e->name, e->property, e->kind, e->idIndex));
+    clonedMember->freeOfSideEffects = e->freeOfSideEffects;
+    clonedMember->inhibitTypeConversionOnWrite = e->inhibitTypeConversionOnWrite;
+    cloned = clonedMember;
 }
 
 IRPrinter::IRPrinter(QTextStream *out)
@@ -748,6 +748,8 @@ struct Phi: Stmt {
 
 struct Q_QML_PRIVATE_EXPORT Module {
     QQmlJS::MemoryPool pool;
+    // Further pools for functions that allocated while being optimized on other threads
+    QVector<QQmlJS::MemoryPool *> workerPools;
     QVector<Function *> functions;
     Function *rootFunction;
     QString fileName;
@@ -984,7 +986,11 @@ struct Function {
     uint isNamedExpression : 1;
     uint hasTry: 1;
     uint hasWith: 1;
-    uint unused : 25;
+    uint isNumericComparator : 1;
+    uint isReversedNumericComparator : 1;
+    // The backend may leave the function out and compile it when it is first called
+    uint compileOnFirstCall : 1;
+    uint unused : 22;
 
     // Location of declaration in source code (-1 if not specified)
     int line;
@@ -1035,6 +1041,10 @@ struct Function {
     bool variablesCanEscape() const
     { return hasDirectEval || !nestedFunctions.isEmpty() || module->debugMode; }
 
+    // Returns a copy of the function as generated, before the optimizer ran on it, for compiling
+    // it once more. The copy isn't part of the module, and shares strings with this function.
+    Function *clone();
+
     void setScheduledBlocks(const QVector<BasicBlock *> &scheduled);
     void renumberBasicBlocks();
 
@@ -46,6 +46,7 @@
 #include <QtCore/QSet>
 #include <QtCore/QLinkedList>
 #include <QtCore/QStack>
+#include <QtCore/QMutex>
 #include <qv4runtime_p.h>
 #include <cmath>
 #include <iostream>
@@ -2273,6 +2274,8 @@ protected:
     }
 };
 
+static QBasicMutex memberResolverMutex;
+
 class TypeInference: public StmtVisitor, public ExprVisitor
 {
     enum { DebugTypeInference = 0 };
@@ -2541,6 +2544,9 @@ protected:
 
         if (_ty.fullyTyped && _ty.type.memberResolver && _ty.type.memberResolver->isValid()) {
             MemberExpressionResolver *resolver = _ty.type.memberResolver;
+            // Resolving looks up and creates property caches of the engine, while other
+            // functions may be optimized at the same time
+            QMutexLocker locker(&memberResolverMutex);
             _ty.type.type = resolver->resolveMember(qmlEngine, resolver, e);
         } else
             _ty.type = VarType;
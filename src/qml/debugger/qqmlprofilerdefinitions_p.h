@@ -61,6 +61,7 @@ struct QQmlProfilerDefinitions {
         PixmapCacheEvent,
         SceneGraphFrame,
         MemoryAllocation,
+        GarbageCollection,
 
         MaximumMessage
     };
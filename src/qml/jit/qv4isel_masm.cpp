@@ -260,6 +260,7 @@ InstructionSelection::InstructionSelection(QQmlEnginePrivate *qmlEngine, QV4::Ex
     , qmlEngine(qmlEngine)
 {
     compilationUnit->codeRefs.resize(module->functions.size());
+    optimizedFunctions.resize(module->functions.size());
 }
 
 InstructionSelection::~InstructionSelection()
@@ -267,28 +268,41 @@ InstructionSelection::~InstructionSelection()
     delete _as;
 }
 
-void InstructionSelection::run(int functionIndex)
+void InstructionSelection::optimizeFunction(int functionIndex)
 {
     IR::Function *function = irModule->functions[functionIndex];
-    qSwap(_function, function);
+    OptimizedFunction &optimized = optimizedFunctions[functionIndex];
 
-    IR::Optimizer opt(_function);
+    IR::Optimizer opt(function);
     opt.run(qmlEngine);
 
     static const bool withRegisterAllocator = qgetenv("QV4_NO_REGALLOC").isEmpty();
     if (Assembler::RegAllocIsSupported && opt.isInSSA() && withRegisterAllocator) {
         RegisterAllocator regalloc(Assembler::getRegisterInfo());
-        regalloc.run(_function, opt);
-        calculateRegistersToSave(regalloc.usedRegisters());
+        regalloc.run(function, opt);
+        optimized.usedRegisters = regalloc.usedRegisters();
     } else {
         if (opt.isInSSA())
             // No register allocator available for this platform, or env. var was set, so:
             opt.convertOutOfSSA();
-        ConvertTemps().toStackSlots(_function);
-        IR::Optimizer::showMeTheCode(_function, "After stack slot allocation");
-        calculateRegistersToSave(Assembler::getRegisterInfo()); // FIXME: this saves all registers. We can probably do with a subset: those that are not used by the register allocator.
+        ConvertTemps().toStackSlots(function);
+        IR::Optimizer::showMeTheCode(function, "After stack slot allocation");
+        optimized.usedRegisters = Assembler::getRegisterInfo(); // FIXME: this saves all registers. We can probably do with a subset: those that are not used by the register allocator.
     }
-    QSet<IR::Jump *> removableJumps = opt.calculateOptionalJumps();
+    optimized.removableJumps = opt.calculateOptionalJumps();
+    optimized.isOptimized = true;
+}
+
+void InstructionSelection::run(int functionIndex)
+{
+    IR::Function *function = irModule->functions[functionIndex];
+    qSwap(_function, function);
+
+    if (!optimizedFunctions.at(functionIndex).isOptimized)
+        optimizeFunction(functionIndex);
+    calculateRegistersToSave(optimizedFunctions.at(functionIndex).usedRegisters);
+    QSet<IR::Jump *> removableJumps = optimizedFunctions.at(functionIndex).removableJumps;
+    optimizedFunctions[functionIndex] = OptimizedFunction();
     qSwap(_removableJumps, removableJumps);
 
     Assembler* oldAssembler = _as;
@@ -381,6 +395,36 @@ QQmlRefPointer<QV4::CompiledData::CompilationUnit> InstructionSelection::backend
     return result;
 }
 
+void InstructionSelection::backendCompileFunction(int functionIndex, QV4::CompiledData::CompilationUnit *unit)
+{
+    // run() emits into compilationUnit, which was handed out by backendCompileStep()
+    Q_ASSERT(!compilationUnit);
+    compilationUnit.reset(static_cast<CompilationUnit *>(unit));
+    run(functionIndex);
+    compilationUnit.take();
+
+    QV4::Function *runtimeFunction = unit->runtimeFunctions.at(functionIndex);
+    runtimeFunction->code = (ReturnedValue (*)(QV4::ExecutionEngine *, const uchar *))
+            static_cast<CompilationUnit *>(unit)->codeRefs[functionIndex].code().executableAddress();
+    runtimeFunction->codeData = 0;
+}
+
+void InstructionSelection::backendCompileForTierUp(int functionIndex, QV4::Function *runtimeFunction)
+{
+    // The first function that tiers up hands the unit created by the constructor over to the unit
+    // of the runtime function, which keeps the code of all of them
+    QV4::CompiledData::CompilationUnit *unit = runtimeFunction->compilationUnit;
+    if (!unit->tierUpCode)
+        unit->tierUpCode.adopt(compilationUnit.take());
+    compilationUnit.reset(static_cast<CompilationUnit *>(unit->tierUpCode.data()));
+    run(functionIndex);
+    compilationUnit.take();
+
+    runtimeFunction->code = (ReturnedValue (*)(QV4::ExecutionEngine *, const uchar *))
+            static_cast<CompilationUnit *>(unit->tierUpCode.data())->codeRefs[functionIndex].code().executableAddress();
+    runtimeFunction->codeData = 0;
+}
+
 void InstructionSelection::callBuiltinInvalid(IR::Name *func, IR::ExprList *args, IR::Expr *result)
 {
     prepareCallData(args, 0);
@@ -77,7 +77,10 @@ public:
 
     const void *addConstantTable(QVector<QV4::Primitive> *values);
 protected:
+    virtual void optimizeFunction(int functionIndex);
     virtual QQmlRefPointer<QV4::CompiledData::CompilationUnit> backendCompileStep();
+    virtual void backendCompileFunction(int functionIndex, QV4::CompiledData::CompilationUnit *unit);
+    virtual void backendCompileForTierUp(int functionIndex, QV4::Function *runtimeFunction);
 
     virtual void callBuiltinInvalid(IR::Name *func, IR::ExprList *args, IR::Expr *result);
     virtual void callBuiltinTypeofMember(IR::Expr *base, const QString &name, IR::Expr *result);
@@ -273,6 +276,15 @@ private:
     QQmlEnginePrivate *qmlEngine;
     RegisterInformation regularRegistersToSave;
     RegisterInformation fpRegistersToSave;
+
+    // What optimizeFunction() leaves for run(), by function index
+    struct OptimizedFunction {
+        OptimizedFunction() : isOptimized(false) {}
+        bool isOptimized;
+        RegisterInformation usedRegisters;
+        QSet<IR::Jump *> removableJumps;
+    };
+    QVector<OptimizedFunction> optimizedFunctions;
 };
 
 class Q_QML_EXPORT ISelFactory: public EvalISelFactory
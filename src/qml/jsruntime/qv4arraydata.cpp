@@ -281,7 +281,8 @@ void SimpleArrayData::push_front(Object *o, const Value *values, uint n)
         Q_ASSERT(o->d()->arrayData->type == Heap::ArrayData::Simple);
         dd = o->d()->arrayData.cast<Heap::SimpleArrayData>();
     }
-    dd->offset = (dd->offset - n) % dd->alloc;
+    // alloc doesn't need to be a power of two, so don't let offset - n wrap around UINT_MAX
+    dd->offset = (dd->offset + dd->alloc - n) % dd->alloc;
     dd->len += n;
     for (uint i = 0; i < n; ++i)
         dd->data(i) = values[i].asReturnedValue();
@@ -295,7 +296,8 @@ ReturnedValue SimpleArrayData::pop_front(Object *o)
         return Encode::undefined();
 
     ReturnedValue v = dd->data(0).isEmpty() ? Encode::undefined() : dd->data(0).asReturnedValue();
-    dd->offset = (dd->offset + 1) % dd->alloc;
+    if (++dd->offset == dd->alloc)
+        dd->offset = 0;
     --dd->len;
     return v;
 }
@@ -639,99 +641,95 @@ void ArrayData::insert(Object *o, uint index, const Value *v, bool isAccessor)
 }
 
 
-class ArrayElementLessThan
-{
-public:
-    inline ArrayElementLessThan(ExecutionEngine *engine, Object *thisObject, const Value &comparefn)
-        : m_engine(engine), thisObject(thisObject), m_comparefn(comparefn) {}
+namespace {
 
-    bool operator()(Value v1, Value v2) const;
+// The sort functors below compare positions in the snapshot of the values being sorted, the
+// fast paths compare keys computed up front instead of the values themselves.
 
-private:
-    ExecutionEngine *m_engine;
-    Object *thisObject;
-    const Value &m_comparefn;
-};
-
-
-bool ArrayElementLessThan::operator()(Value v1, Value v2) const
+class ComparatorLessThan
 {
-    Scope scope(m_engine);
+public:
+    inline ComparatorLessThan(const FunctionObject *comparefn, CallData *callData, Heap::SimpleArrayData *values)
+        : m_comparefn(comparefn), m_callData(callData), m_values(values) {}
 
-    if (v1.isUndefined() || v1.isEmpty())
-        return false;
-    if (v2.isUndefined() || v2.isEmpty())
-        return true;
-    ScopedObject o(scope, m_comparefn);
-    if (o) {
-        Scope scope(o->engine());
-        ScopedValue result(scope);
-        ScopedCallData callData(scope, 2);
-        callData->thisObject = Primitive::undefinedValue();
-        callData->args[0] = v1;
-        callData->args[1] = v2;
-        result = Runtime::callValue(scope.engine, m_comparefn, callData);
+    bool operator()(uint i1, uint i2) const
+    {
+        ExecutionEngine *engine = m_comparefn->engine();
+        if (engine->hasException)
+            return false;
 
+        Scope scope(engine);
+        m_callData->thisObject = Primitive::undefinedValue();
+        m_callData->args[0] = m_values->data(i1);
+        m_callData->args[1] = m_values->data(i2);
+        ScopedValue result(scope, m_comparefn->call(m_callData));
         return result->toNumber() < 0;
     }
-    ScopedString p1s(scope, v1.toString(scope.engine));
-    ScopedString p2s(scope, v2.toString(scope.engine));
-    return p1s->toQString() < p2s->toQString();
-}
 
-template <typename RandomAccessIterator, typename T, typename LessThan>
-void sortHelper(RandomAccessIterator start, RandomAccessIterator end, const T &t, LessThan lessThan)
-{
-top:
-    int span = int(end - start);
-    if (span < 2)
-        return;
+private:
+    const FunctionObject *m_comparefn;
+    CallData *m_callData;
+    Heap::SimpleArrayData *m_values;
+};
 
-    --end;
-    RandomAccessIterator low = start, high = end - 1;
-    RandomAccessIterator pivot = start + span / 2;
+class StringKeyLessThan
+{
+public:
+    inline StringKeyLessThan(const QString *keys)
+        : m_keys(keys) {}
 
-    if (lessThan(*end, *start))
-        qSwap(*end, *start);
-    if (span == 2)
-        return;
+    bool operator()(uint i1, uint i2) const
+    { return m_keys[i1] < m_keys[i2]; }
 
-    if (lessThan(*pivot, *start))
-        qSwap(*pivot, *start);
-    if (lessThan(*end, *pivot))
-        qSwap(*end, *pivot);
-    if (span == 3)
-        return;
+private:
+    const QString *m_keys;
+};
 
-    qSwap(*pivot, *end);
+// Evaluates function(a, b) { return a - b; } or its reverse without calling it
+class NumberKeyLessThan
+{
+public:
+    inline NumberKeyLessThan(const double *keys, bool reversed)
+        : m_keys(keys), m_reversed(reversed) {}
 
-    while (low < high) {
-        while (low < high && lessThan(*low, *end))
-            ++low;
+    bool operator()(uint i1, uint i2) const
+    { return (m_reversed ? m_keys[i2] - m_keys[i1] : m_keys[i1] - m_keys[i2]) < 0; }
 
-        while (high > low && lessThan(*end, *high))
-            --high;
+private:
+    const double *m_keys;
+    bool m_reversed;
+};
 
-        if (low < high) {
-            qSwap(*low, *high);
-            ++low;
-            --high;
-        } else {
-            break;
+// A stable merge sort of positions. Comparators written in JavaScript don't have to be
+// consistent, so unlike std::stable_sort this never relies on the comparison to stay in range.
+template <typename LessThan>
+void mergeSort(QVector<uint> &order, LessThan lessThan)
+{
+    const quint64 count = order.size();
+    QVector<uint> buffer(order.size());
+    uint *from = order.data();
+    uint *to = buffer.data();
+    for (quint64 width = 1; width < count; width *= 2) {
+        for (quint64 left = 0; left < count; left += 2 * width) {
+            const quint64 middle = qMin(left + width, count);
+            const quint64 right = qMin(left + 2 * width, count);
+            quint64 i = left;
+            quint64 j = middle;
+            quint64 k = left;
+            while (i < middle && j < right)
+                to[k++] = lessThan(from[j], from[i]) ? from[j++] : from[i++];
+            while (i < middle)
+                to[k++] = from[i++];
+            while (j < right)
+                to[k++] = from[j++];
         }
+        qSwap(from, to);
     }
-
-    if (lessThan(*low, *end))
-        ++low;
-
-    qSwap(*end, *low);
-    sortHelper(start, low, t, lessThan);
-
-    start = low + 1;
-    ++end;
-    goto top;
+    if (from != order.data())
+        memcpy(order.data(), from, count * sizeof(uint));
 }
 
+}
 
 void ArrayData::sort(ExecutionEngine *engine, Object *thisObject, const Value &comparefn, uint len)
 {
@@ -744,7 +742,8 @@ void ArrayData::sort(ExecutionEngine *engine, Object *thisObject, const Value &c
     if (!arrayData || !arrayData->length())
         return;
 
-    if (!(comparefn.isUndefined() || comparefn.as<Object>())) {
+    ScopedFunctionObject f(scope, comparefn);
+    if (!comparefn.isUndefined() && !f) {
         engine->throwTypeError();
         return;
     }
@@ -752,10 +751,12 @@ void ArrayData::sort(ExecutionEngine *engine, Object *thisObject, const Value &c
     // The spec says the sorting goes through a series of get,put and delete operations.
     // this implies that the attributes don't get sorted around.
 
+    Scoped<SparseArrayData> sparse(scope);
+    SparseArrayNode *outsideSortRange = 0;
     if (arrayData->type() == Heap::ArrayData::Sparse) {
         // since we sort anyway, we can simply iterate over the entries in the sparse
         // array and append them one by one to a regular one.
-        Scoped<SparseArrayData> sparse(scope, static_cast<Heap::SparseArrayData *>(arrayData->d()));
+        sparse = static_cast<Heap::SparseArrayData *>(arrayData->d());
 
         if (!sparse->sparse()->nEntries())
             return;
@@ -768,7 +769,7 @@ void ArrayData::sort(ExecutionEngine *engine, Object *thisObject, const Value &c
         uint i = 0;
         if (sparse->attrs()) {
             while (n != sparse->sparse()->end()) {
-                if (n->value >= len)
+                if (n->key() >= len)
                     break;
 
                 PropertyAttributes a = sparse->attrs() ? sparse->attrs()[n->value] : Attr_Data;
@@ -780,7 +781,7 @@ void ArrayData::sort(ExecutionEngine *engine, Object *thisObject, const Value &c
             }
         } else {
             while (n != sparse->sparse()->end()) {
-                if (n->value >= len)
+                if (n->key() >= len)
                     break;
                 d->data(i) = sparse->arrayData()[n->value];
                 n = n->nextNode();
@@ -790,43 +791,95 @@ void ArrayData::sort(ExecutionEngine *engine, Object *thisObject, const Value &c
         d->len = i;
         if (len > i)
             len = i;
-        if (n != sparse->sparse()->end()) {
-            // have some entries outside the sort range that we need to ignore when sorting
-            thisObject->initSparseArray();
-            while (n != sparse->sparse()->end()) {
-                PropertyAttributes a = sparse->attrs() ? sparse->attrs()[n->value] : Attr_Data;
-                thisObject->arraySet(n->value, reinterpret_cast<Property *>(sparse->arrayData() + n->value), a);
-
-                n = n->nextNode();
-            }
-
-        }
+        // entries outside the sort range are added back once the sort is done
+        if (n != sparse->sparse()->end())
+            outsideSortRange = n;
     } else {
         Heap::SimpleArrayData *d = thisObject->d()->arrayData.cast<Heap::SimpleArrayData>();
         if (len > d->len)
             len = d->len;
+    }
 
-        // sort empty values to the end
-        for (uint i = 0; i < len; i++) {
-            if (d->data(i).isEmpty()) {
-                while (--len > i)
-                    if (!d->data(len).isEmpty())
-                        break;
-                Q_ASSERT(!d->attrs || !d->attrs[len].isAccessor());
-                d->data(i) = d->data(len);
-                d->data(len) = Primitive::emptyValue();
-            }
+    // Sort a snapshot of the values, so that a comparator modifying the array can't pull
+    // them away under us. Holes and undefined values don't take part, they are moved to the
+    // end in that order.
+    ScopedObject snapshot(scope, engine->newObject());
+    snapshot->arrayReserve(len);
+    Heap::SimpleArrayData *values = snapshot->d()->arrayData.cast<Heap::SimpleArrayData>();
+    Heap::SimpleArrayData *d = thisObject->d()->arrayData.cast<Heap::SimpleArrayData>();
+    uint count = 0;
+    uint undefinedCount = 0;
+    bool allNumbers = true;
+    for (uint i = 0; i < len; ++i) {
+        const Value &v = d->data(i);
+        if (v.isEmpty())
+            continue;
+        if (v.isUndefined()) {
+            ++undefinedCount;
+            continue;
         }
-
-        if (!len)
-            return;
+        allNumbers = allNumbers && v.isNumber();
+        values->data(count++) = v;
+    }
+    values->len = count;
+
+    QVector<uint> order(count);
+    for (uint i = 0; i < count; ++i)
+        order[i] = i;
+
+    Function *function = f ? f->function() : 0;
+    if (count < 2) {
+        // nothing to compare
+    } else if (!f) {
+        // convert to strings only once instead of on every comparison
+        QVector<QString> keys(count);
+        for (uint i = 0; i < count && !scope.hasException(); ++i)
+            keys[i] = values->data(i).toQString();
+        if (!scope.hasException())
+            mergeSort(order, StringKeyLessThan(keys.constData()));
+    } else if (allNumbers && function && (function->isNumericComparator() || function->isReversedNumericComparator())) {
+        QVector<double> keys(count);
+        for (uint i = 0; i < count; ++i)
+            keys[i] = values->data(i).toNumber();
+        mergeSort(order, NumberKeyLessThan(keys.constData(), function->isReversedNumericComparator()));
+    } else {
+        // one set of arguments serves all calls to the comparator
+        ScopedCallData callData(scope, 2);
+        mergeSort(order, ComparatorLessThan(f, callData, values));
     }
 
+    // If a comparator or toString() threw, the values stay where they are. The entries
+    // outside the sort range have to be added back either way.
+    d = thisObject->d()->arrayData.cast<Heap::SimpleArrayData>();
+    if (scope.hasException()) {
+        // leave the values unsorted
+    } else if (d && d->type == Heap::ArrayData::Simple && d->len >= len) {
+        for (uint i = 0; i < count; ++i)
+            d->data(i) = values->data(order.at(i));
+        for (uint i = count; i < count + undefinedCount; ++i)
+            d->data(i) = Primitive::undefinedValue();
+        for (uint i = count + undefinedCount; i < len; ++i)
+            d->data(i) = Primitive::emptyValue();
+    } else {
+        // the comparator changed the layout of the array, go through the generic accessors
+        ScopedValue v(scope);
+        for (uint i = 0; i < count; ++i) {
+            v = values->data(order.at(i));
+            thisObject->putIndexed(i, v);
+        }
+        for (uint i = count; i < count + undefinedCount; ++i)
+            thisObject->putIndexed(i, Primitive::undefinedValue());
+        for (uint i = count + undefinedCount; i < len; ++i)
+            thisObject->deleteIndexedProperty(i);
+    }
 
-    ArrayElementLessThan lessThan(engine, thisObject, comparefn);
-
-    Value *begin = thisObject->arrayData()->arrayData;
-    sortHelper(begin, begin + len, *begin, lessThan);
+    if (outsideSortRange) {
+        thisObject->initSparseArray();
+        for (SparseArrayNode *n = outsideSortRange; n != sparse->sparse()->end(); n = n->nextNode()) {
+            PropertyAttributes a = sparse->attrs() ? sparse->attrs()[n->value] : Attr_Data;
+            thisObject->arraySet(n->key(), reinterpret_cast<Property *>(sparse->arrayData() + n->value), a);
+        }
+    }
 
 #ifdef CHECK_SPARSE_ARRAYS
     thisObject->initSparseArray();
@@ -129,7 +129,13 @@ struct ArrayData : public Base {
 };
 
 struct SimpleArrayData : public ArrayData {
-    uint mappedIndex(uint index) const { return (index + offset) % alloc; }
+    // offset and index are both below alloc, so one conditional subtraction
+    // wraps around the ring buffer without paying for a division per access
+    uint mappedIndex(uint index) const {
+        Q_ASSERT(index < alloc && offset < alloc);
+        index += offset;
+        return index >= alloc ? index - alloc : index;
+    }
     Value data(uint index) const { return arrayData[mappedIndex(index)]; }
     Value &data(uint index) { return arrayData[mappedIndex(index)]; }
 
@@ -39,6 +39,8 @@
 #include "qv4runtime_p.h"
 #include "qv4string_p.h"
 
+#include <QtCore/qvarlengtharray.h>
+
 using namespace QV4;
 
 DEFINE_OBJECT_VTABLE(ArrayCtor);
@@ -192,6 +194,64 @@ ReturnedValue ArrayPrototype::method_join(CallContext *ctx)
     if (!r2)
         return ctx->d()->engine->newString()->asReturnedValue();
 
+    // Arrays of primitive values without holes, as built up for CSV or log lines, are written
+    // into one exactly sized buffer. Converting the values in here can't run any JavaScript or
+    // allocate on the JS heap, so nothing can change the array in between the two passes.
+    Heap::SimpleArrayData *simple = self->arrayType() == Heap::ArrayData::Simple
+            ? self->d()->arrayData.cast<Heap::SimpleArrayData>() : 0;
+    if (self->as<ArrayObject>() && simple && !simple->attrs && simple->len >= r2) {
+        QVarLengthArray<QString, 16> numbers;
+        qint64 size = qint64(r2 - 1) * r4.length();
+        uint i = 0;
+        for (; i < r2; ++i) {
+            const Value &e = simple->data(i);
+            if (e.isEmpty()) {
+                // holes need a lookup in the prototype chain
+                break;
+            } else if (e.isString()) {
+                size += e.stringValue()->d()->length();
+            } else if (e.isInteger()) {
+                numbers.append(QString::number(e.integerValue()));
+                size += numbers.last().length();
+            } else if (e.isDouble()) {
+                numbers.append(QString());
+                RuntimeHelpers::numberToString(&numbers.last(), e.doubleValue());
+                size += numbers.last().length();
+            } else if (e.isBoolean()) {
+                size += e.booleanValue() ? 4 : 5;
+            } else if (!e.isNullOrUndefined()) {
+                // objects need their toString() called
+                break;
+            }
+        }
+
+        if (i == r2 && size <= INT_MAX) {
+            QString R(int(size), Qt::Uninitialized);
+            QChar *ch = R.data();
+            int number = 0;
+            for (i = 0; i < r2; ++i) {
+                if (i) {
+                    memcpy(ch, r4.constData(), r4.length() * sizeof(QChar));
+                    ch += r4.length();
+                }
+                const Value &e = simple->data(i);
+                if (e.isString()) {
+                    Heap::String::append(e.stringValue()->d(), ch);
+                    ch += e.stringValue()->d()->length();
+                } else if (e.isNumber()) {
+                    const QString &n = numbers.at(number++);
+                    memcpy(ch, n.constData(), n.length() * sizeof(QChar));
+                    ch += n.length();
+                } else if (e.isBoolean()) {
+                    for (const char *b = e.booleanValue() ? "true" : "false"; *b; ++b)
+                        *ch++ = QLatin1Char(*b);
+                }
+            }
+            Q_ASSERT(ch == R.constData() + R.length());
+            return ctx->d()->engine->newString(R)->asReturnedValue();
+        }
+    }
+
     QString R;
 
     // ### FIXME
@@ -204,7 +264,10 @@ ReturnedValue ArrayPrototype::method_join(CallContext *ctx)
             e = a->getIndexed(i);
             if (scope.hasException())
                 return Encode::undefined();
-            if (!e->isNullOrUndefined())
+            // integers are by far the most common element, and don't need to go through double conversion
+            if (e->isInteger())
+                R += QString::number(e->integerValue());
+            else if (!e->isNullOrUndefined())
                 R += e->toQString();
         }
     } else {
@@ -670,14 +733,28 @@ ReturnedValue ArrayPrototype::method_lastIndexOf(CallContext *ctx)
     }
 
     ScopedValue v(scope);
-    for (uint k = fromIndex; k > 0;) {
-        --k;
-        bool exists;
-        v = instance->getIndexed(k, &exists);
-        if (scope.hasException())
-            return Encode::undefined();
-        if (exists && RuntimeHelpers::strictEqual(v, searchValue))
-            return Encode(k);
+    if (ArgumentsObject::isNonStrictArgumentsObject(instance) ||
+        (instance->arrayType() != Heap::ArrayData::Simple) || instance->protoHasArray()) {
+        for (uint k = fromIndex; k > 0;) {
+            --k;
+            bool exists;
+            v = instance->getIndexed(k, &exists);
+            if (scope.hasException())
+                return Encode::undefined();
+            if (exists && RuntimeHelpers::strictEqual(v, searchValue))
+                return Encode(k);
+        }
+    } else if (instance->arrayData()) {
+        // no accessors and nothing to inherit, so scan the storage directly
+        Heap::SimpleArrayData *sa = instance->d()->arrayData.cast<Heap::SimpleArrayData>();
+        if (fromIndex > sa->len)
+            fromIndex = sa->len;
+        for (uint k = fromIndex; k > 0;) {
+            --k;
+            v = sa->data(k);
+            if (!v->isEmpty() && RuntimeHelpers::strictEqual(v, searchValue))
+                return Encode(k);
+        }
     }
     return Encode(-1);
 }
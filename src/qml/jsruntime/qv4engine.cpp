@@ -54,6 +54,7 @@
 #include <qv4jsonobject_p.h>
 #include <qv4stringobject_p.h>
 #include <qv4identifiertable_p.h>
+#include <qv4lookup_p.h>
 #include "qv4debugging_p.h"
 #include "qv4profiling_p.h"
 #include "qv4executableallocator_p.h"
@@ -200,6 +201,9 @@ ExecutionEngine::ExecutionEngine(EvalISelFactory *factory)
     , memoryManager(new QV4::MemoryManager(this))
     , executableAllocator(new QV4::ExecutableAllocator)
     , regExpAllocator(new QV4::ExecutableAllocator)
+    , jitCallThreshold(3)
+    , jitBackEdgeThreshold(1000)
+    , tierUpWindow(2000)
     , currentContext(0)
     , bumperPointerAllocator(new WTF::BumpPointerAllocator)
     , jsStack(new WTF::PageAllocation)
@@ -211,6 +215,7 @@ ExecutionEngine::ExecutionEngine(EvalISelFactory *factory)
     , nArgumentsAccessors(0)
     , m_engineId(engineSerial.fetchAndAddOrdered(1))
     , regExpCache(0)
+    , lookupStubCache(new LookupStubCache)
     , m_multiplyWrappedQObjects(0)
 {
     MemoryManager::GCBlocker gcBlocker(memoryManager);
@@ -219,15 +224,30 @@ ExecutionEngine::ExecutionEngine(EvalISelFactory *factory)
 
 #ifdef V4_ENABLE_JIT
         static const bool forceMoth = !qgetenv("QV4_FORCE_INTERPRETER").isEmpty();
-        if (forceMoth)
+        if (forceMoth) {
             factory = new Moth::ISelFactory;
-        else
+        } else {
             factory = new JIT::ISelFactory;
+            // Zero compiles everything with the JIT right away
+            bool ok = false;
+            const int callThreshold = qEnvironmentVariableIntValue("QV4_JIT_CALL_THRESHOLD", &ok);
+            if (ok && callThreshold >= 0)
+                jitCallThreshold = callThreshold;
+            const int backEdgeThreshold = qEnvironmentVariableIntValue("QV4_JIT_BACKEDGE_THRESHOLD", &ok);
+            if (ok && backEdgeThreshold > 0)
+                jitBackEdgeThreshold = backEdgeThreshold;
+            const int window = qEnvironmentVariableIntValue("QV4_JIT_TIER_UP_WINDOW", &ok);
+            if (ok && window >= 0)
+                tierUpWindow = window;
+            if (jitCallThreshold)
+                interpreterISelFactory.reset(new Moth::ISelFactory);
+        }
 #else // !V4_ENABLE_JIT
         factory = new Moth::ISelFactory;
 #endif // V4_ENABLE_JIT
     }
     iselFactory.reset(factory);
+    tierUpWindowTimer.start();
 
     // reserve space for the JS stack
     // we allow it to grow to 2 times JSStackLimit, as we can overshoot due to garbage collection
@@ -366,8 +386,7 @@ ExecutionEngine::ExecutionEngine(EvalISelFactory *factory)
     errorProtoClass = errorProtoClass->addMember(id_name(), Attr_Data|Attr_NotEnumerable, &index);
     Q_ASSERT(index == ErrorPrototype::Index_Name);
 
-    jsObjects[GetStack_Function] = BuiltinFunction::create(rootContext(), str = newIdentifier(QStringLiteral("stack")), ErrorObject::method_get_stack);
-    getStackFunction()->defineReadonlyProperty(id_length(), Primitive::fromInt32(0));
+    jsObjects[GetStack_Function] = BuiltinFunction::create(rootContext(), str = newIdentifier(QStringLiteral("stack")), ErrorObject::method_get_stack, 0);
 
     jsObjects[ErrorProto] = memoryManager->allocObject<ErrorPrototype>(errorProtoClass, objectPrototype());
     jsObjects[EvalErrorProto] = memoryManager->allocObject<EvalErrorPrototype>(errorProtoClass, errorPrototype());
@@ -511,6 +530,7 @@ ExecutionEngine::~ExecutionEngine()
     delete classPool;
     delete bumperPointerAllocator;
     delete regExpCache;
+    delete lookupStubCache;
     delete regExpAllocator;
     delete executableAllocator;
     jsStack->deallocate();
@@ -524,6 +544,16 @@ void ExecutionEngine::setDebugger(Debugging::Debugger *debugger_)
     debugger = debugger_;
 }
 
+EvalInstructionSelection *ExecutionEngine::createTieredInstructionSelection(QQmlEnginePrivate *qmlEngine, IR::Module *module, Compiler::JSUnitGenerator *jsGenerator)
+{
+    if (!interpreterISelFactory || debugger)
+        return iselFactory->create(qmlEngine, executableAllocator, module, jsGenerator);
+
+    EvalInstructionSelection *isel = interpreterISelFactory->create(qmlEngine, executableAllocator, module, jsGenerator);
+    isel->setTierUpBackend(iselFactory.data(), qmlEngine);
+    return isel;
+}
+
 void ExecutionEngine::enableProfiler()
 {
     Q_ASSERT(!profiler);
@@ -579,6 +609,12 @@ Heap::Object *ExecutionEngine::newObject(InternalClass *internalClass, QV4::Obje
     return memoryManager->allocObject<Object>(internalClass, prototype);
 }
 
+Heap::Object *ExecutionEngine::newObject(InternalClass *internalClass, QV4::Object *prototype, uint expectedSize)
+{
+    return memoryManager->allocObjectWithInlineSize<Object>(internalClass, prototype,
+                                                            qMin<uint>(expectedSize, Heap::Object::MaxExpectedInlineSize));
+}
+
 Heap::String *ExecutionEngine::newString(const QString &s)
 {
     Scope scope(this);
@@ -973,6 +1009,17 @@ void ExecutionEngine::markObjects()
         (*it)->markObjects(this);
 }
 
+void ExecutionEngine::dropColdTierUpCode()
+{
+    if (!interpreterISelFactory || tierUpWindowTimer.elapsed() < tierUpWindow)
+        return;
+    tierUpWindowTimer.start();
+
+    // Units that release their lazy compiler leave the set, foreach iterates over a copy
+    foreach (CompiledData::CompilationUnit *unit, lazyCompilingUnits)
+        unit->dropColdTierUpCode();
+}
+
 ReturnedValue ExecutionEngine::throwError(const Value &value)
 {
     // we can get in here with an exception already set, as the runtime
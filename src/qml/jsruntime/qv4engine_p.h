@@ -50,6 +50,7 @@
 #include "qv4context_p.h"
 #include "qv4internalclass_p.h"
 #include <private/qintrusivelist_p.h>
+#include <QtCore/qelapsedtimer.h>
 
 namespace WTF {
 class BumpPointerAllocator;
@@ -97,6 +98,15 @@ public:
     ExecutableAllocator *executableAllocator;
     ExecutableAllocator *regExpAllocator;
     QScopedPointer<EvalISelFactory> iselFactory;
+    // When set, scripts and QML documents are compiled with this backend first, the interpreter,
+    // and their functions tier up to iselFactory's backend once they were called jitCallThreshold
+    // times, or their loops ran jitBackEdgeThreshold times, within a window of tierUpWindow
+    // milliseconds. Functions that don't run at all during a window stay interpreted.
+    QScopedPointer<EvalISelFactory> interpreterISelFactory;
+    uint jitCallThreshold;
+    uint jitBackEdgeThreshold;
+    int tierUpWindow;
+    QElapsedTimer tierUpWindowTimer;
 
     ExecutionContext *currentContext;
 
@@ -339,10 +349,13 @@ public:
     String *id_lastIndex() const { return reinterpret_cast<String *>(jsStrings + String_lastIndex); }
 
     QSet<CompiledData::CompilationUnit*> compilationUnits;
+    // The units that still have functions to compile when first called or to tier up
+    QSet<CompiledData::CompilationUnit*> lazyCompilingUnits;
 
     quint32 m_engineId;
 
     RegExpCache *regExpCache;
+    LookupStubCache *lookupStubCache;
 
     // Scarce resources are "exceptionally high cost" QVariant types where allowing the
     // normal JavaScript GC to clean them up is likely to lead to out-of-memory or other
@@ -369,6 +382,9 @@ public:
     void setDebugger(Debugging::Debugger *debugger);
     void enableProfiler();
 
+    // For code whose IR stays available, so that its functions can tier up
+    EvalInstructionSelection *createTieredInstructionSelection(QQmlEnginePrivate *qmlEngine, IR::Module *module, Compiler::JSUnitGenerator *jsGenerator);
+
     ExecutionContext *pushGlobalContext();
     void pushContext(Heap::ExecutionContext *context);
     void pushContext(ExecutionContext *context);
@@ -377,6 +393,7 @@ public:
 
     Heap::Object *newObject();
     Heap::Object *newObject(InternalClass *internalClass, Object *prototype);
+    Heap::Object *newObject(InternalClass *internalClass, Object *prototype, uint expectedSize);
 
     Heap::String *newString(const QString &s = QString());
     Heap::String *newIdentifier(const QString &text);
@@ -426,6 +443,9 @@ public:
     void requireArgumentsAccessors(int n);
 
     void markObjects();
+    // Called after garbage collection. Once the current tier-up window is over, lets the
+    // compilation units release the IR of the functions that didn't run during it.
+    void dropColdTierUpCode();
 
     void initRootContext();
 
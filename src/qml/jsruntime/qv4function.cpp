@@ -49,6 +49,10 @@ Function::Function(ExecutionEngine *engine, CompiledData::CompilationUnit *unit,
         , compilationUnit(unit)
         , code(codePtr)
         , codeData(0)
+        , expectedObjectSize(0)
+        , interpreterCode(0)
+        , interpreterCallCount(0)
+        , interpreterBackEdgeCount(0)
 {
     Q_UNUSED(engine);
 
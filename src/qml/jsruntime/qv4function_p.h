@@ -62,6 +62,13 @@ struct Q_QML_EXPORT Function {
     InternalClass *internalClass;
     uint nFormals;
     bool activationRequired;
+    // number of properties the last object constructed by this function ended up with
+    uint expectedObjectSize;
+
+    // Counted while the function runs in the interpreter and can still tier up to the JIT
+    const uchar *interpreterCode;
+    uint interpreterCallCount;
+    uint interpreterBackEdgeCount;
 
     Function(ExecutionEngine *engine, CompiledData::CompilationUnit *unit, const CompiledData::Function *function,
              ReturnedValue (*codePtr)(ExecutionEngine *, const uchar *));
@@ -78,6 +85,8 @@ struct Q_QML_EXPORT Function {
     inline bool usesArgumentsObject() const { return compiledFunction->flags & CompiledData::Function::UsesArgumentsObject; }
     inline bool isStrict() const { return compiledFunction->flags & CompiledData::Function::IsStrict; }
     inline bool isNamedExpression() const { return compiledFunction->flags & CompiledData::Function::IsNamedExpression; }
+    inline bool isNumericComparator() const { return compiledFunction->flags & CompiledData::Function::IsNumericComparator; }
+    inline bool isReversedNumericComparator() const { return compiledFunction->flags & CompiledData::Function::IsReversedNumericComparator; }
 
     inline bool needsActivation() const
     { return activationRequired; }
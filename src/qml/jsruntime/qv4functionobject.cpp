@@ -430,7 +430,7 @@ ReturnedValue ScriptFunction::construct(const Managed *that, CallData *callData)
 
     InternalClass *ic = scope.engine->emptyClass;
     ScopedObject proto(scope, f->protoForConstructor());
-    ScopedObject obj(scope, v4->newObject(ic, proto));
+    ScopedObject obj(scope, v4->newObject(ic, proto, f->function()->expectedObjectSize));
 
     callData->thisObject = obj.asReturnedValue();
     Scoped<CallContext> ctx(scope, v4->currentContext->newCallContext(f, callData));
@@ -446,6 +446,7 @@ ReturnedValue ScriptFunction::construct(const Managed *that, CallData *callData)
 
     if (result->isObject())
         return result->asReturnedValue();
+    f->function()->expectedObjectSize = obj->internalClass()->size;
     return obj.asReturnedValue();
 }
 
@@ -519,7 +520,8 @@ ReturnedValue SimpleScriptFunction::construct(const Managed *that, CallData *cal
 
     InternalClass *ic = scope.engine->emptyClass;
     ScopedObject proto(scope, f->protoForConstructor());
-    callData->thisObject = v4->newObject(ic, proto);
+    ScopedObject obj(scope, v4->newObject(ic, proto, f->function()->expectedObjectSize));
+    callData->thisObject = obj;
 
     CallContext::Data ctx(v4);
 #ifndef QT_NO_DEBUG
@@ -543,8 +545,10 @@ ReturnedValue SimpleScriptFunction::construct(const Managed *that, CallData *cal
     if (f->function()->compiledFunction->hasQmlDependencies())
         QQmlPropertyCapture::registerQmlDependencies(v4, f->function()->compiledFunction);
 
-    if (!result)
-        return callData->thisObject.asReturnedValue();
+    if (!result) {
+        f->function()->expectedObjectSize = obj->internalClass()->size;
+        return obj.asReturnedValue();
+    }
     return result.asReturnedValue();
 }
 
@@ -604,6 +608,17 @@ Heap::BuiltinFunction::BuiltinFunction(QV4::ExecutionContext *scope, QV4::String
 {
 }
 
+Heap::BuiltinFunction::BuiltinFunction(QV4::ExecutionContext *scope, QV4::String *name, ReturnedValue (*code)(QV4::CallContext *), int argumentCount)
+    : code(code)
+{
+    this->scope = scope->d();
+
+    Q_ASSERT(internalClass && internalClass->find(internalClass->engine->id_name()) == SimpleScriptFunction::Index_Name);
+    Q_ASSERT(internalClass && internalClass->find(internalClass->engine->id_length()) == SimpleScriptFunction::Index_Length);
+    *propertyData(SimpleScriptFunction::Index_Name) = name->d();
+    *propertyData(SimpleScriptFunction::Index_Length) = Primitive::fromInt32(argumentCount);
+}
+
 ReturnedValue BuiltinFunction::construct(const Managed *f, CallData *)
 {
     return static_cast<const BuiltinFunction *>(f)->internalClass()->engine->throwTypeError();
@@ -90,6 +90,7 @@ struct FunctionPrototype : FunctionObject {
 
 struct Q_QML_EXPORT BuiltinFunction : FunctionObject {
     BuiltinFunction(QV4::ExecutionContext *scope, QV4::String *name, ReturnedValue (*code)(QV4::CallContext *));
+    BuiltinFunction(QV4::ExecutionContext *scope, QV4::String *name, ReturnedValue (*code)(QV4::CallContext *), int argumentCount);
     ReturnedValue (*code)(QV4::CallContext *);
 };
 
@@ -190,10 +191,20 @@ struct FunctionPrototype: FunctionObject
 
 struct Q_QML_EXPORT BuiltinFunction: FunctionObject {
     V4_OBJECT2(BuiltinFunction, FunctionObject)
+    // Builtins are created with their name and length slots already in place,
+    // so setting up the global object does not walk class transitions for each one.
+    V4_INTERNALCLASS(simpleScriptFunctionClass)
+
+    static Heap::BuiltinFunction *create(ExecutionContext *scope, String *name, ReturnedValue (*code)(CallContext *), int argumentCount)
+    {
+        return scope->engine()->memoryManager->allocObject<BuiltinFunction>(scope, name, code, argumentCount);
+    }
 
+    // For accessors and the like, which have no length property
     static Heap::BuiltinFunction *create(ExecutionContext *scope, String *name, ReturnedValue (*code)(CallContext *))
     {
-        return scope->engine()->memoryManager->allocObject<BuiltinFunction>(scope, name, code);
+        ExecutionEngine *e = scope->engine();
+        return e->memoryManager->allocObject<BuiltinFunction>(e->functionClass, e->functionPrototype(), scope, name, code);
     }
 
     static ReturnedValue construct(const Managed *, CallData *);
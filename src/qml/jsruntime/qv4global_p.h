@@ -180,6 +180,7 @@ struct InternalClass;
 struct Property;
 struct Value;
 struct Lookup;
+struct LookupStubCache;
 struct ArrayData;
 struct VTable;
 
@@ -36,32 +36,26 @@ QT_BEGIN_NAMESPACE
 
 namespace QV4 {
 
-static const uchar prime_deltas[] = {
-    0,  0,  1,  3,  1,  5,  3,  3,  1,  9,  7,  5,  3,  9, 25,  3,
-    1, 21,  3, 21,  7, 15,  9,  5,  3, 29, 15,  0,  0,  0,  0,  0
-};
-
-static inline int primeForNumBits(int numBits)
+static inline bool equals(const Heap::String *e, const QChar *ch, int length)
 {
-    return (1 << numBits) + prime_deltas[numBits];
+    return e->text->size == length && !memcmp(e->text->data(), ch, length * sizeof(QChar));
 }
 
-
 IdentifierTable::IdentifierTable(ExecutionEngine *engine)
     : engine(engine)
     , size(0)
     , numBits(8)
 {
-    alloc = primeForNumBits(numBits);
-    entries = (Heap::String **)malloc(alloc*sizeof(Heap::String *));
-    memset(entries, 0, alloc*sizeof(Heap::String *));
+    alloc = 1 << numBits;
+    entries = (Entry *)malloc(alloc*sizeof(Entry));
+    memset(entries, 0, alloc*sizeof(Entry));
 }
 
 IdentifierTable::~IdentifierTable()
 {
     for (int i = 0; i < alloc; ++i)
-        if (entries[i])
-            delete entries[i]->identifier;
+        if (entries[i].string)
+            delete entries[i].string->identifier;
     free(entries);
 }
 
@@ -79,32 +73,29 @@ void IdentifierTable::addEntry(Heap::String *str)
     bool grow = (alloc <= size*2);
 
     if (grow) {
+        Entry *oldEntries = entries;
+        int oldAlloc = alloc;
         ++numBits;
-        int newAlloc = primeForNumBits(numBits);
-        Heap::String **newEntries = (Heap::String **)malloc(newAlloc*sizeof(Heap::String *));
-        memset(newEntries, 0, newAlloc*sizeof(Heap::String *));
-        for (int i = 0; i < alloc; ++i) {
-            Heap::String *e = entries[i];
-            if (!e)
+        alloc = 1 << numBits;
+        entries = (Entry *)malloc(alloc*sizeof(Entry));
+        memset(entries, 0, alloc*sizeof(Entry));
+        for (int i = 0; i < oldAlloc; ++i) {
+            const Entry &e = oldEntries[i];
+            if (!e.string)
                 continue;
-            uint idx = e->stringHash % newAlloc;
-            while (newEntries[idx]) {
-                ++idx;
-                idx %= newAlloc;
-            }
-            newEntries[idx] = e;
+            uint idx = bucket(e.hash);
+            while (entries[idx].string)
+                idx = nextBucket(idx);
+            entries[idx] = e;
         }
-        free(entries);
-        entries = newEntries;
-        alloc = newAlloc;
+        free(oldEntries);
     }
 
-    uint idx = hash % alloc;
-    while (entries[idx]) {
-        ++idx;
-        idx %= alloc;
-    }
-    entries[idx] = str;
+    uint idx = bucket(hash);
+    while (entries[idx].string)
+        idx = nextBucket(idx);
+    entries[idx].hash = hash;
+    entries[idx].string = str;
     ++size;
 }
 
@@ -113,12 +104,11 @@ void IdentifierTable::addEntry(Heap::String *str)
 Heap::String *IdentifierTable::insertString(const QString &s)
 {
     uint hash = String::createHashValue(s.constData(), s.length());
-    uint idx = hash % alloc;
-    while (Heap::String *e = entries[idx]) {
-        if (e->stringHash == hash && e->toQString() == s)
+    uint idx = bucket(hash);
+    while (Heap::String *e = entries[idx].string) {
+        if (entries[idx].hash == hash && equals(e, s.constData(), s.length()))
             return e;
-        ++idx;
-        idx %= alloc;
+        idx = nextBucket(idx);
     }
 
     Heap::String *str = engine->newString(s);
@@ -135,14 +125,13 @@ Identifier *IdentifierTable::identifierImpl(const Heap::String *str)
     if (str->subtype == Heap::String::StringType_ArrayIndex)
         return 0;
 
-    uint idx = hash % alloc;
-    while (Heap::String *e = entries[idx]) {
-        if (e->stringHash == hash && e->isEqualTo(str)) {
+    uint idx = bucket(hash);
+    while (Heap::String *e = entries[idx].string) {
+        if (entries[idx].hash == hash && e->isEqualTo(str)) {
             str->identifier = e->identifier;
             return e->identifier;
         }
-        ++idx;
-        idx %= alloc;
+        idx = nextBucket(idx);
     }
 
     addEntry(const_cast<QV4::Heap::String *>(str));
@@ -154,14 +143,13 @@ Heap::String *IdentifierTable::stringFromIdentifier(Identifier *i)
     if (!i)
         return 0;
 
-    uint idx = i->hashValue % alloc;
+    uint idx = bucket(i->hashValue);
     while (1) {
-        Heap::String *e = entries[idx];
+        Heap::String *e = entries[idx].string;
         Q_ASSERT(e);
         if (e->identifier == i)
             return e;
-        ++idx;
-        idx %= alloc;
+        idx = nextBucket(idx);
     }
 }
 
@@ -177,12 +165,11 @@ Identifier *IdentifierTable::identifier(const char *s, int len)
         return identifier(QString::fromUtf8(s, len));
 
     QLatin1String latin(s, len);
-    uint idx = hash % alloc;
-    while (Heap::String *e = entries[idx]) {
-        if (e->stringHash == hash && e->toQString() == latin)
+    uint idx = bucket(hash);
+    while (Heap::String *e = entries[idx].string) {
+        if (entries[idx].hash == hash && e->toQString() == latin)
             return e->identifier;
-        ++idx;
-        idx %= alloc;
+        idx = nextBucket(idx);
     }
 
     Heap::String *str = engine->newString(QString::fromLatin1(s, len));
@@ -55,12 +55,25 @@ namespace QV4 {
 
 struct IdentifierTable
 {
+    // The hash is kept next to the string, so that probing and rehashing don't need to touch
+    // the strings themselves.
+    struct Entry {
+        uint hash;
+        Heap::String *string;
+    };
+
     ExecutionEngine *engine;
 
     int alloc;
     int size;
     int numBits;
-    Heap::String **entries;
+    Entry *entries;
+
+    // alloc is a power of two. Multiplying with 2^32 divided by the golden ratio spreads the
+    // hashes of similar strings and numbers over the whole table, and the index is taken from
+    // the well mixed upper bits.
+    uint bucket(uint hash) const { return (hash * 0x9e3779b9u) >> (32 - numBits); }
+    uint nextBucket(uint idx) const { return (idx + 1) & (alloc - 1); }
 
     void addEntry(Heap::String *str);
 
@@ -89,7 +102,7 @@ public:
 
     void mark(ExecutionEngine *e) {
         for (int i = 0; i < alloc; ++i) {
-            Heap::String *entry = entries[i];
+            Heap::String *entry = entries[i].string;
             if (!entry || entry->isMarked())
                 continue;
             entry->setMarkBit();
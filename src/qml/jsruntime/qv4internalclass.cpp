@@ -38,6 +38,9 @@
 #include "qv4object_p.h"
 #include "qv4identifiertable_p.h"
 
+#include <QtCore/qvarlengtharray.h>
+#include <new>
+
 QT_BEGIN_NAMESPACE
 
 using namespace QV4;
@@ -81,13 +84,16 @@ void PropertyHash::addEntry(const PropertyHash::Entry &entry, int classSize)
             dd->entries[idx] = e;
         }
         dd->size = classSize;
-        Q_ASSERT(d->refCount > 1);
-        --d->refCount;
+        // only dictionary classes own their table exclusively, and they never shrink it here
+        Q_ASSERT(grow || d->refCount > 1);
+        if (!--d->refCount)
+            delete d;
         d = dd;
     }
 
+    // takes over the tombstone if a dictionary gets a removed member back
     uint idx = entry.identifier->hashValue % d->alloc;
-    while (d->entries[idx].identifier) {
+    while (d->entries[idx].identifier && d->entries[idx].identifier != entry.identifier) {
         ++idx;
         idx %= d->alloc;
     }
@@ -95,6 +101,21 @@ void PropertyHash::addEntry(const PropertyHash::Entry &entry, int classSize)
     ++d->size;
 }
 
+void PropertyHash::removeEntry(const Identifier *identifier)
+{
+    // only dictionary classes remove members, and they own their table exclusively
+    Q_ASSERT(d->refCount == 1);
+    uint idx = identifier->hashValue % d->alloc;
+    while (d->entries[idx].identifier != identifier) {
+        Q_ASSERT(d->entries[idx].identifier);
+        ++idx;
+        idx %= d->alloc;
+    }
+    // The entry stays as a tombstone, so that the entries behind it can still be found. It is
+    // dropped when the table grows.
+    d->entries[idx].index = UINT_MAX;
+}
+
 uint PropertyHash::lookup(const Identifier *identifier) const
 {
     Q_ASSERT(d->entries);
@@ -116,6 +137,10 @@ InternalClass::InternalClass(ExecutionEngine *engine)
     , m_frozen(0)
     , size(0)
     , extensible(true)
+    , isDictionary(false)
+    , dictionaryOwner(0)
+    , holes(0)
+    , m_enumerableMembers(0)
 {
 }
 
@@ -130,26 +155,21 @@ InternalClass::InternalClass(const QV4::InternalClass &other)
     , m_frozen(0)
     , size(other.size)
     , extensible(other.extensible)
+    , isDictionary(false)
+    , dictionaryOwner(0)
+    , holes(0)
+    , m_enumerableMembers(0)
 {
     Q_ASSERT(extensible);
 }
 
 static void insertHoleIntoPropertyData(Object *object, int idx)
 {
-    int inlineSize = object->d()->inlineMemberSize;
+    // the object has already been resized for the new class, and the slots
+    // may be split between the inline storage and the MemberData
     int icSize = object->internalClass()->size;
-    int from = qMax(idx, inlineSize);
-    int to = from + 1;
-    if (from < icSize)
-        memmove(object->propertyData(to), object->propertyData(from), icSize - from - 1);
-    if (from == idx)
-        return;
-    if (inlineSize < icSize)
-        *object->propertyData(inlineSize) = *object->propertyData(inlineSize - 1);
-    from = idx;
-    to = from + 1;
-    if (from < inlineSize - 1)
-        memmove(object->propertyData(to), object->propertyData(from), inlineSize - from - 1);
+    for (int i = icSize - 1; i > idx; --i)
+        *object->propertyData(i) = *object->propertyData(i - 1);
 }
 
 static void removeFromPropertyData(Object *object, int idx, bool accessor = false)
@@ -180,22 +200,39 @@ void InternalClass::changeMember(Object *object, String *string, PropertyAttribu
 {
     uint idx;
     InternalClass *oldClass = object->internalClass();
-    InternalClass *newClass = oldClass->changeMember(string->identifier(), data, &idx);
+    uint oldSize = oldClass->size;
+    InternalClass *newClass;
+    if (oldClass->isDictionary) {
+        data.resolve();
+        idx = oldClass->find(string->identifier());
+        Q_ASSERT(idx != UINT_MAX);
+        if (oldClass->holes && data.isAccessor() != oldClass->propertyData.at(idx).isAccessor()) {
+            // the setter slot gets inserted or removed, which moves the members behind it
+            oldClass->compactDictionary(object);
+            oldSize = oldClass->size;
+            idx = oldClass->find(string->identifier());
+        }
+        oldClass->rebuildDictionary(idx, data);
+        newClass = oldClass;
+    } else {
+        newClass = oldClass->changeMember(string->identifier(), data, &idx);
+    }
     if (index)
         *index = idx;
 
     object->setInternalClass(newClass);
-    if (newClass->size > oldClass->size) {
-        Q_ASSERT(newClass->size == oldClass->size + 1);
+    if (newClass->size > oldSize) {
+        Q_ASSERT(newClass->size == oldSize + 1);
         insertHoleIntoPropertyData(object, idx + 1);
-    } else if (newClass->size < oldClass->size) {
-        Q_ASSERT(newClass->size == oldClass->size - 1);
+    } else if (newClass->size < oldSize) {
+        Q_ASSERT(newClass->size == oldSize - 1);
         removeFromPropertyData(object, idx + 1);
     }
 }
 
 InternalClassTransition &InternalClass::lookupOrInsertTransition(const InternalClassTransition &t)
 {
+    Q_ASSERT(!isDictionary);
     std::vector<Transition>::iterator it = std::lower_bound(transitions.begin(), transitions.end(), t);
     if (it != transitions.end() && *it == t) {
         return *it;
@@ -242,6 +279,11 @@ InternalClass *InternalClass::nonExtensible()
     if (!extensible)
         return this;
 
+    if (isDictionary) {
+        extensible = false;
+        return this;
+    }
+
     Transition temp = { Q_NULLPTR, Q_NULLPTR, Transition::NotExtensible};
     Transition &t = lookupOrInsertTransition(temp);
     if (t.lookup)
@@ -264,8 +306,21 @@ void InternalClass::addMember(Object *object, String *string, PropertyAttributes
         return;
     }
 
+    if (!object->internalClass()->isDictionary && object->internalClass()->size >= DictionaryModeSize
+            && canBecomeDictionary(object))
+        toDictionary(object);
+
+    InternalClass *ic = object->internalClass();
+    if (ic->isDictionary) {
+        if (index)
+            *index = ic->size;
+        ic->appendDictionaryMember(string->identifier(), data);
+        object->setInternalClass(ic);
+        return;
+    }
+
     uint idx;
-    InternalClass *newClass = object->internalClass()->addMemberImpl(string->identifier(), data, &idx);
+    InternalClass *newClass = ic->addMemberImpl(string->identifier(), data, &idx);
     if (index)
         *index = idx;
 
@@ -326,11 +381,22 @@ void InternalClass::removeMember(Object *object, Identifier *id)
     uint propIdx = oldClass->propertyTable.lookup(id);
     Q_ASSERT(propIdx < oldClass->size);
 
+    bool accessor = oldClass->propertyData.at(propIdx).isAccessor();
+
+    // Rebuilding a shared class without the member creates a whole new chain of
+    // transitions, objects used as hash maps would fill the pool with those
+    if (!oldClass->isDictionary && oldClass->size >= DictionaryModeDeleteSize && canBecomeDictionary(object)) {
+        toDictionary(object);
+        oldClass = object->internalClass();
+    }
+    if (oldClass->isDictionary) {
+        oldClass->removeDictionaryMember(object, propIdx);
+        return;
+    }
+
     Transition temp = { id, 0, -1 };
     Transition &t = object->internalClass()->lookupOrInsertTransition(temp);
 
-    bool accessor = oldClass->propertyData.at(propIdx).isAccessor();
-
     if (t.lookup) {
         object->setInternalClass(t.lookup);
     } else {
@@ -380,18 +446,31 @@ InternalClass *InternalClass::sealed()
     if (m_sealed)
         return m_sealed;
 
-    m_sealed = engine->emptyClass;
+    if (isDictionary) {
+        for (uint i = 0; i < size; ++i) {
+            PropertyAttributes attrs = propertyData.at(i);
+            if (attrs.isEmpty() || !attrs.isConfigurable())
+                continue;
+            attrs.setConfigurable(false);
+            propertyData.set(i, attrs);
+        }
+        extensible = false;
+        return this;
+    }
+
+    InternalClass *s = engine->emptyClass;
     for (uint i = 0; i < size; ++i) {
         PropertyAttributes attrs = propertyData.at(i);
         if (attrs.isEmpty())
             continue;
         attrs.setConfigurable(false);
-        m_sealed = m_sealed->addMember(nameMap.at(i), attrs);
+        s = s->addMember(nameMap.at(i), attrs);
     }
-    m_sealed = m_sealed->nonExtensible();
+    s = s->nonExtensible();
 
-    m_sealed->m_sealed = m_sealed;
-    return m_sealed;
+    s->m_sealed = s;
+    m_sealed = s;
+    return s;
 }
 
 InternalClass *InternalClass::frozen()
@@ -399,12 +478,49 @@ InternalClass *InternalClass::frozen()
     if (m_frozen)
         return m_frozen;
 
-    m_frozen = propertiesFrozen();
-    m_frozen = m_frozen->nonExtensible();
+    if (isDictionary) {
+        for (uint i = 0; i < size; ++i) {
+            PropertyAttributes attrs = propertyData.at(i);
+            if (attrs.isEmpty())
+                continue;
+            attrs.setWritable(false);
+            attrs.setConfigurable(false);
+            propertyData.set(i, attrs);
+        }
+        extensible = false;
+        return this;
+    }
+
+    InternalClass *f = propertiesFrozen();
+    f = f->nonExtensible();
+
+    f->m_frozen = f;
+    f->m_sealed = f;
+    m_frozen = f;
+    return f;
+}
+
+bool InternalClass::isSealed() const
+{
+    if (extensible)
+        return false;
+    for (uint i = 0; i < size; ++i) {
+        if (propertyData.at(i).isConfigurable())
+            return false;
+    }
+    return true;
+}
 
-    m_frozen->m_frozen = m_frozen;
-    m_frozen->m_sealed = m_frozen;
-    return m_frozen;
+bool InternalClass::isFrozen() const
+{
+    if (extensible)
+        return false;
+    for (uint i = 0; i < size; ++i) {
+        PropertyAttributes attrs = propertyData.at(i);
+        if (attrs.isConfigurable() || (attrs.isData() && attrs.isWritable()))
+            return false;
+    }
+    return true;
 }
 
 InternalClass *InternalClass::propertiesFrozen() const
@@ -431,6 +547,7 @@ void InternalClass::destroy()
         if (!next->engine)
             continue;
         next->engine = 0;
+        next->dropEnumerableMembers();
         next->propertyTable.~PropertyHash();
         next->nameMap.~SharedInternalClassData<Identifier *>();
         next->propertyData.~SharedInternalClassData<PropertyAttributes>();
@@ -448,9 +565,201 @@ void InternalClass::destroy()
     }
 }
 
+uint *InternalClass::buildEnumerableMembers()
+{
+    Q_ASSERT(!m_enumerableMembers);
+    uint count = 0;
+    for (uint i = 0; i < size; ++i) {
+        if (nameMap.at(i) && propertyData.at(i).isEnumerable())
+            ++count;
+    }
+
+    m_enumerableMembers = (uint *)malloc((count + 1) * sizeof(uint));
+    m_enumerableMembers[0] = count;
+    uint *member = m_enumerableMembers + 1;
+    for (uint i = 0; i < size; ++i) {
+        // accessors have a dummy entry without a name
+        if (nameMap.at(i) && propertyData.at(i).isEnumerable())
+            *member++ = i;
+    }
+    return m_enumerableMembers;
+}
+
+void InternalClass::dropEnumerableMembers()
+{
+    free(m_enumerableMembers);
+    m_enumerableMembers = 0;
+}
+
+bool InternalClass::canBecomeDictionary(Object *object)
+{
+    // global lookups rely on the class of the global object being cacheable
+    return object->d() != object->engine()->globalObject->d();
+}
+
+void InternalClass::toDictionary(Object *object)
+{
+    InternalClass *oldClass = object->internalClass();
+    InternalClass *dictionary = oldClass->engine->classPool->newDictionary(oldClass->engine, object->d());
+    dictionary->extensible = oldClass->extensible;
+    for (uint i = 0; i < oldClass->size; ++i) {
+        PropertyAttributes attrs = oldClass->propertyData.at(i);
+        // skips the second slot of accessors, appending the accessor adds it again
+        if (attrs.isEmpty())
+            continue;
+        dictionary->appendDictionaryMember(oldClass->nameMap.at(i), attrs);
+    }
+    Q_ASSERT(dictionary->size == oldClass->size);
+    // the layout is identical, so the member data can stay as it is
+    object->d()->internalClass = dictionary;
+}
+
+void InternalClass::appendDictionaryMember(Identifier *identifier, PropertyAttributes data)
+{
+    Q_ASSERT(isDictionary);
+    dropEnumerableMembers();
+    PropertyHash::Entry e = { identifier, size };
+    propertyTable.addEntry(e, size);
+    nameMap.add(size, identifier);
+    propertyData.add(size, data);
+    ++size;
+    if (data.isAccessor()) {
+        propertyTable.addEntry(e, size);
+        nameMap.add(size, 0);
+        propertyData.add(size, PropertyAttributes());
+        ++size;
+    }
+}
+
+/*
+    Leaves a hole where the member at index was, since moving the members behind it would change
+    their indices. The hash keeps a tombstone for it. Once half of the slots are holes, the
+    class and the member data of its object get compacted.
+*/
+void InternalClass::removeDictionaryMember(Object *object, uint index)
+{
+    Q_ASSERT(isDictionary && object->internalClass() == this);
+    dropEnumerableMembers();
+    const uint slots = propertyData.at(index).isAccessor() ? 2 : 1;
+    propertyTable.removeEntry(nameMap.at(index));
+    for (uint i = index; i < index + slots; ++i) {
+        nameMap.set(i, 0);
+        propertyData.set(i, PropertyAttributes());
+        *object->propertyData(i) = Primitive::undefinedValue();
+    }
+    holes += slots;
+    if (holes * 2 > size)
+        compactDictionary(object);
+}
+
+void InternalClass::compactDictionary(Object *object)
+{
+    Q_ASSERT(isDictionary && object->internalClass() == this);
+    QVarLengthArray<Identifier *, 64> names;
+    QVarLengthArray<PropertyAttributes, 64> attributes;
+    uint to = 0;
+    for (uint from = 0; from < size; ++from) {
+        PropertyAttributes attrs = propertyData.at(from);
+        // skips the holes and the second slot of accessors, which moves along with the first
+        if (attrs.isEmpty())
+            continue;
+        names.append(nameMap.at(from));
+        attributes.append(attrs);
+        *object->propertyData(to++) = *object->propertyData(from);
+        if (attrs.isAccessor())
+            *object->propertyData(to++) = *object->propertyData(from + 1);
+    }
+    for (uint i = to; i < size; ++i)
+        *object->propertyData(i) = Primitive::undefinedValue();
+
+    resetDictionary(names.constData(), attributes.constData(), names.size());
+    Q_ASSERT(size == to);
+}
+
+void InternalClass::resetDictionary(Identifier *const *names, const PropertyAttributes *attributes, int count)
+{
+    Q_ASSERT(isDictionary);
+    propertyTable.~PropertyHash();
+    new (&propertyTable) PropertyHash;
+    nameMap.~SharedInternalClassData<Identifier *>();
+    new (&nameMap) SharedInternalClassData<Identifier *>;
+    propertyData.~SharedInternalClassData<PropertyAttributes>();
+    new (&propertyData) SharedInternalClassData<PropertyAttributes>;
+    size = 0;
+    holes = 0;
+
+    for (int i = 0; i < count; ++i)
+        appendDictionaryMember(names[i], attributes[i]);
+}
+
+/*
+    Replaces the attributes of the member at index with data. A member that changes between data
+    and accessor needs one slot more or less right where it is, so then the class is built up
+    again from scratch. That's rare, and needs a class without holes.
+*/
+void InternalClass::rebuildDictionary(uint index, PropertyAttributes data)
+{
+    Q_ASSERT(isDictionary && !data.isEmpty());
+    dropEnumerableMembers();
+    if (data.isAccessor() == propertyData.at(index).isAccessor()) {
+        propertyData.set(index, data);
+        return;
+    }
+
+    Q_ASSERT(!holes);
+    QVarLengthArray<Identifier *, 64> names;
+    QVarLengthArray<PropertyAttributes, 64> attributes;
+    for (uint i = 0; i < size; ++i) {
+        PropertyAttributes attrs = i == index ? data : propertyData.at(i);
+        if (attrs.isEmpty())
+            continue;
+        names.append(nameMap.at(i));
+        attributes.append(attrs);
+    }
+    resetDictionary(names.constData(), attributes.constData(), names.size());
+}
+
+InternalClassPool::~InternalClassPool()
+{
+    for (int i = 0; i < dictionaries.size(); ++i)
+        dictionaries.at(i)->destroy();
+}
+
 void InternalClassPool::markObjects(ExecutionEngine *engine)
 {
     Q_UNUSED(engine);
 }
 
+InternalClass *InternalClassPool::newDictionary(ExecutionEngine *engine, Heap::Object *owner)
+{
+    InternalClass *ic;
+    if (!unusedDictionaries.isEmpty()) {
+        ic = unusedDictionaries.takeLast();
+        ::new (ic) InternalClass(engine);
+    } else {
+        ic = new (this) InternalClass(engine);
+    }
+    ic->isDictionary = true;
+    ic->dictionaryOwner = owner;
+    dictionaries.append(ic);
+    return ic;
+}
+
+void InternalClassPool::sweepDictionaries()
+{
+    int i = 0;
+    while (i < dictionaries.size()) {
+        InternalClass *ic = dictionaries.at(i);
+        Heap::Object *owner = ic->dictionaryOwner;
+        if (owner->isMarked() && owner->internalClass == ic) {
+            ++i;
+            continue;
+        }
+        ic->destroy();
+        unusedDictionaries.append(ic);
+        dictionaries[i] = dictionaries.last();
+        dictionaries.removeLast();
+    }
+}
+
 QT_END_NAMESPACE
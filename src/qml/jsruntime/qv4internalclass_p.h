@@ -47,6 +47,7 @@
 #include "qv4global_p.h"
 
 #include <QHash>
+#include <QVector>
 #include <private/qqmljsmemorypool_p.h>
 
 QT_BEGIN_NAMESPACE
@@ -74,6 +75,7 @@ struct PropertyHash
     inline ~PropertyHash();
 
     void addEntry(const Entry &entry, int classSize);
+    void removeEntry(const Identifier *identifier);
     uint lookup(const Identifier *identifier) const;
 
 private:
@@ -231,6 +233,19 @@ struct InternalClass : public QQmlJS::Managed {
 
     uint size;
     bool extensible;
+    // Dictionary classes belong to a single object and are changed in place instead of
+    // going through transitions. Lookups must never cache them.
+    bool isDictionary;
+    Heap::Object *dictionaryOwner;
+    // deleted members of a dictionary, which keep their slots until it gets compacted
+    uint holes;
+
+    enum {
+        // objects growing beyond this many members get a dictionary class
+        DictionaryModeSize = 128,
+        // deleting a member from an object of at least this size gives it a dictionary class
+        DictionaryModeDeleteSize = 16
+    };
 
     InternalClass *nonExtensible();
     static void addMember(Object *object, String *string, PropertyAttributes data, uint *index);
@@ -242,22 +257,51 @@ struct InternalClass : public QQmlJS::Managed {
     uint find(const String *s);
     uint find(const Identifier *id);
 
+    // Dictionary classes are sealed and frozen in place, since they belong to a single object.
     InternalClass *sealed();
     InternalClass *frozen();
     InternalClass *propertiesFrozen() const;
+    bool isSealed() const;
+    bool isFrozen() const;
+
+    // The indices of all enumerable members, with their count in the first entry. Built
+    // on first use, since the class never changes afterwards (dictionaries drop it).
+    const uint *enumerableMembers()
+    { return m_enumerableMembers ? m_enumerableMembers : buildEnumerableMembers(); }
 
     void destroy();
 
 private:
+    uint *m_enumerableMembers;
+    uint *buildEnumerableMembers();
+    void dropEnumerableMembers();
     InternalClass *addMemberImpl(Identifier *identifier, PropertyAttributes data, uint *index);
+    static bool canBecomeDictionary(Object *object);
+    static void toDictionary(Object *object);
+    void appendDictionaryMember(Identifier *identifier, PropertyAttributes data);
+    void removeDictionaryMember(Object *object, uint index);
+    void compactDictionary(Object *object);
+    void resetDictionary(Identifier *const *names, const PropertyAttributes *attributes, int count);
+    void rebuildDictionary(uint index, PropertyAttributes data);
     friend struct ExecutionEngine;
+    friend struct InternalClassPool;
     InternalClass(ExecutionEngine *engine);
     InternalClass(const InternalClass &other);
 };
 
 struct InternalClassPool : public QQmlJS::MemoryPool
 {
+    ~InternalClassPool();
+
     void markObjects(ExecutionEngine *engine);
+
+    InternalClass *newDictionary(ExecutionEngine *engine, Heap::Object *owner);
+    // called by the garbage collector after marking, recycles the classes of dead objects
+    void sweepDictionaries();
+
+private:
+    QVector<InternalClass *> dictionaries;
+    QVector<InternalClass *> unusedDictionaries;
 };
 
 }
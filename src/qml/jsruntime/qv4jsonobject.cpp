@@ -65,7 +65,50 @@ DEFINE_OBJECT_VTABLE(JsonObject);
 static const int nestingLimit = 1024;
 
 
-JsonParser::JsonParser(ExecutionEngine *engine, const QChar *json, int length)
+static inline ushort unit(QChar c)
+{
+    return c.unicode();
+}
+
+static inline ushort unit(uchar c)
+{
+    return c;
+}
+
+static inline void appendRun(QString *string, const QChar *begin, int length)
+{
+    string->append(begin, length);
+}
+
+static inline void appendRun(QString *string, const uchar *begin, int length)
+{
+    // multi-byte sequences never contain the quote or backslash byte, so they are never split
+    string->append(QString::fromUtf8(reinterpret_cast<const char *>(begin), length));
+}
+
+// A byte beyond ASCII is only part of a UTF-8 sequence, and can't be compared to a UTF-16 unit
+static inline bool isWholeCharacter(QChar)
+{
+    return true;
+}
+
+static inline bool isWholeCharacter(uchar c)
+{
+    return c < 0x80;
+}
+
+static inline QString numberString(const QChar *begin, int length)
+{
+    return QString(begin, length);
+}
+
+static inline QString numberString(const uchar *begin, int length)
+{
+    return QString::fromLatin1(reinterpret_cast<const char *>(begin), length);
+}
+
+template <typename CharType>
+JsonParser<CharType>::JsonParser(ExecutionEngine *engine, const CharType *json, int length)
     : engine(engine), head(json), json(json), nestingLevel(0), lastError(QJsonParseError::NoError)
 {
     end = json + length;
@@ -113,27 +156,30 @@ enum {
     Quote = 0x22
 };
 
-bool JsonParser::eatSpace()
+template <typename CharType>
+bool JsonParser<CharType>::eatSpace()
 {
     while (json < end) {
-        if (*json > Space)
+        ushort c = unit(*json);
+        if (c > Space)
             break;
-        if (*json != Space &&
-            *json != Tab &&
-            *json != LineFeed &&
-            *json != Return)
+        if (c != Space &&
+            c != Tab &&
+            c != LineFeed &&
+            c != Return)
             break;
         ++json;
     }
     return (json < end);
 }
 
-QChar JsonParser::nextToken()
+template <typename CharType>
+ushort JsonParser<CharType>::nextToken()
 {
     if (!eatSpace())
         return 0;
-    QChar token = *json++;
-    switch (token.unicode()) {
+    ushort token = unit(*json++);
+    switch (token) {
     case BeginArray:
     case BeginObject:
     case NameSeparator:
@@ -153,7 +199,8 @@ QChar JsonParser::nextToken()
 /*
     JSON-text = object / array
 */
-ReturnedValue JsonParser::parse(QJsonParseError *error)
+template <typename CharType>
+ReturnedValue JsonParser<CharType>::parse(QJsonParseError *error)
 {
 #ifdef PARSER_DEBUG
     indent = 0;
@@ -194,7 +241,8 @@ ReturnedValue JsonParser::parse(QJsonParseError *error)
     end-object
 */
 
-ReturnedValue JsonParser::parseObject()
+template <typename CharType>
+ReturnedValue JsonParser<CharType>::parseObject()
 {
     if (++nestingLevel > nestingLimit) {
         lastError = QJsonParseError::DeepNesting;
@@ -204,11 +252,16 @@ ReturnedValue JsonParser::parseObject()
     BEGIN << "parseObject pos=" << json;
     Scope scope(engine);
 
-    ScopedObject o(scope, engine->newObject());
+    if (objectShapes.size() <= nestingLevel)
+        objectShapes.resize(nestingLevel + 1);
+    InternalClass *shape = objectShapes.at(nestingLevel);
+    ScopedObject o(scope, engine->newObject(engine->emptyClass, engine->objectPrototype(),
+                                            shape ? shape->size : 0));
+    bool followsShape = shape != 0;
 
-    QChar token = nextToken();
+    ushort token = nextToken();
     while (token == Quote) {
-        if (!parseMember(o))
+        if (!parseMember(o, shape, &followsShape))
             return Encode::undefined();
         token = nextToken();
         if (token != ValueSeparator)
@@ -228,22 +281,39 @@ ReturnedValue JsonParser::parseObject()
 
     END;
 
+    // dictionary classes belong to their object, they can't describe the next one
+    InternalClass *ic = o->internalClass();
+    objectShapes[nestingLevel] = ic->isDictionary ? 0 : ic;
     --nestingLevel;
     return o.asReturnedValue();
 }
 
 /*
     member = string name-separator value
+
+    As long as followsShape is set, o has the same members as the first ones of shape,
+    so its next member is likely to be the next one of shape as well.
 */
-bool JsonParser::parseMember(Object *o)
+template <typename CharType>
+bool JsonParser<CharType>::parseMember(Object *o, InternalClass *shape, bool *followsShape)
 {
     BEGIN << "parseMember";
     Scope scope(engine);
 
-    QString key;
-    if (!parseString(&key))
-        return false;
-    QChar token = nextToken();
+    ScopedString s(scope);
+    Identifier *expected = 0;
+    if (*followsShape && o->internalClass()->size < shape->size) {
+        expected = shape->nameMap.at(o->internalClass()->size);
+        if (expected && matchString(expected->string))
+            s = engine->identifierTable->stringFromIdentifier(expected);
+    }
+    if (!s) {
+        QString key;
+        if (!parseString(&key))
+            return false;
+        s = engine->newIdentifier(key);
+    }
+    ushort token = nextToken();
     if (token != NameSeparator) {
         lastError = QJsonParseError::MissingNameSeparator;
         return false;
@@ -252,11 +322,11 @@ bool JsonParser::parseMember(Object *o)
     if (!parseValue(val))
         return false;
 
-    ScopedString s(scope, engine->newIdentifier(key));
     uint idx = s->asArrayIndex();
     if (idx < UINT_MAX) {
         o->putIndexed(idx, val);
     } else {
+        *followsShape = *followsShape && expected && s->d()->identifier == expected;
         o->insertMember(s, val);
     }
 
@@ -267,7 +337,8 @@ bool JsonParser::parseMember(Object *o)
 /*
     array = begin-array [ value *( value-separator value ) ] end-array
 */
-ReturnedValue JsonParser::parseArray()
+template <typename CharType>
+ReturnedValue JsonParser<CharType>::parseArray()
 {
     Scope scope(engine);
     BEGIN << "parseArray";
@@ -282,7 +353,7 @@ ReturnedValue JsonParser::parseArray()
         lastError = QJsonParseError::UnterminatedArray;
         return Encode::undefined();
     }
-    if (*json == EndArray) {
+    if (unit(*json) == EndArray) {
         nextToken();
     } else {
         uint index = 0;
@@ -291,7 +362,7 @@ ReturnedValue JsonParser::parseArray()
             if (!parseValue(val))
                 return Encode::undefined();
             array->arraySet(index, val);
-            QChar token = nextToken();
+            ushort token = nextToken();
             if (token == EndArray)
                 break;
             else if (token != ValueSeparator) {
@@ -317,19 +388,20 @@ value = false / null / true / object / array / number / string
 
 */
 
-bool JsonParser::parseValue(Value *val)
+template <typename CharType>
+bool JsonParser<CharType>::parseValue(Value *val)
 {
-    BEGIN << "parse Value" << *json;
+    BEGIN << "parse Value" << unit(*json);
 
-    switch ((json++)->unicode()) {
+    switch (unit(*json++)) {
     case 'n':
         if (end - json < 3) {
             lastError = QJsonParseError::IllegalValue;
             return false;
         }
-        if (*json++ == 'u' &&
-            *json++ == 'l' &&
-            *json++ == 'l') {
+        if (unit(*json++) == 'u' &&
+            unit(*json++) == 'l' &&
+            unit(*json++) == 'l') {
             *val = Primitive::nullValue();
             DEBUG << "value: null";
             END;
@@ -342,9 +414,9 @@ bool JsonParser::parseValue(Value *val)
             lastError = QJsonParseError::IllegalValue;
             return false;
         }
-        if (*json++ == 'r' &&
-            *json++ == 'u' &&
-            *json++ == 'e') {
+        if (unit(*json++) == 'r' &&
+            unit(*json++) == 'u' &&
+            unit(*json++) == 'e') {
             *val = Primitive::fromBoolean(true);
             DEBUG << "value: true";
             END;
@@ -357,10 +429,10 @@ bool JsonParser::parseValue(Value *val)
             lastError = QJsonParseError::IllegalValue;
             return false;
         }
-        if (*json++ == 'a' &&
-            *json++ == 'l' &&
-            *json++ == 's' &&
-            *json++ == 'e') {
+        if (unit(*json++) == 'a' &&
+            unit(*json++) == 'l' &&
+            unit(*json++) == 's' &&
+            unit(*json++) == 'e') {
             *val = Primitive::fromBoolean(false);
             DEBUG << "value: false";
             END;
@@ -425,44 +497,45 @@ bool JsonParser::parseValue(Value *val)
 
 */
 
-bool JsonParser::parseNumber(Value *val)
+template <typename CharType>
+bool JsonParser<CharType>::parseNumber(Value *val)
 {
-    BEGIN << "parseNumber" << *json;
+    BEGIN << "parseNumber" << unit(*json);
 
-    const QChar *start = json;
+    const CharType *start = json;
     bool isInt = true;
 
     // minus
-    if (json < end && *json == '-')
+    if (json < end && unit(*json) == '-')
         ++json;
 
     // int = zero / ( digit1-9 *DIGIT )
-    if (json < end && *json == '0') {
+    if (json < end && unit(*json) == '0') {
         ++json;
     } else {
-        while (json < end && *json >= '0' && *json <= '9')
+        while (json < end && unit(*json) >= '0' && unit(*json) <= '9')
             ++json;
     }
 
     // frac = decimal-point 1*DIGIT
-    if (json < end && *json == '.') {
+    if (json < end && unit(*json) == '.') {
         isInt = false;
         ++json;
-        while (json < end && *json >= '0' && *json <= '9')
+        while (json < end && unit(*json) >= '0' && unit(*json) <= '9')
             ++json;
     }
 
     // exp = e [ minus / plus ] 1*DIGIT
-    if (json < end && (*json == 'e' || *json == 'E')) {
+    if (json < end && (unit(*json) == 'e' || unit(*json) == 'E')) {
         isInt = false;
         ++json;
-        if (json < end && (*json == '-' || *json == '+'))
+        if (json < end && (unit(*json) == '-' || unit(*json) == '+'))
             ++json;
-        while (json < end && *json >= '0' && *json <= '9')
+        while (json < end && unit(*json) >= '0' && unit(*json) <= '9')
             ++json;
     }
 
-    QString number(start, json - start);
+    QString number = numberString(start, json - start);
     DEBUG << "numberstring" << number;
 
     if (isInt) {
@@ -512,9 +585,8 @@ bool JsonParser::parseNumber(Value *val)
 
         unescaped = %x20-21 / %x23-5B / %x5D-10FFFF
  */
-static inline bool addHexDigit(QChar digit, uint *result)
+static inline bool addHexDigit(ushort d, uint *result)
 {
-    ushort d = digit.unicode();
     *result <<= 4;
     if (d >= '0' && d <= '9')
         *result |= (d - '0');
@@ -527,14 +599,15 @@ static inline bool addHexDigit(QChar digit, uint *result)
     return true;
 }
 
-static inline bool scanEscapeSequence(const QChar *&json, const QChar *end, uint *ch)
+template <typename CharType>
+static inline bool scanEscapeSequence(const CharType *&json, const CharType *end, uint *ch)
 {
     ++json;
     if (json >= end)
         return false;
 
     DEBUG << "scan escape";
-    uint escaped = (json++)->unicode();
+    uint escaped = unit(*json++);
     switch (escaped) {
     case '"':
         *ch = '"'; break;
@@ -557,7 +630,7 @@ static inline bool scanEscapeSequence(const QChar *&json, const QChar *end, uint
         if (json > end - 4)
             return false;
         for (int i = 0; i < 4; ++i) {
-            if (!addHexDigit(*json, ch))
+            if (!addHexDigit(unit(*json), ch))
                 return false;
             ++json;
         }
@@ -570,14 +643,15 @@ static inline bool scanEscapeSequence(const QChar *&json, const QChar *end, uint
 }
 
 
-bool JsonParser::parseString(QString *string)
+template <typename CharType>
+bool JsonParser<CharType>::parseString(QString *string)
 {
     BEGIN << "parse string stringPos=" << json;
 
     while (json < end) {
-        if (*json == '"')
+        if (unit(*json) == '"')
             break;
-        else if (*json == '\\') {
+        else if (unit(*json) == '\\') {
             uint ch = 0;
             if (!scanEscapeSequence(json, end, &ch)) {
                 lastError = QJsonParseError::IllegalEscapeSequence;
@@ -590,12 +664,14 @@ bool JsonParser::parseString(QString *string)
                 *string += QChar(ch);
             }
         } else {
-            if (json->unicode() <= 0x1f) {
+            const CharType *run = json;
+            while (json < end && unit(*json) > 0x1f && unit(*json) != '"' && unit(*json) != '\\')
+                ++json;
+            if (json == run) {
                 lastError = QJsonParseError::IllegalEscapeSequence;
                 return false;
             }
-            *string += *json;
-            ++json;
+            appendRun(string, run, json - run);
         }
     }
     ++json;
@@ -609,6 +685,31 @@ bool JsonParser::parseString(QString *string)
     return true;
 }
 
+/*
+    Consumes the rest of a string if it is expected, written without escape sequences.
+    Leaves the input untouched otherwise. In UTF-8 input, only ASCII names can be matched.
+*/
+template <typename CharType>
+bool JsonParser<CharType>::matchString(const QString &expected)
+{
+    const CharType *c = json;
+    for (const QChar *e = expected.constData(), *eEnd = e + expected.length(); e != eEnd; ++e, ++c) {
+        if (c >= end || unit(*c) != e->unicode() || !isWholeCharacter(*c) || unit(*c) == '\\' || unit(*c) <= 0x1f)
+            return false;
+    }
+    if (c >= end || unit(*c) != '"')
+        return false;
+    json = c + 1;
+    return true;
+}
+
+QT_BEGIN_NAMESPACE
+namespace QV4 {
+template class JsonParser<QChar>;
+template class JsonParser<uchar>;
+}
+QT_END_NAMESPACE
+
 
 struct Stringify
 {
@@ -619,6 +720,9 @@ struct Stringify
     QString gap;
     QString indent;
     QStack<Object *> stack;
+    // everything is written to this one buffer instead of concatenating the results
+    // of the nested values
+    QString result;
 
     bool stackContains(Object *o) {
         for (int i = 0; i < stack.size(); ++i)
@@ -629,55 +733,60 @@ struct Stringify
 
     Stringify(ExecutionEngine *e) : v4(e), replacerFunction(0), propertyList(0), propertyListSize(0) {}
 
-    QString Str(const QString &key, const Value &v);
-    QString JA(ArrayObject *a);
-    QString JO(Object *o);
+    bool Str(const QString &key, const Value &v);
+    void JA(ArrayObject *a);
+    void JO(Object *o);
 
-    QString makeMember(const QString &key, const Value &v);
+    void appendMember(const QString &key, const Value &v, int start);
+    void appendNewLine(const QString &indentation);
 };
 
-static QString quote(const QString &str)
+static void appendQuoted(QString *product, const QString &str)
 {
-    QString product = QStringLiteral("\"");
-    for (int i = 0; i < str.length(); ++i) {
-        QChar c = str.at(i);
-        switch (c.unicode()) {
+    *product += QLatin1Char('"');
+    const QChar *begin = str.constData();
+    const QChar *run = begin;
+    const QChar *end = begin + str.length();
+    for (const QChar *c = begin; c != end; ++c) {
+        ushort u = c->unicode();
+        if (u > 0x1f && u != '"' && u != '\\')
+            continue;
+        product->append(run, c - run);
+        run = c + 1;
+        switch (u) {
         case '"':
-            product += QStringLiteral("\\\"");
+            *product += QStringLiteral("\\\"");
             break;
         case '\\':
-            product += QStringLiteral("\\\\");
+            *product += QStringLiteral("\\\\");
             break;
         case '\b':
-            product += QStringLiteral("\\b");
+            *product += QStringLiteral("\\b");
             break;
         case '\f':
-            product += QStringLiteral("\\f");
+            *product += QStringLiteral("\\f");
             break;
         case '\n':
-            product += QStringLiteral("\\n");
+            *product += QStringLiteral("\\n");
             break;
         case '\r':
-            product += QStringLiteral("\\r");
+            *product += QStringLiteral("\\r");
             break;
         case '\t':
-            product += QStringLiteral("\\t");
+            *product += QStringLiteral("\\t");
             break;
         default:
-            if (c.unicode() <= 0x1f) {
-                product += QStringLiteral("\\u00");
-                product += c.unicode() > 0xf ? QLatin1Char('1') : QLatin1Char('0');
-                product += QLatin1Char("0123456789abcdef"[c.unicode() & 0xf]);
-            } else {
-                product += c;
-            }
+            *product += QStringLiteral("\\u00");
+            *product += u > 0xf ? QLatin1Char('1') : QLatin1Char('0');
+            *product += QLatin1Char("0123456789abcdef"[u & 0xf]);
         }
     }
-    product += QLatin1Char('"');
-    return product;
+    product->append(run, end - run);
+    *product += QLatin1Char('"');
 }
 
-QString Stringify::Str(const QString &key, const Value &v)
+// Appends v to the result, returns false without appending anything if v has no JSON representation
+bool Stringify::Str(const QString &key, const Value &v)
 {
     Scope scope(v4);
 
@@ -714,60 +823,81 @@ QString Stringify::Str(const QString &key, const Value &v)
             value = Encode(b->value());
     }
 
-    if (value->isNull())
-        return QStringLiteral("null");
-    if (value->isBoolean())
-        return value->booleanValue() ? QStringLiteral("true") : QStringLiteral("false");
-    if (value->isString())
-        return quote(value->stringValue()->toQString());
+    if (value->isNull()) {
+        result += QStringLiteral("null");
+        return true;
+    }
+    if (value->isBoolean()) {
+        result += value->booleanValue() ? QStringLiteral("true") : QStringLiteral("false");
+        return true;
+    }
+    if (value->isString()) {
+        appendQuoted(&result, value->stringValue()->toQString());
+        return true;
+    }
 
     if (value->isNumber()) {
-        double d = value->toNumber();
-        return std::isfinite(d) ? value->toQString() : QStringLiteral("null");
+        if (value->isInteger())
+            result += QString::number(value->integerValue());
+        else if (std::isfinite(value->doubleValue()))
+            result += value->toQString();
+        else
+            result += QStringLiteral("null");
+        return true;
     }
 
     o = value->asReturnedValue();
     if (o) {
         if (!o->as<FunctionObject>()) {
             if (o->as<ArrayObject>()) {
-                return JA(static_cast<ArrayObject *>(o.getPointer()));
+                JA(static_cast<ArrayObject *>(o.getPointer()));
             } else {
-                return JO(o);
+                JO(o);
             }
+            return true;
         }
     }
 
-    return QString();
+    return false;
 }
 
-QString Stringify::makeMember(const QString &key, const Value &v)
+void Stringify::appendNewLine(const QString &indentation)
 {
-    QString strP = Str(key, v);
-    if (!strP.isEmpty()) {
-        QString member = quote(key) + QLatin1Char(':');
-        if (!gap.isEmpty())
-            member += QLatin1Char(' ');
-        member += strP;
-        return member;
-    }
-    return QString();
+    result += QLatin1Char('\n');
+    result += indentation;
 }
 
-QString Stringify::JO(Object *o)
+// start is the position right after the opening brace of the object
+void Stringify::appendMember(const QString &key, const Value &v, int start)
+{
+    int memberStart = result.length();
+    if (memberStart > start)
+        result += QLatin1Char(',');
+    if (!gap.isEmpty())
+        appendNewLine(indent);
+    appendQuoted(&result, key);
+    result += QLatin1Char(':');
+    if (!gap.isEmpty())
+        result += QLatin1Char(' ');
+    if (!Str(key, v))
+        result.truncate(memberStart);
+}
+
+void Stringify::JO(Object *o)
 {
     if (stackContains(o)) {
         v4->throwTypeError();
-        return QString();
+        return;
     }
 
     Scope scope(v4);
 
-    QString result;
     stack.push(o);
     QString stepback = indent;
     indent += gap;
 
-    QStringList partial;
+    result += QLatin1Char('{');
+    const int start = result.length();
     if (!propertyListSize) {
         ObjectIterator it(scope, o, ObjectIterator::EnumerableOnly);
         ScopedValue name(scope);
@@ -777,10 +907,7 @@ QString Stringify::JO(Object *o)
             name = it.nextPropertyNameAsString(val);
             if (name->isNull())
                 break;
-            QString key = name->toQString();
-            QString member = makeMember(key, val);
-            if (!member.isEmpty())
-                partial += member;
+            appendMember(name->toQString(), val, start);
         }
     } else {
         ScopedValue v(scope);
@@ -792,70 +919,51 @@ QString Stringify::JO(Object *o)
             v = o->get(s, &exists);
             if (!exists)
                 continue;
-            QString member = makeMember(s->toQString(), v);
-            if (!member.isEmpty())
-                partial += member;
+            appendMember(s->toQString(), v, start);
         }
     }
 
-    if (partial.isEmpty()) {
-        result = QStringLiteral("{}");
-    } else if (gap.isEmpty()) {
-        result = QStringLiteral("{") + partial.join(QLatin1Char(',')) + QLatin1Char('}');
-    } else {
-        QString separator = QStringLiteral(",\n") + indent;
-        result = QStringLiteral("{\n") + indent + partial.join(separator) + QLatin1Char('\n')
-                 + stepback + QLatin1Char('}');
-    }
+    if (result.length() > start && !gap.isEmpty())
+        appendNewLine(stepback);
+    result += QLatin1Char('}');
 
     indent = stepback;
     stack.pop();
-    return result;
 }
 
-QString Stringify::JA(ArrayObject *a)
+void Stringify::JA(ArrayObject *a)
 {
     if (stackContains(a)) {
         v4->throwTypeError();
-        return QString();
+        return;
     }
 
     Scope scope(a->engine());
 
-    QString result;
     stack.push(a);
     QString stepback = indent;
     indent += gap;
 
-    QStringList partial;
+    result += QLatin1Char('[');
     uint len = a->getLength();
     ScopedValue v(scope);
     for (uint i = 0; i < len; ++i) {
+        if (i)
+            result += QLatin1Char(',');
+        if (!gap.isEmpty())
+            appendNewLine(indent);
         bool exists;
         v = a->getIndexed(i, &exists);
-        if (!exists) {
-            partial += QStringLiteral("null");
-            continue;
-        }
-        QString strP = Str(QString::number(i), v);
-        if (!strP.isEmpty())
-            partial += strP;
-        else
-            partial += QStringLiteral("null");
+        if (!exists || !Str(QString::number(i), v))
+            result += QStringLiteral("null");
     }
 
-    if (partial.isEmpty()) {
-        result = QStringLiteral("[]");
-    } else if (gap.isEmpty()) {
-        result = QStringLiteral("[") + partial.join(QLatin1Char(',')) + QStringLiteral("]");
-    } else {
-        QString separator = QStringLiteral(",\n") + indent;
-        result = QStringLiteral("[\n") + indent + partial.join(separator) + QStringLiteral("\n") + stepback + QStringLiteral("]");
-    }
+    if (len && !gap.isEmpty())
+        appendNewLine(stepback);
+    result += QLatin1Char(']');
 
     indent = stepback;
     stack.pop();
-    return result;
 }
 
 
@@ -876,7 +984,7 @@ ReturnedValue JsonObject::method_parse(CallContext *ctx)
     QString jtext = v->toQString();
 
     DEBUG << "parsing source = " << jtext;
-    JsonParser parser(scope.engine, jtext.constData(), jtext.length());
+    JsonParser<QChar> parser(scope.engine, jtext.constData(), jtext.length());
     QJsonParseError error;
     ScopedValue result(scope, parser.parse(&error));
     if (error.error != QJsonParseError::NoError) {
@@ -932,10 +1040,9 @@ ReturnedValue JsonObject::method_stringify(CallContext *ctx)
 
 
     ScopedValue arg0(scope, ctx->argument(0));
-    QString result = stringify.Str(QString(), arg0);
-    if (result.isEmpty() || scope.engine->hasException)
+    if (!stringify.Str(QString(), arg0) || scope.engine->hasException)
         return Encode::undefined();
-    return ctx->d()->engine->newString(result)->asReturnedValue();
+    return ctx->d()->engine->newString(stringify.result)->asReturnedValue();
 }
 
 
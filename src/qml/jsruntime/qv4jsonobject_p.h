@@ -50,6 +50,7 @@
 #include <qjsonvalue.h>
 #include <qjsondocument.h>
 #include <qhash.h>
+#include <qvarlengtharray.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -103,31 +104,38 @@ private:
 
 };
 
+// Parses UTF-16 from a QString (CharType QChar) or UTF-8 straight from a
+// QByteArray (CharType uchar), without converting the input first.
+template <typename CharType>
 class JsonParser
 {
 public:
-    JsonParser(ExecutionEngine *engine, const QChar *json, int length);
+    JsonParser(ExecutionEngine *engine, const CharType *json, int length);
 
     ReturnedValue parse(QJsonParseError *error);
 
 private:
     inline bool eatSpace();
-    inline QChar nextToken();
+    inline ushort nextToken();
 
     ReturnedValue parseObject();
     ReturnedValue parseArray();
-    bool parseMember(Object *o);
+    bool parseMember(Object *o, InternalClass *shape, bool *followsShape);
     bool parseString(QString *string);
+    bool matchString(const QString &expected);
     bool parseValue(Value *val);
     bool parseNumber(Value *val);
 
     ExecutionEngine *engine;
-    const QChar *head;
-    const QChar *json;
-    const QChar *end;
+    const CharType *head;
+    const CharType *json;
+    const CharType *end;
 
     int nestingLevel;
     QJsonParseError::ParseError lastError;
+    // class of the last object parsed at each nesting level, objects in JSON
+    // arrays tend to all have the same members in the same order
+    QVarLengthArray<InternalClass *, 8> objectShapes;
 };
 
 }
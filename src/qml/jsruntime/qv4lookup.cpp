@@ -46,7 +46,8 @@ ReturnedValue Lookup::lookup(const Value &thisObject, Object *o, PropertyAttribu
     Identifier *name = engine->current->compilationUnit->runtimeStrings[nameIndex]->identifier;
     int i = 0;
     Heap::Object *obj = o->d();
-    while (i < Size && obj) {
+    // dictionary classes change in place, lookups through them can't be cached
+    while (i < Size && obj && !obj->internalClass->isDictionary) {
         classList[i] = obj->internalClass;
 
         index = obj->internalClass->find(name);
@@ -81,7 +82,7 @@ ReturnedValue Lookup::lookup(const Object *thisObject, PropertyAttributes *attrs
     ExecutionEngine *engine = thisObject->engine();
     Identifier *name = engine->current->compilationUnit->runtimeStrings[nameIndex]->identifier;
     int i = 0;
-    while (i < Size && obj) {
+    while (i < Size && obj && !obj->internalClass->isDictionary) {
         classList[i] = obj->internalClass;
 
         index = obj->internalClass->find(name);
@@ -329,6 +330,13 @@ ReturnedValue Lookup::getterTwoClasses(Lookup *l, ExecutionEngine *engine, const
 
 ReturnedValue Lookup::getterFallback(Lookup *l, ExecutionEngine *engine, const Value &object)
 {
+    if (const Object *o = object.as<Object>()) {
+        Identifier *name = engine->current->compilationUnit->runtimeStrings[l->nameIndex]->identifier;
+        ReturnedValue v = engine->lookupStubCache->get(o, name);
+        if (v != Primitive::emptyValue().asReturnedValue())
+            return v;
+    }
+
     QV4::Scope scope(engine);
     QV4::ScopedObject o(scope, object.toObject(scope.engine));
     if (!o)
@@ -742,6 +750,12 @@ void Lookup::setterTwoClasses(Lookup *l, ExecutionEngine *engine, Value &object,
 
 void Lookup::setterFallback(Lookup *l, ExecutionEngine *engine, Value &object, const Value &value)
 {
+    if (Object *o = object.as<Object>()) {
+        Identifier *name = engine->current->compilationUnit->runtimeStrings[l->nameIndex]->identifier;
+        if (engine->lookupStubCache->put(o, name, value))
+            return;
+    }
+
     QV4::Scope scope(engine);
     QV4::ScopedObject o(scope, object.toObject(scope.engine));
     if (o) {
@@ -830,4 +844,79 @@ void Lookup::setter0setter0(Lookup *l, ExecutionEngine *engine, Value &object, c
 
 }
 
+LookupStubCache::LookupStubCache()
+{
+    memset(entries, 0, sizeof(entries));
+}
+
+bool LookupStubCache::fill(Entry *e, const Object *o, Identifier *name)
+{
+    Heap::Object *obj = o->d();
+    if (obj->internalClass->isDictionary)
+        return false;
+    InternalClass *protoClass = 0;
+    uint index = obj->internalClass->find(name);
+    if (index == UINT_MAX) {
+        Heap::Object *p = obj->prototype;
+        if (!p || p->internalClass->isDictionary)
+            return false;
+        index = p->internalClass->find(name);
+        if (index == UINT_MAX || !p->internalClass->propertyData.at(index).isData())
+            return false;
+        protoClass = p->internalClass;
+    } else if (!obj->internalClass->propertyData.at(index).isData()) {
+        return false;
+    }
+
+    e->internalClass = obj->internalClass;
+    e->name = name;
+    e->protoClass = protoClass;
+    e->index = index;
+    return true;
+}
+
+ReturnedValue LookupStubCache::get(const Object *o, Identifier *name)
+{
+    // Internal classes are shared between object types, and objects with their
+    // own get() may resolve names differently than their internal class does
+    if (o->vtable()->get != Object::get)
+        return Primitive::emptyValue().asReturnedValue();
+
+    Heap::Object *obj = o->d();
+    Entry *e = entry(obj->internalClass, name);
+    if (e->internalClass != obj->internalClass || e->name != name
+            || (e->protoClass && (!obj->prototype || obj->prototype->internalClass != e->protoClass))) {
+        if (!fill(e, o, name))
+            return Primitive::emptyValue().asReturnedValue();
+    }
+    Q_ASSERT(!e->internalClass->isDictionary && (!e->protoClass || !e->protoClass->isDictionary));
+
+    if (e->protoClass)
+        obj = obj->prototype;
+    return obj->propertyData(e->index)->asReturnedValue();
+}
+
+bool LookupStubCache::put(Object *o, Identifier *name, const Value &value)
+{
+    if (o->vtable()->put != Object::put)
+        return false;
+
+    Heap::Object *obj = o->d();
+    Entry *e = entry(obj->internalClass, name);
+    if (e->internalClass != obj->internalClass || e->name != name) {
+        if (!fill(e, o, name))
+            return false;
+    }
+    Q_ASSERT(!e->internalClass->isDictionary && (!e->protoClass || !e->protoClass->isDictionary));
+
+    // only existing own properties can be written in place, everything else needs to go through put()
+    if (e->protoClass || !obj->internalClass->propertyData.at(e->index).isWritable())
+        return false;
+    if (o->isArrayObject() && e->index == Heap::ArrayObject::LengthPropertyIndex)
+        return false;
+
+    *obj->propertyData(e->index) = value;
+    return true;
+}
+
 QT_END_NAMESPACE
@@ -132,6 +132,35 @@ struct Lookup {
 
 };
 
+// Engine wide cache used by lookups that have seen more internal classes than
+// fit into the Lookup itself. Entries map an (internal class, name) pair to a
+// data property either on the object itself or on its direct prototype.
+// Only shared internal classes get entries. They live as long as the engine,
+// unlike dictionary classes, which are recycled when their owner dies. That's
+// why fill() rejects dictionary classes, so entries never dangle.
+struct LookupStubCache {
+    enum { Size = 1024 };
+
+    struct Entry {
+        InternalClass *internalClass;
+        Identifier *name;
+        InternalClass *protoClass;
+        uint index;
+    };
+
+    LookupStubCache();
+
+    ReturnedValue get(const Object *o, Identifier *name);
+    bool put(Object *o, Identifier *name, const Value &value);
+
+private:
+    Entry *entry(InternalClass *ic, Identifier *name)
+    { return entries + (((quintptr(ic) >> 3) ^ (quintptr(name) >> 4)) & (Size - 1)); }
+    bool fill(Entry *e, const Object *o, Identifier *name);
+
+    Entry entries[Size];
+};
+
 }
 
 QT_END_NAMESPACE
@@ -153,8 +153,7 @@ void Object::defineDefaultProperty(const QString &name, ReturnedValue (*code)(Ca
     Scope scope(e);
     ScopedString s(scope, e->newIdentifier(name));
     ExecutionContext *global = e->rootContext();
-    ScopedFunctionObject function(scope, BuiltinFunction::create(global, s, code));
-    function->defineReadonlyProperty(e->id_length(), Primitive::fromInt32(argumentCount));
+    ScopedFunctionObject function(scope, BuiltinFunction::create(global, s, code, argumentCount));
     defineDefaultProperty(s, function);
 }
 
@@ -163,8 +162,7 @@ void Object::defineDefaultProperty(String *name, ReturnedValue (*code)(CallConte
     ExecutionEngine *e = engine();
     Scope scope(e);
     ExecutionContext *global = e->rootContext();
-    ScopedFunctionObject function(scope, BuiltinFunction::create(global, name, code));
-    function->defineReadonlyProperty(e->id_length(), Primitive::fromInt32(argumentCount));
+    ScopedFunctionObject function(scope, BuiltinFunction::create(global, name, code, argumentCount));
     defineDefaultProperty(name, function);
 }
 
@@ -488,6 +486,12 @@ void Object::setLookup(Managed *m, Lookup *l, const Value &value)
     ScopedString name(scope, scope.engine->current->compilationUnit->runtimeStrings[l->nameIndex]);
 
     InternalClass *c = o->internalClass();
+    if (c->isDictionary) {
+        o->put(name, value);
+        l->setter = Lookup::setterFallback;
+        return;
+    }
+
     uint idx = c->find(name);
     if (!o->isArrayObject() || idx != Heap::ArrayObject::LengthPropertyIndex) {
         if (idx != UINT_MAX && o->internalClass()->propertyData[idx].isData() && o->internalClass()->propertyData[idx].isWritable()) {
@@ -506,7 +510,7 @@ void Object::setLookup(Managed *m, Lookup *l, const Value &value)
 
     o->put(name, value);
 
-    if (o->internalClass() == c)
+    if (o->internalClass() == c || o->internalClass()->isDictionary)
         return;
     idx = o->internalClass()->find(name);
     if (idx == UINT_MAX)
@@ -520,12 +524,16 @@ void Object::setLookup(Managed *m, Lookup *l, const Value &value)
     }
     o = o->prototype();
     l->classList[1] = o->internalClass();
+    if (l->classList[1]->isDictionary)
+        return;
     if (!o->prototype()) {
         l->setter = Lookup::setterInsert1;
         return;
     }
     o = o->prototype();
     l->classList[2] = o->internalClass();
+    if (l->classList[2]->isDictionary)
+        return;
     if (!o->prototype()) {
         l->setter = Lookup::setterInsert2;
         return;
@@ -579,6 +587,24 @@ void Object::advanceIterator(Managed *m, ObjectIterator *it, Value *name, uint *
         }
     }
 
+    InternalClass *ic = o->internalClass();
+    if (it->flags & ObjectIterator::EnumerableOnly) {
+        // memberIndex counts the enumerable members here, the class keeps a list of them
+        const uint *members = ic->enumerableMembers();
+        if (it->memberIndex < members[0]) {
+            uint idx = members[++it->memberIndex];
+            PropertyAttributes a = ic->propertyData.at(idx);
+            name->setM(o->engine()->identifierTable->stringFromIdentifier(ic->nameMap.at(idx)));
+            *attrs = a;
+            pd->value = *o->propertyData(idx);
+            if (a.isAccessor())
+                pd->set = *o->propertyData(idx + SetterOffset);
+            return;
+        }
+        *attrs = PropertyAttributes();
+        return;
+    }
+
     while (it->memberIndex < o->internalClass()->size) {
         Identifier *n = o->internalClass()->nameMap.at(it->memberIndex);
         if (!n) {
@@ -1056,7 +1082,8 @@ bool Object::__defineOwnProperty__(ExecutionEngine *engine, uint index, String *
 
     current->merge(cattrs, p, attrs);
     if (member) {
-        InternalClass::changeMember(this, member, cattrs);
+        // a dictionary may have moved the member
+        InternalClass::changeMember(this, member, cattrs, &index);
         setProperty(index, current);
     } else {
         setArrayAttributes(index, cattrs);
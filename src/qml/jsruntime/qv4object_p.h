@@ -61,6 +61,9 @@ namespace Heap {
 struct Object : Base {
     inline Object() {}
 
+    // upper bound for inline slots reserved up front from an allocation site hint
+    enum { MaxExpectedInlineSize = 16 };
+
     const Value *propertyData(uint index) const { if (index < inlineMemberSize) return reinterpret_cast<const Value *>(this) + inlineMemberOffset + index; return memberData->data + index - inlineMemberSize; }
     Value *propertyData(uint index) { if (index < inlineMemberSize) return reinterpret_cast<Value *>(this) + inlineMemberOffset + index; return memberData->data + index - inlineMemberSize; }
 
@@ -351,6 +354,7 @@ private:
 
     friend struct ObjectIterator;
     friend struct ObjectPrototype;
+    friend struct LookupStubCache;
 };
 
 namespace Heap {
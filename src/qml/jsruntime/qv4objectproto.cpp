@@ -303,7 +303,7 @@ ReturnedValue ObjectPrototype::method_isSealed(CallContext *ctx)
     if (o->isExtensible())
         return Encode(false);
 
-    if (o->internalClass() != o->internalClass()->sealed())
+    if (!o->internalClass()->isSealed())
         return Encode(false);
 
     if (!o->arrayData() || !o->arrayData()->length())
@@ -332,7 +332,7 @@ ReturnedValue ObjectPrototype::method_isFrozen(CallContext *ctx)
     if (o->isExtensible())
         return Encode(false);
 
-    if (o->internalClass() != o->internalClass()->frozen())
+    if (!o->internalClass()->isFrozen())
         return Encode(false);
 
     if (!o->arrayData() || !o->arrayData()->length())
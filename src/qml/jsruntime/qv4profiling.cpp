@@ -58,8 +58,10 @@ Profiler::Profiler(QV4::ExecutionEngine *engine) : featuresEnabled(0), m_engine(
 {
     static int meta = qRegisterMetaType<QVector<QV4::Profiling::FunctionCallProperties> >();
     static int meta2 = qRegisterMetaType<QVector<QV4::Profiling::MemoryAllocationProperties> >();
+    static int meta3 = qRegisterMetaType<QVector<QV4::Profiling::GarbageCollectionProperties> >();
     Q_UNUSED(meta);
     Q_UNUSED(meta2);
+    Q_UNUSED(meta3);
     m_timer.start();
 }
 
@@ -85,9 +87,10 @@ void Profiler::reportData()
     foreach (const FunctionCall &call, m_data)
         resolved.append(call.resolve());
 
-    emit dataReady(resolved, m_memory_data);
+    emit dataReady(resolved, m_memory_data, m_gc_data);
     m_data.clear();
     m_memory_data.clear();
+    m_gc_data.clear();
 }
 
 void Profiler::startProfiling(quint64 features)
@@ -83,6 +83,17 @@ struct MemoryAllocationProperties {
     MemoryType type;
 };
 
+// Sent once all garbage of the collection is swept, which may be some time after the pause.
+struct GarbageCollectionProperties {
+    qint64 timestamp;
+    qint64 markTime;
+    qint64 sweepTime;  // including the chunks swept lazily after the pause
+    qint64 bytesFreed;
+    qint64 unmanagedHeapSize;
+    QVector<quint32> itemsInUse;     // indexed by item size / 16
+    QVector<quint32> availableItems; // indexed by item size / 16
+};
+
 class FunctionCall {
 public:
 
@@ -158,6 +169,13 @@ public:
         return pointer;
     }
 
+    // The event is stamped with the start of the collection, which was sinceStart ns ago.
+    void trackGarbageCollection(GarbageCollectionProperties properties, qint64 sinceStart)
+    {
+        properties.timestamp = m_timer.nsecsElapsed() - sinceStart;
+        m_gc_data.append(properties);
+    }
+
     quint64 featuresEnabled;
 
 public slots:
@@ -168,13 +186,15 @@ public slots:
 
 signals:
     void dataReady(const QVector<QV4::Profiling::FunctionCallProperties> &,
-                   const QVector<QV4::Profiling::MemoryAllocationProperties> &);
+                   const QVector<QV4::Profiling::MemoryAllocationProperties> &,
+                   const QVector<QV4::Profiling::GarbageCollectionProperties> &);
 
 private:
     QV4::ExecutionEngine *m_engine;
     QElapsedTimer m_timer;
     QVector<FunctionCall> m_data;
     QVector<MemoryAllocationProperties> m_memory_data;
+    QVector<GarbageCollectionProperties> m_gc_data;
 
     friend class FunctionCallProfiler;
 };
@@ -211,10 +231,12 @@ public:
 
 Q_DECLARE_TYPEINFO(QV4::Profiling::MemoryAllocationProperties, Q_MOVABLE_TYPE);
 Q_DECLARE_TYPEINFO(QV4::Profiling::FunctionCallProperties, Q_MOVABLE_TYPE);
+Q_DECLARE_TYPEINFO(QV4::Profiling::GarbageCollectionProperties, Q_MOVABLE_TYPE);
 Q_DECLARE_TYPEINFO(QV4::Profiling::FunctionCall, Q_MOVABLE_TYPE);
 
 QT_END_NAMESPACE
 Q_DECLARE_METATYPE(QVector<QV4::Profiling::FunctionCallProperties>)
 Q_DECLARE_METATYPE(QVector<QV4::Profiling::MemoryAllocationProperties>)
+Q_DECLARE_METATYPE(QVector<QV4::Profiling::GarbageCollectionProperties>)
 
 #endif // QV4PROFILING_H
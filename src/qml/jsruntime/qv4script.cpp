@@ -165,7 +165,7 @@ void Script::parse()
 
     MemoryManager::GCBlocker gcBlocker(v4->memoryManager);
 
-    IR::Module module(v4->debugger != 0);
+    QScopedPointer<IR::Module> module(new IR::Module(v4->debugger != 0));
 
     QQmlJS::Engine ee, *engine = &ee;
     Lexer lexer(engine);
@@ -203,15 +203,21 @@ void Script::parse()
         }
 
         RuntimeCodegen cg(v4, strictMode);
-        cg.generateFromProgram(sourceFile, sourceCode, program, &module, QQmlJS::Codegen::EvalCode, inheritedLocals);
+        cg.generateFromProgram(sourceFile, sourceCode, program, module.data(), QQmlJS::Codegen::EvalCode, inheritedLocals);
         if (v4->hasException)
             return;
 
-        QV4::Compiler::JSUnitGenerator jsGenerator(&module);
-        QScopedPointer<EvalInstructionSelection> isel(v4->iselFactory->create(QQmlEnginePrivate::get(v4), v4->executableAllocator, &module, &jsGenerator));
+        // The instruction selection owns the module and the unit generator, as the compilation unit
+        // keeps it for the functions that are compiled when first called or that tier up.
+        QScopedPointer<EvalInstructionSelection> isel(v4->createTieredInstructionSelection(QQmlEnginePrivate::get(v4), module.data(), 0));
+        isel->adoptIRModule();
+        module.take();
         if (inheritContext)
             isel->setUseFastLookups(false);
+        isel->setUseLazyCompilation(!v4->debugger);
         QQmlRefPointer<QV4::CompiledData::CompilationUnit> compilationUnit = isel->compile();
+        if (isel->hasDeferredCompilation())
+            compilationUnit->lazyCompiler.reset(isel.take());
         vmFunction = compilationUnit->linkToEngine(v4);
         ScopedObject holder(valueScope, v4->memoryManager->allocObject<CompilationUnitHolder>(compilationUnit));
         compilationUnitHolder.set(v4, holder);
@@ -40,6 +40,9 @@
 #include "qv4stringobject_p.h"
 #endif
 #include <QtCore/QHash>
+#ifndef V4_BOOTSTRAP
+#include <private/qsimd_p.h>
+#endif
 
 using namespace QV4;
 
@@ -93,6 +96,101 @@ static uint toArrayIndex(const char *ch, const char *end)
     return i;
 }
 
+// String hashes are the polynomial h = 31 * h + c over all characters, starting at 0xffffffff.
+// The SSE2 version splits it into eight lanes, where lane j accumulates every character at
+// position j modulo 8 with a factor of 31^8 per step, and weighs the lanes by 31^(7 - j) at
+// the end. That breaks up the dependency chain without changing the hash values, which need to
+// stay the same for the QChar and the Latin-1 variants.
+#ifdef __SSE2__
+static inline __m128i mul32(__m128i a, __m128i b)
+{
+#ifdef __SSE4_1__
+    return _mm_mullo_epi32(a, b);
+#else
+    const __m128i even = _mm_mul_epu32(a, b);
+    const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+}
+
+struct HashLanes
+{
+    __m128i lo;
+    __m128i hi;
+    __m128i factor;
+
+    HashLanes(uint h)
+        // h acts as a character preceding the string in the last lane
+        : lo(_mm_setzero_si128())
+        , hi(_mm_set_epi32(int(h), 0, 0, 0))
+        , factor(_mm_set1_epi32(int(2487512833u))) // 31^8
+    {}
+
+    // chars holds eight 16 bit characters
+    void add(__m128i chars)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        lo = _mm_add_epi32(mul32(lo, factor), _mm_unpacklo_epi16(chars, zero));
+        hi = _mm_add_epi32(mul32(hi, factor), _mm_unpackhi_epi16(chars, zero));
+    }
+
+    uint result() const
+    {
+        const __m128i loWeights = _mm_set_epi32(int(923521u), int(28629151u), int(887503681u), int(1742810335u));
+        const __m128i hiWeights = _mm_set_epi32(1, 31, 961, 29791);
+        __m128i sum = _mm_add_epi32(mul32(lo, loWeights), mul32(hi, hiWeights));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+        return uint(_mm_cvtsi128_si32(sum));
+    }
+};
+#endif
+
+static uint hashChars(const QChar *ch, const QChar *end)
+{
+    uint h = 0xffffffff;
+#ifdef __SSE2__
+    // not worth setting up the lanes for the typical short identifier
+    if (end - ch >= 16) {
+        HashLanes lanes(h);
+        for ( ; end - ch >= 8; ch += 8)
+            lanes.add(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ch)));
+        h = lanes.result();
+    }
+#endif
+    while (ch < end) {
+        h = 31 * h + ch->unicode();
+        ++ch;
+    }
+    return h;
+}
+
+// Returns UINT_MAX for strings that aren't pure ASCII
+static uint hashChars(const char *ch, const char *end)
+{
+    uint h = 0xffffffff;
+#ifdef __SSE2__
+    if (end - ch >= 16) {
+        HashLanes lanes(h);
+        for ( ; end - ch >= 8; ch += 8) {
+            const __m128i chars = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(ch));
+            if (_mm_movemask_epi8(chars))
+                return UINT_MAX;
+            lanes.add(_mm_unpacklo_epi8(chars, _mm_setzero_si128()));
+        }
+        h = lanes.result();
+    }
+#endif
+    while (ch < end) {
+        if ((uchar)(*ch) >= 0x80)
+            return UINT_MAX;
+        h = 31 * h + *ch;
+        ++ch;
+    }
+    return h;
+}
+
 
 DEFINE_MANAGED_VTABLE(String);
 
@@ -207,13 +305,7 @@ void Heap::String::createHashValue() const
         return;
     }
 
-    uint h = 0xffffffff;
-    while (ch < end) {
-        h = 31 * h + ch->unicode();
-        ++ch;
-    }
-
-    stringHash = h;
+    stringHash = hashChars(ch, end);
     subtype = Heap::String::StringType_Regular;
 }
 
@@ -249,13 +341,7 @@ uint String::createHashValue(const QChar *ch, int length)
     if (stringHash != UINT_MAX)
         return stringHash;
 
-    uint h = 0xffffffff;
-    while (ch < end) {
-        h = 31 * h + ch->unicode();
-        ++ch;
-    }
-
-    return h;
+    return hashChars(ch, end);
 }
 
 uint String::createHashValue(const char *ch, int length)
@@ -267,15 +353,7 @@ uint String::createHashValue(const char *ch, int length)
     if (stringHash != UINT_MAX)
         return stringHash;
 
-    uint h = 0xffffffff;
-    while (ch < end) {
-        if ((uchar)(*ch) >= 0x80)
-            return UINT_MAX;
-        h = 31 * h + *ch;
-        ++ch;
-    }
-
-    return h;
+    return hashChars(ch, end);
 }
 
 uint String::getLength(const Managed *m)
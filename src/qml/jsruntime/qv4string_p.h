@@ -106,7 +106,11 @@ struct Q_QML_PRIVATE_EXPORT String : Base {
         if (subtype == Heap::String::StringType_ArrayIndex && other->subtype == Heap::String::StringType_ArrayIndex)
             return true;
 
-        return toQString() == other->toQString();
+        // both are flat after hashValue(), so compare the data directly instead of taking a
+        // reference on both for a QString comparison
+        Q_ASSERT(!other->largestSubLength);
+        return text->size == other->text->size
+                && !memcmp(text->data(), other->text->data(), text->size * sizeof(QChar));
     }
 
     union {
@@ -122,7 +126,9 @@ struct Q_QML_PRIVATE_EXPORT String : Base {
     mutable uint largestSubLength;
     uint len;
     MemoryManager *mm;
-private:
+
+    // Copies the characters of data to ch, which needs room for data->length() characters.
+    // Unlike toQString() this doesn't flatten ropes and doesn't allocate on the JS heap.
     static void append(const String *data, QChar *ch);
 };
 #endif
@@ -345,6 +345,10 @@ Param traceParam(const Param &param)
     if (engine->hasException) \
         goto catchException
 
+#define COUNT_BACK_EDGE(offset) \
+    if (offset < 0 && backEdgeCount) \
+        ++*backEdgeCount
+
 QV4::ReturnedValue VME::run(ExecutionEngine *engine, const uchar *code
 #ifdef MOTH_THREADED_INTERPRETER
         , void ***storeJumpTable
@@ -394,7 +398,7 @@ QV4::ReturnedValue VME::run(ExecutionEngine *engine, const uchar *code
 
     QV4::Value **scopes = static_cast<QV4::Value **>(alloca(sizeof(QV4::Value *)*(2 + 2*scopeDepth)));
     {
-        scopes[0] = const_cast<QV4::Value *>(context->d()->compilationUnit->data->constants());
+        scopes[0] = const_cast<QV4::Value *>(context->d()->compilationUnit->runtimeConstants);
         // stack gets setup in push instruction
         scopes[1] = 0;
         QV4::Heap::ExecutionContext *scope = context->d();
@@ -771,20 +775,25 @@ QV4::ReturnedValue VME::run(ExecutionEngine *engine, const uchar *code
 
     MOTH_BEGIN_INSTR(Jump)
         code = ((const uchar *)&instr.offset) + instr.offset;
+        COUNT_BACK_EDGE(instr.offset);
     MOTH_END_INSTR(Jump)
 
     MOTH_BEGIN_INSTR(JumpEq)
         bool cond = VALUEPTR(instr.condition)->toBoolean();
         TRACE(condition, "%s", cond ? "TRUE" : "FALSE");
-        if (cond)
+        if (cond) {
             code = ((const uchar *)&instr.offset) + instr.offset;
+            COUNT_BACK_EDGE(instr.offset);
+        }
     MOTH_END_INSTR(JumpEq)
 
     MOTH_BEGIN_INSTR(JumpNe)
         bool cond = VALUEPTR(instr.condition)->toBoolean();
         TRACE(condition, "%s", cond ? "TRUE" : "FALSE");
-        if (!cond)
+        if (!cond) {
             code = ((const uchar *)&instr.offset) + instr.offset;
+            COUNT_BACK_EDGE(instr.offset);
+        }
     MOTH_END_INSTR(JumpNe)
 
     MOTH_BEGIN_INSTR(UNot)
@@ -954,10 +963,33 @@ void **VME::instructionJumpTable()
 QV4::ReturnedValue VME::exec(ExecutionEngine *engine, const uchar *code)
 {
     VME vme;
+    return vme.execute(engine, code);
+}
+
+QV4::ReturnedValue VME::execCounting(ExecutionEngine *engine, const uchar *codeData)
+{
+    QV4::Function *function = reinterpret_cast<QV4::Function *>(const_cast<uchar *>(codeData));
+    if (++function->interpreterCallCount >= engine->jitCallThreshold
+            || function->interpreterBackEdgeCount >= engine->jitBackEdgeThreshold) {
+        if (!function->compilationUnit->tierUpFunction(function)) {
+            // The unit let go of the IR, so the function stays in the interpreter
+            function->code = &VME::exec;
+            function->codeData = function->interpreterCode;
+        }
+        return function->code(engine, function->codeData);
+    }
+
+    VME vme;
+    vme.backEdgeCount = &function->interpreterBackEdgeCount;
+    return vme.execute(engine, function->interpreterCode);
+}
+
+QV4::ReturnedValue VME::execute(ExecutionEngine *engine, const uchar *code)
+{
     QV4::Debugging::Debugger *debugger = engine->debugger;
     if (debugger)
         debugger->enteringFunction();
-    QV4::ReturnedValue retVal = vme.run(engine, code);
+    QV4::ReturnedValue retVal = run(engine, code);
     if (debugger)
         debugger->leavingFunction(retVal);
     return retVal;
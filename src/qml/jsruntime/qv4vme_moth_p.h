@@ -56,18 +56,27 @@ namespace Moth {
 class VME
 {
 public:
+    VME() : backEdgeCount(0) {}
+
     static QV4::ReturnedValue exec(QV4::ExecutionEngine *, const uchar *);
+    // Runs the interpreter code of a function that tiers up to the JIT once it's called or loops
+    // often enough. The code data is the QV4::Function.
+    static QV4::ReturnedValue execCounting(QV4::ExecutionEngine *, const uchar *);
 
 #ifdef MOTH_THREADED_INTERPRETER
     static void **instructionJumpTable();
 #endif
 
 private:
+    QV4::ReturnedValue execute(QV4::ExecutionEngine *, const uchar *code);
     QV4::ReturnedValue run(QV4::ExecutionEngine *, const uchar *code
 #ifdef MOTH_THREADED_INTERPRETER
             , void ***storeJumpTable = 0
 #endif
             );
+
+    // Counts the jumps back to the start of a loop
+    uint *backEdgeCount;
 };
 
 } // namespace Moth
@@ -36,11 +36,19 @@
 #include "qv4objectproto_p.h"
 #include "qv4mm_p.h"
 #include "qv4qobjectwrapper_p.h"
+#include "qv4functionobject_p.h"
+#include "qv4string_p.h"
 #include <qqmlengine.h>
 #include "PageAllocation.h"
 #include "StdLibExtras.h"
 
-#include <QTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QIODevice>
+#include <QtAlgorithms>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QVarLengthArray>
 #include <QVector>
 #include <QVector>
 #include <QMap>
@@ -77,42 +85,98 @@ struct MemoryManager::Data
     struct ChunkHeader {
         Heap::Base freeItems;
         ChunkHeader *nextNonFull;
+        quint64 *objectBitmap; // one bit per 16 bytes, set at the start of every allocated item
         char *itemStart;
         char *itemEnd;
+        char *bumpPointer; // items from here on have never been handed out
         int itemSize;
+        int chunkIndex; // in heapChunks
+        uint liveItems; // as of the last sweep
+        bool decommitted;
+
+        size_t bitmapWords() const { return (size_t(bumpPointer - itemStart) / 16 + 63) / 64; }
+        void setAllocated(Heap::Base *m)
+        {
+            const size_t granule = size_t(reinterpret_cast<char *>(m) - itemStart) >> 4;
+            objectBitmap[granule >> 6] |= quint64(1) << (granule & 63);
+        }
     };
 
     bool gcBlocked;
     bool aggressiveGC;
     bool gcStats;
+    bool incrementalSweep;
+    bool gcDeferred;
     ExecutionEngine *engine;
 
     enum { MaxItemSize = 512 };
+    enum EmptyChunkPolicy {
+        KeepEmptyChunks,
+        DecommitEmptyChunks,
+        ReleaseEmptyChunks
+    };
+
     ChunkHeader *nonFullChunks[MaxItemSize/16];
+    ChunkHeader *decommittedChunks[MaxItemSize/16];
     uint nChunks[MaxItemSize/16];
     uint availableItems[MaxItemSize/16];
     uint allocCount[MaxItemSize/16];
+    uint itemsInUse[MaxItemSize/16];
     int totalItems;
     int totalAlloc;
     uint maxShift;
     std::size_t maxChunkSize;
+    uint emptyChunkPolicy;
+    uint compactionThreshold; // in percent of the available items of a size
+    std::size_t decommittedSize;
     QVector<PageAllocation> heapChunks;
     std::size_t unmanagedHeapSize; // the amount of bytes of heap that is not managed by the memory manager, but which is held onto by managed items.
     std::size_t unmanagedHeapSizeGCLimit;
 
+    // chunks that still hold the unmarked items of the last mark phase, linked through nextNonFull
+    ChunkHeader *unsweptChunks[MaxItemSize/16];
+    uint itemsInUseAtGC[MaxItemSize/16];
+    int unsweptChunkCount;
+    int lazilySweptChunks;
+    qint64 lazySweepTime;
+
+    // Statistics of the last collection. They are only reported once all of its chunks are
+    // swept, so that the freed bytes and the occupancy include the lazily swept garbage.
+    Profiling::GarbageCollectionProperties pendingGCReport;
+    Profiling::Profiler *pendingGCProfiler;
+    QElapsedTimer gcTimer; // started with the collection that is to be reported
+    bool hasPendingGCReport;
+    std::size_t sweptBytes;
+    MemoryManager::GarbageCollectionCallback gcCallback;
+    void *gcCallbackData;
+
+    // Large items get pages of their own, with this header in front of the item.
     struct LargeItem {
         LargeItem *next;
-        size_t size;
-        void *data;
+        size_t size; // of the item
+        size_t allocationSize; // of the pages holding the header and the item
 
+        static size_t headerSize() { return roundUpToMultipleOf(16, sizeof(LargeItem)); }
         Heap::Base *heapObject() {
-            return reinterpret_cast<Heap::Base *>(&data);
+            return reinterpret_cast<Heap::Base *>(reinterpret_cast<char *>(this) + headerSize());
         }
     };
 
     LargeItem *largeItems;
     std::size_t totalLargeItemsAllocated;
 
+    // The pages of large items freed by the last sweep, for reuse by items of a similar size.
+    // Whatever isn't reused until the next sweep gets released.
+    QVector<LargeItem *> largeItemCache;
+    std::size_t largeItemCacheSize;
+    std::size_t maxLargeItemCacheSize;
+    uint largeItemCacheHits;
+    uint largeItemCacheMisses;
+
+    // memory of released chunks and dead large items, handed back to the OS by a helper thread
+    QVector<PageAllocation> chunksToRelease;
+    QVector<LargeItem *> largeItemsToFree;
+
     // statistics:
 #ifdef DETAILED_MM_STATS
     QVector<unsigned> allocSizeCounters;
@@ -120,22 +184,43 @@ struct MemoryManager::Data
 
     Data()
         : gcBlocked(false)
+        , gcDeferred(false)
         , engine(0)
         , totalItems(0)
         , totalAlloc(0)
         , maxShift(6)
         , maxChunkSize(32*1024)
+        , emptyChunkPolicy(KeepEmptyChunks)
+        , compactionThreshold(0)
+        , decommittedSize(0)
         , unmanagedHeapSize(0)
         , unmanagedHeapSizeGCLimit(MIN_UNMANAGED_HEAPSIZE_GC_LIMIT)
+        , unsweptChunkCount(0)
+        , lazilySweptChunks(0)
+        , lazySweepTime(0)
+        , pendingGCProfiler(0)
+        , hasPendingGCReport(false)
+        , sweptBytes(0)
+        , gcCallback(0)
+        , gcCallbackData(0)
         , largeItems(0)
         , totalLargeItemsAllocated(0)
+        , largeItemCacheSize(0)
+        , maxLargeItemCacheSize(4 * 1024 * 1024)
+        , largeItemCacheHits(0)
+        , largeItemCacheMisses(0)
     {
         memset(nonFullChunks, 0, sizeof(nonFullChunks));
+        memset(decommittedChunks, 0, sizeof(decommittedChunks));
         memset(nChunks, 0, sizeof(nChunks));
         memset(availableItems, 0, sizeof(availableItems));
         memset(allocCount, 0, sizeof(allocCount));
+        memset(itemsInUse, 0, sizeof(itemsInUse));
+        memset(unsweptChunks, 0, sizeof(unsweptChunks));
+        memset(itemsInUseAtGC, 0, sizeof(itemsInUseAtGC));
         aggressiveGC = !qgetenv("QV4_MM_AGGRESSIVE_GC").isEmpty();
         gcStats = !qgetenv("QV4_MM_STATS").isEmpty();
+        incrementalSweep = qgetenv("QV4_MM_NO_INCREMENTAL_SWEEP").isEmpty();
 
         QByteArray overrideMaxShift = qgetenv("QV4_MM_MAXBLOCK_SHIFT");
         bool ok;
@@ -147,6 +232,21 @@ struct MemoryManager::Data
         std::size_t tmpMaxChunkSize = maxChunkString.toUInt(&ok);
         if (ok)
             maxChunkSize = tmpMaxChunkSize;
+
+        QByteArray emptyChunkPolicyString = qgetenv("QV4_MM_EMPTY_CHUNK_POLICY");
+        uint tmpEmptyChunkPolicy = emptyChunkPolicyString.toUInt(&ok);
+        if (ok && tmpEmptyChunkPolicy <= ReleaseEmptyChunks)
+            emptyChunkPolicy = tmpEmptyChunkPolicy;
+
+        QByteArray largeItemCacheString = qgetenv("QV4_MM_LARGE_ITEM_CACHE_SIZE");
+        std::size_t tmpLargeItemCacheSize = largeItemCacheString.toUInt(&ok);
+        if (ok)
+            maxLargeItemCacheSize = tmpLargeItemCacheSize;
+
+        QByteArray compactionThresholdString = qgetenv("QV4_MM_COMPACTION_THRESHOLD");
+        uint tmpCompactionThreshold = compactionThresholdString.toUInt(&ok);
+        if (ok && tmpCompactionThreshold <= 100)
+            compactionThreshold = tmpCompactionThreshold;
     }
 
     ~Data()
@@ -160,64 +260,354 @@ struct MemoryManager::Data
 
 namespace {
 
-bool sweepChunk(MemoryManager::Data::ChunkHeader *header, uint *itemsInUse, ExecutionEngine *engine, std::size_t *unmanagedHeapSize)
+bool sweepChunk(MemoryManager::Data::ChunkHeader *header, uint *itemsFreed, ExecutionEngine *engine, std::size_t *unmanagedHeapSize)
 {
     Q_ASSERT(unmanagedHeapSize);
 
     bool isEmpty = true;
-    Heap::Base *tail = &header->freeItems;
+    header->liveItems = 0;
+    const bool isStringChunk = std::size_t(header->itemSize) == MemoryManager::align(sizeof(Heap::String));
 //    qDebug("chunkStart @ %p, size=%x, pos=%x", header->itemStart, header->itemSize, header->itemSize>>4);
-#ifdef V4_USE_VALGRIND
-    VALGRIND_DISABLE_ERROR_REPORTING;
-#endif
-    for (char *item = header->itemStart; item <= header->itemEnd; item += header->itemSize) {
-        Heap::Base *m = reinterpret_cast<Heap::Base *>(item);
-//        qDebug("chunk @ %p, in use: %s, mark bit: %s",
-//               item, (m->inUse() ? "yes" : "no"), (m->isMarked() ? "true" : "false"));
 
-        Q_ASSERT((qintptr) item % 16 == 0);
+    // Only the allocated items are visited, free ones stay linked in the free list as they are.
+    for (size_t word = 0, nWords = header->bitmapWords(); word < nWords; ++word) {
+        quint64 allocated = header->objectBitmap[word];
+        while (allocated) {
+            const uint bit = qCountTrailingZeroBits(allocated);
+            allocated &= allocated - 1;
+            Heap::Base *m = reinterpret_cast<Heap::Base *>(header->itemStart + ((word * 64 + bit) << 4));
+//            qDebug("chunk @ %p, mark bit: %s", m, (m->isMarked() ? "true" : "false"));
 
-        if (m->isMarked()) {
+            Q_ASSERT((qintptr) m % 16 == 0);
             Q_ASSERT(m->inUse());
-            m->clearMarkBit();
-            isEmpty = false;
-            ++(*itemsInUse);
-        } else {
-            if (m->inUse()) {
-//                qDebug() << "-- collecting it." << m << tail << m->nextFree();
-#ifdef V4_USE_VALGRIND
-                VALGRIND_ENABLE_ERROR_REPORTING;
-#endif
-                if (std::size_t(header->itemSize) == MemoryManager::align(sizeof(Heap::String)) && m->vtable()->isString) {
-                    std::size_t heapBytes = static_cast<Heap::String *>(m)->retainedTextSize();
-                    Q_ASSERT(*unmanagedHeapSize >= heapBytes);
-//                    qDebug() << "-- it's a string holding on to" << heapBytes << "bytes";
-                    *unmanagedHeapSize -= heapBytes;
-                }
 
-                if (m->vtable()->destroy)
-                    m->vtable()->destroy(m);
+            if (m->isMarked()) {
+                m->clearMarkBit();
+                isEmpty = false;
+                ++header->liveItems;
+                continue;
+            }
+
+//            qDebug() << "-- collecting it." << m;
+            if (isStringChunk && m->vtable()->isString) {
+                std::size_t heapBytes = static_cast<Heap::String *>(m)->retainedTextSize();
+                Q_ASSERT(*unmanagedHeapSize >= heapBytes);
+//                qDebug() << "-- it's a string holding on to" << heapBytes << "bytes";
+                *unmanagedHeapSize -= heapBytes;
+            }
+
+            if (m->vtable()->destroy)
+                m->vtable()->destroy(m);
 
-                memset(m, 0, header->itemSize);
+            memset(m, 0, header->itemSize);
 #ifdef V4_USE_VALGRIND
-                VALGRIND_DISABLE_ERROR_REPORTING;
-                VALGRIND_MEMPOOL_FREE(engine->memoryManager, m);
+            VALGRIND_MEMPOOL_FREE(engine->memoryManager, m);
 #endif
-                Q_V4_PROFILE_DEALLOC(engine, m, header->itemSize, Profiling::SmallItem);
-                ++(*itemsInUse);
-            }
-            // Relink all free blocks to rewrite references to any released chunk.
-            tail->setNextFree(m);
-            tail = m;
+            Q_V4_PROFILE_DEALLOC(engine, m, header->itemSize, Profiling::SmallItem);
+            header->objectBitmap[word] &= ~(quint64(1) << bit);
+            m->setNextFree(header->freeItems.nextFree());
+            header->freeItems.setNextFree(m);
+            ++(*itemsFreed);
         }
     }
-    tail->setNextFree(0);
-#ifdef V4_USE_VALGRIND
-    VALGRIND_ENABLE_ERROR_REPORTING;
-#endif
+
+    if (isEmpty) {
+        // hand out the items of an empty chunk in address order again
+        header->freeItems.setNextFree(0);
+        header->bumpPointer = header->itemStart;
+    }
     return isEmpty;
 }
 
+// The pages behind the header and the object bitmap only hold items, and can be decommitted
+// while the chunk is empty.
+char *itemPages(MemoryManager::Data::ChunkHeader *header, std::size_t *size)
+{
+    char *begin = reinterpret_cast<char *>(roundUpToMultipleOf(WTF::pageSize(), quintptr(header->itemStart)));
+    char *end = header->itemEnd + header->itemSize;
+    *size = end > begin ? std::size_t(end - begin) : 0;
+    return begin;
+}
+
+bool hasMoreLiveItems(const MemoryManager::Data::ChunkHeader *a, const MemoryManager::Data::ChunkHeader *b)
+{
+    return a->liveItems > b->liveItems;
+}
+
+class ReleaseMemoryJob : public QRunnable
+{
+public:
+    ReleaseMemoryJob(const QVector<PageAllocation> &chunks,
+                     const QVector<MemoryManager::Data::LargeItem *> &largeItems)
+        : chunks(chunks)
+        , largeItems(largeItems)
+    {}
+
+    void run() Q_DECL_OVERRIDE
+    {
+        // Nothing in here touches the engine, the memory is unreachable and already destroyed.
+        for (QVector<PageAllocation>::iterator i = chunks.begin(), ei = chunks.end(); i != ei; ++i)
+            i->deallocate();
+        for (QVector<MemoryManager::Data::LargeItem *>::const_iterator i = largeItems.cbegin(), ei = largeItems.cend(); i != ei; ++i)
+            OSAllocator::decommitAndRelease(*i, (*i)->allocationSize);
+    }
+
+private:
+    QVector<PageAllocation> chunks;
+    QVector<MemoryManager::Data::LargeItem *> largeItems;
+};
+
+bool keepQObjectWrapperAlive(QObjectWrapper *qobjectWrapper)
+{
+    QObject *qobject = qobjectWrapper->object();
+    if (!qobject)
+        return false;
+    if (QQmlData::keepAliveDuringGarbageCollection(qobject))
+        return true;
+    if (QObject *parent = qobject->parent()) {
+        while (parent->parent())
+            parent = parent->parent();
+        return QQmlData::keepAliveDuringGarbageCollection(parent);
+    }
+    return false;
+}
+
+// Collects the object graph in the layout of the .heapsnapshot files written by V8, so that they
+// can be loaded into the memory tab of the Chrome developer tools. Nodes know their outgoing edges
+// only, and the edges of all nodes are stored in node order.
+class HeapSnapshot
+{
+public:
+    // the node and edge types of V8, we only use the ones that apply to V4
+    enum NodeType {
+        HiddenNode = 0,
+        ArrayNode = 1,
+        StringNode = 2,
+        ObjectNode = 3,
+        ClosureNode = 5,
+        RegExpNode = 6,
+        NativeNode = 8,
+        SyntheticNode = 9,
+        ConsStringNode = 10
+    };
+    enum EdgeType {
+        ElementEdge = 1
+    };
+
+    HeapSnapshot() : currentNode(-1) { string(QString()); }
+
+    int addNode(Heap::Base *object, quint64 selfSize)
+    {
+        Node node = { object, selfSize, 0 };
+        nodes.append(node);
+        nodeIndex.insert(object, nodes.size() - 1);
+        return nodes.size() - 1;
+    }
+
+    int addSyntheticNode(const char *name)
+    {
+        Node node = { 0, 0, 0 };
+        nodes.append(node);
+        syntheticNames.insert(nodes.size() - 1, QString::fromLatin1(name));
+        return nodes.size() - 1;
+    }
+
+    // Objects that are not on the GC heap, like the contexts on the C++ stack, show up as edge
+    // targets only. They become nodes of their own when first seen.
+    int nodeFor(Heap::Base *object)
+    {
+        QHash<Heap::Base *, int>::const_iterator it = nodeIndex.constFind(object);
+        return it != nodeIndex.constEnd() ? *it : addNode(object, 0);
+    }
+
+    Heap::Base *object(int node) const { return nodes.at(node).object; }
+    int nodeCount() const { return nodes.size(); }
+
+    void beginEdges(int node) { currentNode = node; }
+    void addEdge(int to)
+    {
+        Q_ASSERT(currentNode >= 0);
+        Edge edge = { ++nodes[currentNode].edgeCount, to };
+        edges.append(edge);
+    }
+
+    bool write(QIODevice *device);
+
+private:
+    struct Node {
+        Heap::Base *object; // 0 for synthetic nodes
+        quint64 selfSize;
+        int edgeCount;
+    };
+    struct Edge {
+        int index;
+        int toNode;
+    };
+
+    int string(const QString &s);
+    void describe(int node, int *type, QString *name);
+
+    QVector<Node> nodes;
+    QVector<Edge> edges;
+    QHash<Heap::Base *, int> nodeIndex;
+    QHash<int, QString> syntheticNames;
+    QVector<QString> strings;
+    QHash<QString, int> stringIndex;
+    int currentNode;
+};
+
+int HeapSnapshot::string(const QString &s)
+{
+    QHash<QString, int>::const_iterator it = stringIndex.constFind(s);
+    if (it != stringIndex.constEnd())
+        return *it;
+    strings.append(s);
+    stringIndex.insert(s, strings.size() - 1);
+    return strings.size() - 1;
+}
+
+void HeapSnapshot::describe(int node, int *type, QString *name)
+{
+    Heap::Base *h = nodes.at(node).object;
+    if (!h) {
+        *type = SyntheticNode;
+        *name = syntheticNames.value(node);
+        return;
+    }
+
+    const VTable *vtable = h->vtable();
+    if (vtable->isString) {
+        Heap::String *s = static_cast<Heap::String *>(h);
+        // Don't flatten ropes here, that would allocate and change the graph.
+        if (s->largestSubLength) {
+            *type = ConsStringNode;
+            *name = QStringLiteral("(concatenated string)");
+        } else {
+            *type = StringNode;
+            *name = s->toQString().left(256);
+        }
+    } else if (vtable == QObjectWrapper::staticVTable()) {
+        *type = NativeNode;
+        QObject *object = static_cast<Heap::QObjectWrapper *>(h)->object;
+        if (!object) {
+            *name = QStringLiteral("QObjectWrapper (deleted)");
+        } else {
+            *name = QString::fromLatin1(object->metaObject()->className());
+            if (!object->objectName().isEmpty())
+                *name += QLatin1Char(' ') + object->objectName();
+        }
+    } else if (vtable->isFunctionObject) {
+        *type = ClosureNode;
+        Function *function = static_cast<Heap::FunctionObject *>(h)->function;
+        if (function) {
+            *name = QStringLiteral("%1 %2:%3").arg(function->name()->toQString())
+                    .arg(function->sourceFile()).arg(function->compiledFunction->location.line);
+        } else {
+            *name = QString::fromLatin1(vtable->className);
+        }
+    } else {
+        if (!vtable->isObject)
+            *type = HiddenNode;
+        else if (vtable->type == Managed::Type_ArrayObject)
+            *type = ArrayNode;
+        else if (vtable->type == Managed::Type_RegExpObject)
+            *type = RegExpNode;
+        else
+            *type = ObjectNode;
+        *name = QString::fromLatin1(vtable->className);
+    }
+}
+
+void writeJsonString(QByteArray *out, const QString &s)
+{
+    out->append('"');
+    for (int i = 0; i < s.length(); ++i) {
+        const ushort c = s.at(i).unicode();
+        if (c == '"' || c == '\\') {
+            out->append('\\');
+            out->append(char(c));
+        } else if (c >= 0x20 && c < 0x7f) {
+            out->append(char(c));
+        } else {
+            char escaped[7];
+            qsnprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out->append(escaped, 6);
+        }
+    }
+    out->append('"');
+}
+
+bool HeapSnapshot::write(QIODevice *device)
+{
+    QVector<int> types(nodes.size());
+    QVector<int> names(nodes.size());
+    for (int i = 0; i < nodes.size(); ++i) {
+        QString name;
+        describe(i, &types[i], &name);
+        names[i] = string(name);
+    }
+
+    QByteArray out;
+    out.append("{\"snapshot\":{\"meta\":{"
+               "\"node_fields\":[\"type\",\"name\",\"id\",\"self_size\",\"edge_count\",\"trace_node_id\"],"
+               "\"node_types\":[[\"hidden\",\"array\",\"string\",\"object\",\"code\",\"closure\","
+               "\"regexp\",\"number\",\"native\",\"synthetic\",\"concatenated string\","
+               "\"sliced string\"],\"string\",\"number\",\"number\",\"number\",\"number\"],"
+               "\"edge_fields\":[\"type\",\"name_or_index\",\"to_node\"],"
+               "\"edge_types\":[[\"context\",\"element\",\"property\",\"internal\",\"hidden\","
+               "\"shortcut\",\"weak\"],\"string_or_number\",\"node\"],"
+               "\"trace_function_info_fields\":[],\"trace_node_fields\":[],"
+               "\"sample_fields\":[],\"location_fields\":[]},");
+    out.append("\"node_count\":" + QByteArray::number(nodes.size()));
+    out.append(",\"edge_count\":" + QByteArray::number(edges.size()));
+    out.append(",\"trace_function_count\":0},\n\"nodes\":[");
+
+    const int nodeFieldCount = 6;
+    const int bufferSize = 64 * 1024;
+    for (int i = 0; i < nodes.size(); ++i) {
+        const Node &node = nodes.at(i);
+        if (i)
+            out.append(",\n");
+        out.append(QByteArray::number(types.at(i)) + ',' + QByteArray::number(names.at(i)) + ','
+                   + QByteArray::number(2 * i + 1) + ',' + QByteArray::number(node.selfSize) + ','
+                   + QByteArray::number(node.edgeCount) + ",0");
+        if (out.size() > bufferSize) {
+            if (device->write(out) != out.size())
+                return false;
+            out.clear();
+        }
+    }
+
+    out.append("],\n\"edges\":[");
+    for (int i = 0; i < edges.size(); ++i) {
+        const Edge &edge = edges.at(i);
+        if (i)
+            out.append(",\n");
+        out.append(QByteArray::number(ElementEdge) + ',' + QByteArray::number(edge.index) + ','
+                   + QByteArray::number(edge.toNode * nodeFieldCount));
+        if (out.size() > bufferSize) {
+            if (device->write(out) != out.size())
+                return false;
+            out.clear();
+        }
+    }
+
+    out.append("],\n\"trace_function_infos\":[],\"trace_tree\":[],\"samples\":[],\"locations\":[],"
+               "\n\"strings\":[");
+    for (int i = 0; i < strings.size(); ++i) {
+        if (i)
+            out.append(",\n");
+        writeJsonString(&out, strings.at(i));
+        if (out.size() > bufferSize) {
+            if (device->write(out) != out.size())
+                return false;
+            out.clear();
+        }
+    }
+    out.append("]}\n");
+    return device->write(out) == out.size();
+}
+
 } // namespace
 
 MemoryManager::MemoryManager(ExecutionEngine *engine)
@@ -244,9 +634,12 @@ Heap::Base *MemoryManager::allocData(std::size_t size, std::size_t unmanagedSize
     Q_ASSERT(size % 16 == 0);
 
 //    qDebug() << "unmanagedHeapSize:" << m_d->unmanagedHeapSize << "limit:" << m_d->unmanagedHeapSizeGCLimit << "unmanagedSize:" << unmanagedSize;
+    // While GC is deferred, the heap may grow to twice the usual trigger points before we collect.
+    const uint deferShift = m_d->gcDeferred ? 1 : 0;
+
     m_d->unmanagedHeapSize += unmanagedSize;
     bool didGCRun = false;
-    if (m_d->unmanagedHeapSize > m_d->unmanagedHeapSizeGCLimit) {
+    if (m_d->unmanagedHeapSize > (m_d->unmanagedHeapSizeGCLimit << deferShift)) {
         runGC();
 
         if (3*m_d->unmanagedHeapSizeGCLimit <= 4*m_d->unmanagedHeapSize)
@@ -262,14 +655,35 @@ Heap::Base *MemoryManager::allocData(std::size_t size, std::size_t unmanagedSize
 
     // doesn't fit into a small bucket
     if (size >= MemoryManager::Data::MaxItemSize) {
-        if (!didGCRun && m_d->totalLargeItemsAllocated > 8 * 1024 * 1024)
-            runGC();
-
-        // we use malloc for this
-        MemoryManager::Data::LargeItem *item = static_cast<MemoryManager::Data::LargeItem *>(
-                malloc(Q_V4_PROFILE_ALLOC(engine, size + sizeof(MemoryManager::Data::LargeItem),
-                                          Profiling::LargeItem)));
-        memset(item, 0, size + sizeof(MemoryManager::Data::LargeItem));
+        if (!didGCRun && m_d->totalLargeItemsAllocated > (std::size_t(8 * 1024 * 1024) << deferShift))
+            collectGarbage(m_d->incrementalSweep);
+
+        // Large items are mapped directly. Prefer the smallest cached region that doesn't
+        // waste more than a quarter of its pages.
+        const std::size_t allocationSize = roundUpToMultipleOf(
+                    WTF::pageSize(), MemoryManager::Data::LargeItem::headerSize() + size);
+        MemoryManager::Data::LargeItem *item = 0;
+        int cached = -1;
+        for (int i = 0; i < m_d->largeItemCache.size(); ++i) {
+            const std::size_t cachedSize = m_d->largeItemCache.at(i)->allocationSize;
+            if (cachedSize >= allocationSize && cachedSize - allocationSize <= allocationSize / 4
+                    && (cached < 0 || cachedSize < m_d->largeItemCache.at(cached)->allocationSize))
+                cached = i;
+        }
+        if (cached >= 0) {
+            item = m_d->largeItemCache.at(cached);
+            m_d->largeItemCache.remove(cached);
+            m_d->largeItemCacheSize -= item->allocationSize;
+            ++m_d->largeItemCacheHits;
+            memset(item->heapObject(), 0, size);
+        } else {
+            // fresh pages are zeroed already
+            item = static_cast<MemoryManager::Data::LargeItem *>(
+                        OSAllocator::reserveAndCommit(allocationSize, OSAllocator::JSGCHeapPages));
+            item->allocationSize = allocationSize;
+            ++m_d->largeItemCacheMisses;
+        }
+        Q_V4_PROFILE_ALLOC(engine, size + MemoryManager::Data::LargeItem::headerSize(), Profiling::LargeItem);
         item->next = m_d->largeItems;
         item->size = size;
         m_d->largeItems = item;
@@ -279,19 +693,41 @@ Heap::Base *MemoryManager::allocData(std::size_t size, std::size_t unmanagedSize
 
     Heap::Base *m = 0;
     Data::ChunkHeader *header = m_d->nonFullChunks[pos];
-    if (header) {
-        m = header->freeItems.nextFree();
-        goto found;
+    while (!header && m_d->unsweptChunks[pos]) {
+        // the last GC left chunks of this size unswept, reclaim their garbage first
+        sweepNextChunk(pos);
+        header = m_d->nonFullChunks[pos];
     }
+    if (header)
+        goto found;
 
     // try to free up space, otherwise allocate
-    if (!didGCRun && m_d->allocCount[pos] > (m_d->availableItems[pos] >> 1) && m_d->totalAlloc > (m_d->totalItems >> 1) && !m_d->aggressiveGC) {
-        runGC();
+    if (!didGCRun && m_d->allocCount[pos] > (m_d->availableItems[pos] >> (1 - deferShift)) && m_d->totalAlloc > (m_d->totalItems >> (1 - deferShift)) && !m_d->aggressiveGC) {
+        // Only the chunks of the requested size are swept right away, the others are swept
+        // on demand or in slices through continueSweep().
+        collectGarbage(m_d->incrementalSweep);
         header = m_d->nonFullChunks[pos];
-        if (header) {
-            m = header->freeItems.nextFree();
-            goto found;
+        while (!header && m_d->unsweptChunks[pos]) {
+            sweepNextChunk(pos);
+            header = m_d->nonFullChunks[pos];
         }
+        if (header)
+            goto found;
+    }
+
+    // reuse a decommitted chunk before asking the OS for a new one
+    header = m_d->decommittedChunks[pos];
+    if (header) {
+        m_d->decommittedChunks[pos] = header->nextNonFull;
+        std::size_t pagesSize;
+        char *pages = itemPages(header, &pagesSize);
+        OSAllocator::commit(pages, Q_V4_PROFILE_ALLOC(engine, pagesSize, Profiling::HeapPage), true, false);
+        header->decommitted = false;
+        m_d->decommittedSize -= pagesSize;
+
+        header->nextNonFull = m_d->nonFullChunks[pos];
+        m_d->nonFullChunks[pos] = header;
+        goto found;
     }
 
     // no free item available, allocate a new chunk
@@ -309,21 +745,23 @@ Heap::Base *MemoryManager::allocData(std::size_t size, std::size_t unmanagedSize
 
         header = reinterpret_cast<Data::ChunkHeader *>(allocation.base());
         header->itemSize = int(size);
-        header->itemStart = reinterpret_cast<char *>(allocation.base()) + roundUpToMultipleOf(16, sizeof(Data::ChunkHeader));
+        header->chunkIndex = m_d->heapChunks.size() - 1;
+        // the object bitmap lives right behind the header, fresh pages are zeroed already
+        const size_t bitmapSize = (allocSize / 16 + 63) / 64 * sizeof(quint64);
+        header->objectBitmap = reinterpret_cast<quint64 *>(reinterpret_cast<char *>(allocation.base()) + roundUpToMultipleOf(16, sizeof(Data::ChunkHeader)));
+        header->itemStart = reinterpret_cast<char *>(header->objectBitmap) + roundUpToMultipleOf(16, bitmapSize);
         header->itemEnd = reinterpret_cast<char *>(allocation.base()) + allocation.size() - header->itemSize;
 
+        // Items are handed out by bumping a pointer through the fresh memory, so we don't need
+        // to touch the whole chunk to build up a free list here.
+        header->freeItems.setNextFree(0);
+        header->bumpPointer = header->itemStart;
+        header->liveItems = 0;
+        header->decommitted = false;
+
         header->nextNonFull = m_d->nonFullChunks[pos];
         m_d->nonFullChunks[pos] = header;
 
-        Heap::Base *last = &header->freeItems;
-        for (char *item = header->itemStart; item <= header->itemEnd; item += header->itemSize) {
-            Heap::Base *o = reinterpret_cast<Heap::Base *>(item);
-            last->setNextFree(o);
-            last = o;
-
-        }
-        last->setNextFree(0);
-        m = header->freeItems.nextFree();
         const size_t increase = (header->itemEnd - header->itemStart) / header->itemSize;
         m_d->availableItems[pos] += uint(increase);
         m_d->totalItems += int(increase);
@@ -334,16 +772,26 @@ Heap::Base *MemoryManager::allocData(std::size_t size, std::size_t unmanagedSize
     }
 
   found:
+    m = header->freeItems.nextFree();
+    if (m) {
+        header->freeItems.setNextFree(m->nextFree());
+    } else {
+        Q_ASSERT(header->bumpPointer <= header->itemEnd);
+        m = reinterpret_cast<Heap::Base *>(header->bumpPointer);
+        header->bumpPointer += header->itemSize;
+    }
+    if (!header->freeItems.nextFree() && header->bumpPointer > header->itemEnd)
+        m_d->nonFullChunks[pos] = header->nextNonFull;
+    header->setAllocated(m);
+
 #ifdef V4_USE_VALGRIND
     VALGRIND_MEMPOOL_ALLOC(this, m, size);
 #endif
     Q_V4_PROFILE_ALLOC(engine, size, Profiling::SmallItem);
 
     ++m_d->allocCount[pos];
+    ++m_d->itemsInUse[pos];
     ++m_d->totalAlloc;
-    header->freeItems.setNextFree(m->nextFree());
-    if (!header->freeItems.nextFree())
-        m_d->nonFullChunks[pos] = header->nextNonFull;
     return m;
 }
 
@@ -360,6 +808,11 @@ void MemoryManager::mark()
 {
     Value *markBase = engine->jsStackTop;
 
+    // some execution contexts are allocated on the stack and never get swept. Chunks are swept
+    // completely before we get here, so any mark bit left in the context chain is a stale one.
+    for (QV4::ExecutionContext *ctx = engine->currentContext; ctx; ctx = engine->parentContext(ctx))
+        ctx->d()->clearMarkBit();
+
     engine->markObjects();
 
     collectFromJSStack();
@@ -378,21 +831,7 @@ void MemoryManager::mark()
         if (!(*it).as<QObjectWrapper>())
             continue;
         QObjectWrapper *qobjectWrapper = static_cast<QObjectWrapper*>((*it).managed());
-        QObject *qobject = qobjectWrapper->object();
-        if (!qobject)
-            continue;
-        bool keepAlive = QQmlData::keepAliveDuringGarbageCollection(qobject);
-
-        if (!keepAlive) {
-            if (QObject *parent = qobject->parent()) {
-                while (parent->parent())
-                    parent = parent->parent();
-
-                keepAlive = QQmlData::keepAliveDuringGarbageCollection(parent);
-            }
-        }
-
-        if (keepAlive)
+        if (keepQObjectWrapperAlive(qobjectWrapper))
             qobjectWrapper->mark(engine);
 
         if (engine->jsStackTop >= engine->jsStackLimit)
@@ -418,6 +857,10 @@ void MemoryManager::sweep(bool lastSweep)
         (*it) = Primitive::undefinedValue();
     }
 
+    // Dictionary classes are owned by a single object, recycle the ones whose owner dies
+    // in this collection while the mark bits are still intact.
+    engine->classPool->sweepDictionaries();
+
     if (MultiplyWrappedQObjectMap *multiplyWrappedQObjects = engine->m_multiplyWrappedQObjects) {
         for (MultiplyWrappedQObjectMap::Iterator it = multiplyWrappedQObjects->begin(); it != multiplyWrappedQObjects->end();) {
             if (!it.value().isNullOrUndefined())
@@ -427,42 +870,27 @@ void MemoryManager::sweep(bool lastSweep)
         }
     }
 
-    bool *chunkIsEmpty = (bool *)alloca(m_d->heapChunks.size() * sizeof(bool));
-    uint itemsInUse[MemoryManager::Data::MaxItemSize/16];
-    memset(itemsInUse, 0, sizeof(itemsInUse));
+    // Queue all chunks for sweeping. Unless the caller finishes the sweep right away, they are
+    // swept on demand when allocating items of their size, or through continueSweep().
+    Q_ASSERT(!m_d->unsweptChunkCount);
+    m_d->sweptBytes = 0;
     memset(m_d->nonFullChunks, 0, sizeof(m_d->nonFullChunks));
-
-    for (int i = 0; i < m_d->heapChunks.size(); ++i) {
-        Data::ChunkHeader *header = reinterpret_cast<Data::ChunkHeader *>(m_d->heapChunks[i].base());
-        chunkIsEmpty[i] = sweepChunk(header, &itemsInUse[header->itemSize >> 4], engine, &m_d->unmanagedHeapSize);
-    }
-
-    QVector<PageAllocation>::iterator chunkIter = m_d->heapChunks.begin();
-    for (int i = 0; i < m_d->heapChunks.size(); ++i) {
-        Q_ASSERT(chunkIter != m_d->heapChunks.end());
-        Data::ChunkHeader *header = reinterpret_cast<Data::ChunkHeader *>(chunkIter->base());
+    memset(m_d->decommittedChunks, 0, sizeof(m_d->decommittedChunks));
+    memcpy(m_d->itemsInUseAtGC, m_d->itemsInUse, sizeof(m_d->itemsInUseAtGC));
+    for (QVector<PageAllocation>::const_iterator i = m_d->heapChunks.cbegin(), ei = m_d->heapChunks.cend(); i != ei; ++i) {
+        Data::ChunkHeader *header = reinterpret_cast<Data::ChunkHeader *>(i->base());
         const size_t pos = header->itemSize >> 4;
-        const size_t decrease = (header->itemEnd - header->itemStart) / header->itemSize;
-
-        // Release that chunk if it could have been spared since the last GC run without any difference.
-        if (chunkIsEmpty[i] && m_d->availableItems[pos] - decrease >= itemsInUse[pos]) {
-            Q_V4_PROFILE_DEALLOC(engine, 0, chunkIter->size(), Profiling::HeapPage);
-#ifdef V4_USE_VALGRIND
-            VALGRIND_MEMPOOL_FREE(this, header);
-#endif
-            --m_d->nChunks[pos];
-            m_d->availableItems[pos] -= uint(decrease);
-            m_d->totalItems -= int(decrease);
-            chunkIter->deallocate();
-            chunkIter = m_d->heapChunks.erase(chunkIter);
-            continue;
-        } else if (header->freeItems.nextFree()) {
-            header->nextNonFull = m_d->nonFullChunks[pos];
-            m_d->nonFullChunks[pos] = header;
-        }
-        ++chunkIter;
+        header->nextNonFull = m_d->unsweptChunks[pos];
+        m_d->unsweptChunks[pos] = header;
+        ++m_d->unsweptChunkCount;
     }
 
+    // Cached regions that weren't reused since the last sweep are released now, the ones
+    // freed below take their place.
+    m_d->largeItemsToFree += m_d->largeItemCache;
+    m_d->largeItemCache.clear();
+    m_d->largeItemCacheSize = 0;
+
     Data::LargeItem *i = m_d->largeItems;
     Data::LargeItem **last = &m_d->largeItems;
     while (i) {
@@ -478,21 +906,174 @@ void MemoryManager::sweep(bool lastSweep)
             m->vtable()->destroy(m);
 
         *last = i->next;
-        free(Q_V4_PROFILE_DEALLOC(engine, i, i->size + sizeof(Data::LargeItem),
-                                  Profiling::LargeItem));
+        Q_V4_PROFILE_DEALLOC(engine, i, i->size + Data::LargeItem::headerSize(), Profiling::LargeItem);
+        if (!lastSweep && m_d->largeItemCacheSize + i->allocationSize <= m_d->maxLargeItemCacheSize) {
+            m_d->largeItemCache.append(i);
+            m_d->largeItemCacheSize += i->allocationSize;
+        } else {
+            m_d->largeItemsToFree.append(i);
+        }
         i = *last;
     }
 
-    // some execution contexts are allocated on the stack, make sure we clear their markBit as well
-    if (!lastSweep) {
-        QV4::ExecutionContext *ctx = engine->currentContext;
-        while (ctx) {
-            ctx->d()->clearMarkBit();
-            ctx = engine->parentContext(ctx);
+    if (lastSweep)
+        finishSweep();
+}
+
+void MemoryManager::sweepNextChunk(uint pos)
+{
+    Data::ChunkHeader *header = m_d->unsweptChunks[pos];
+    Q_ASSERT(header);
+    m_d->unsweptChunks[pos] = header->nextNonFull;
+    --m_d->unsweptChunkCount;
+
+    QElapsedTimer t;
+    const bool timed = m_d->gcStats || m_d->hasPendingGCReport;
+    if (timed)
+        t.start();
+
+    const bool wasUsed = header->bumpPointer > header->itemStart;
+    uint itemsFreed = 0;
+    const bool isEmpty = sweepChunk(header, &itemsFreed, engine, &m_d->unmanagedHeapSize);
+    Q_ASSERT(m_d->itemsInUse[pos] >= itemsFreed);
+    m_d->itemsInUse[pos] -= itemsFreed;
+    m_d->sweptBytes += std::size_t(itemsFreed) * header->itemSize;
+    const size_t decrease = (header->itemEnd - header->itemStart) / header->itemSize;
+
+    // Release that chunk if it could have been spared since the last GC run without any difference,
+    // or if we are told to give every empty chunk back.
+    if (isEmpty && (m_d->availableItems[pos] - decrease >= m_d->itemsInUseAtGC[pos]
+                    || m_d->emptyChunkPolicy == Data::ReleaseEmptyChunks)) {
+        std::size_t decommittedSize = 0;
+        if (header->decommitted)
+            itemPages(header, &decommittedSize);
+        m_d->decommittedSize -= decommittedSize;
+
+        const int chunkIndex = header->chunkIndex;
+        const PageAllocation chunk = m_d->heapChunks.at(chunkIndex);
+        Q_ASSERT(chunk.base() == header);
+        Q_V4_PROFILE_DEALLOC(engine, 0, chunk.size() - decommittedSize, Profiling::HeapPage);
+#ifdef V4_USE_VALGRIND
+        VALGRIND_MEMPOOL_FREE(this, header);
+#endif
+        --m_d->nChunks[pos];
+        m_d->availableItems[pos] -= uint(decrease);
+        m_d->totalItems -= int(decrease);
+        m_d->chunksToRelease.append(chunk);
+
+        // The order of the chunks doesn't matter, move the last one into the gap.
+        const PageAllocation last = m_d->heapChunks.takeLast();
+        if (last.base() != chunk.base()) {
+            m_d->heapChunks[chunkIndex] = last;
+            reinterpret_cast<Data::ChunkHeader *>(last.base())->chunkIndex = chunkIndex;
+        }
+    } else if (header->decommitted || (isEmpty && wasUsed && m_d->emptyChunkPolicy == Data::DecommitEmptyChunks)) {
+        // keep the address space around, but give the physical memory back
+        if (!header->decommitted) {
+            std::size_t pagesSize;
+            char *pages = itemPages(header, &pagesSize);
+            if (pagesSize) {
+                OSAllocator::decommit(pages, pagesSize);
+                Q_V4_PROFILE_DEALLOC(engine, 0, pagesSize, Profiling::HeapPage);
+                header->decommitted = true;
+                m_d->decommittedSize += pagesSize;
+            }
+        }
+        if (header->decommitted) {
+            header->nextNonFull = m_d->decommittedChunks[pos];
+            m_d->decommittedChunks[pos] = header;
+        } else {
+            header->nextNonFull = m_d->nonFullChunks[pos];
+            m_d->nonFullChunks[pos] = header;
+        }
+    } else if (header->freeItems.nextFree() || header->bumpPointer <= header->itemEnd) {
+        header->nextNonFull = m_d->nonFullChunks[pos];
+        m_d->nonFullChunks[pos] = header;
+    }
+
+    // Objects can't be moved, but filling the fullest chunks first lets the sparse ones of a
+    // fragmented size run empty, so that they can be released by one of the next sweeps.
+    if (!m_d->unsweptChunks[pos] && m_d->compactionThreshold
+            && quint64(m_d->itemsInUse[pos]) * 100 < quint64(m_d->availableItems[pos]) * m_d->compactionThreshold) {
+        QVarLengthArray<Data::ChunkHeader *, 64> chunks;
+        for (Data::ChunkHeader *c = m_d->nonFullChunks[pos]; c; c = c->nextNonFull)
+            chunks.append(c);
+        std::stable_sort(chunks.begin(), chunks.end(), hasMoreLiveItems);
+        Data::ChunkHeader **next = &m_d->nonFullChunks[pos];
+        for (int i = 0; i < chunks.size(); ++i) {
+            *next = chunks.at(i);
+            next = &chunks.at(i)->nextNonFull;
+        }
+        *next = 0;
+    }
+
+    if (timed) {
+        const qint64 elapsed = t.nsecsElapsed();
+        ++m_d->lazilySweptChunks;
+        m_d->lazySweepTime += elapsed;
+        if (m_d->hasPendingGCReport) {
+            m_d->pendingGCReport.sweepTime += elapsed;
+            if (!m_d->unsweptChunkCount)
+                reportGarbageCollection();
         }
     }
 }
 
+void MemoryManager::reportGarbageCollection()
+{
+    Profiling::GarbageCollectionProperties &gc = m_d->pendingGCReport;
+    m_d->hasPendingGCReport = false;
+    gc.bytesFreed += m_d->sweptBytes;
+    gc.unmanagedHeapSize = m_d->unmanagedHeapSize;
+    gc.itemsInUse.resize(Data::MaxItemSize/16);
+    gc.availableItems.resize(Data::MaxItemSize/16);
+    for (int i = 0; i < Data::MaxItemSize/16; ++i) {
+        gc.itemsInUse[i] = m_d->itemsInUse[i];
+        gc.availableItems[i] = m_d->availableItems[i];
+    }
+
+    // The profiler might have been replaced while the sweep was pending.
+    if (m_d->pendingGCProfiler && m_d->pendingGCProfiler == engine->profiler)
+        m_d->pendingGCProfiler->trackGarbageCollection(gc, m_d->gcTimer.nsecsElapsed());
+    m_d->pendingGCProfiler = 0;
+
+    if (m_d->gcCallback) {
+        gc.timestamp = m_d->gcTimer.msecsSinceReference() * 1000000;
+        m_d->gcCallback(gc, m_d->gcCallbackData);
+    }
+}
+
+void MemoryManager::setGarbageCollectionCallback(GarbageCollectionCallback callback, void *data)
+{
+    m_d->gcCallback = callback;
+    m_d->gcCallbackData = data;
+}
+
+void MemoryManager::releaseMemory(bool inBackground)
+{
+    if (m_d->chunksToRelease.isEmpty() && m_d->largeItemsToFree.isEmpty())
+        return;
+
+    ReleaseMemoryJob *job = new ReleaseMemoryJob(m_d->chunksToRelease, m_d->largeItemsToFree);
+    m_d->chunksToRelease.clear();
+    m_d->largeItemsToFree.clear();
+    if (inBackground) {
+        QThreadPool::globalInstance()->start(job);
+    } else {
+        job->run();
+        delete job;
+    }
+}
+
+void MemoryManager::finishSweep()
+{
+    for (uint pos = 0; pos < MemoryManager::Data::MaxItemSize/16; ++pos) {
+        while (m_d->unsweptChunks[pos])
+            sweepNextChunk(pos);
+    }
+    Q_ASSERT(!m_d->unsweptChunkCount);
+}
+
 bool MemoryManager::isGCBlocked() const
 {
     return m_d->gcBlocked;
@@ -503,49 +1084,184 @@ void MemoryManager::setGCBlocked(bool blockGC)
     m_d->gcBlocked = blockGC;
 }
 
+bool MemoryManager::hasPendingSweep() const
+{
+    return m_d->unsweptChunkCount > 0;
+}
+
+void MemoryManager::continueSweep(int budgetMsecs)
+{
+    if (!hasPendingSweep())
+        return;
+
+    const size_t usedBefore = m_d->gcStats ? getUsedMem() : 0;
+    const int chunksBefore = m_d->unsweptChunkCount;
+    const int lazilySweptChunksBefore = m_d->lazilySweptChunks;
+    const qint64 lazySweepTimeBefore = m_d->lazySweepTime;
+
+    QElapsedTimer t;
+    t.start();
+
+    // Sweep round-robin over the size classes, so that all of them get some free items back
+    // even if the budget doesn't allow to sweep everything.
+    while (hasPendingSweep() && t.elapsed() < budgetMsecs) {
+        for (uint pos = 0; pos < MemoryManager::Data::MaxItemSize/16; ++pos) {
+            if (m_d->unsweptChunks[pos])
+                sweepNextChunk(pos);
+        }
+    }
+
+    if (m_d->gcStats) {
+        const qint64 sweepTime = t.nsecsElapsed();
+        const size_t usedAfter = getUsedMem();
+        // only count the chunks swept on allocation in the next GC's report
+        m_d->lazilySweptChunks = lazilySweptChunksBefore;
+        m_d->lazySweepTime = lazySweepTimeBefore;
+
+        qDebug() << "========== GC slice ==========";
+        qDebug() << "Sweeped" << (chunksBefore - m_d->unsweptChunkCount) << "chunks in" << sweepTime / 1000 << "us," << m_d->unsweptChunkCount << "chunks left to sweep.";
+        qDebug() << "Freed up bytes:" << (usedBefore - usedAfter);
+        qDebug() << "======== End GC slice ========";
+    }
+
+    releaseMemory(/*inBackground*/true);
+}
+
+bool MemoryManager::isGCDeferred() const
+{
+    return m_d->gcDeferred;
+}
+
+void MemoryManager::setGCDeferred(bool deferGC)
+{
+    m_d->gcDeferred = deferGC;
+}
+
+bool MemoryManager::collectInIdleTime(int budgetMsecs)
+{
+    if (m_d->gcBlocked || budgetMsecs <= 0)
+        return false;
+
+    if (hasPendingSweep()) {
+        continueSweep(budgetMsecs);
+        return true;
+    }
+
+    // Marking can't be split up. Only start a collection if one of the allocation triggered
+    // ones would be halfway due anyway, so that the idle time isn't spent on a heap that has
+    // hardly changed.
+    if (m_d->totalAlloc > (m_d->totalItems >> 2)
+            || m_d->totalLargeItemsAllocated > 4 * 1024 * 1024
+            || m_d->unmanagedHeapSize > (m_d->unmanagedHeapSizeGCLimit >> 1)) {
+        collectGarbage(m_d->incrementalSweep);
+        return true;
+    }
+    return false;
+}
+
 void MemoryManager::runGC()
+{
+    collectGarbage(/*incrementalSweep*/false);
+}
+
+void MemoryManager::collectGarbage(bool incrementalSweep)
 {
     if (m_d->gcBlocked) {
 //        qDebug() << "Not running GC.";
         return;
     }
 
-    if (!m_d->gcStats) {
+    Profiling::Profiler *profiler = m_d->engine->profiler;
+    if (profiler && !(profiler->featuresEnabled & (1 << Profiling::FeatureMemoryAllocation)))
+        profiler = 0;
+
+    if (!m_d->gcStats && !profiler && !m_d->gcCallback) {
+        finishSweep();
         mark();
         sweep();
+        if (!incrementalSweep)
+            finishSweep();
     } else {
-        const size_t totalMem = getAllocatedMem();
+        if (m_d->gcStats && m_d->lazilySweptChunks) {
+            qDebug() << "Sweeped" << m_d->lazilySweptChunks << "chunks lazily on allocation in"
+                     << m_d->lazySweepTime / 1000 << "us since the last GC.";
+        }
 
-        QTime t;
+        QElapsedTimer t;
         t.start();
+        const int pendingChunks = m_d->unsweptChunkCount;
+        finishSweep();
+        const qint64 pendingSweepTime = t.nsecsElapsed();
+        Q_ASSERT(!m_d->hasPendingGCReport);
+        m_d->gcTimer.start();
+
+        const size_t totalMem = getAllocatedMem();
+
+        t.restart();
         mark();
-        int markTime = t.elapsed();
+        const qint64 markTime = t.nsecsElapsed();
         t.restart();
         const size_t usedBefore = getUsedMem();
         const size_t largeItemsBefore = getLargeItemsMem();
         int chunksBefore = m_d->heapChunks.size();
         sweep();
-        const size_t usedAfter = getUsedMem();
         const size_t largeItemsAfter = getLargeItemsMem();
-        int sweepTime = t.elapsed();
-
-        qDebug() << "========== GC ==========";
-        qDebug() << "Marked object in" << markTime << "ms.";
-        qDebug() << "Sweeped object in" << sweepTime << "ms.";
-        qDebug() << "Allocated" << totalMem << "bytes in" << m_d->heapChunks.size() << "chunks.";
-        qDebug() << "Used memory before GC:" << usedBefore;
-        qDebug() << "Used memory after GC:" << usedAfter;
-        qDebug() << "Freed up bytes:" << (usedBefore - usedAfter);
-        qDebug() << "Released chunks:" << (chunksBefore - m_d->heapChunks.size());
-        qDebug() << "Large item memory before GC:" << largeItemsBefore;
-        qDebug() << "Large item memory after GC:" << largeItemsAfter;
-        qDebug() << "Large item memory freed up:" << (largeItemsBefore - largeItemsAfter);
-        qDebug() << "======== End GC ========";
+        if (profiler || m_d->gcCallback) {
+            // The chunks add their sweep time and freed items as they get swept, now or lazily.
+            Profiling::GarbageCollectionProperties &gc = m_d->pendingGCReport;
+            gc.timestamp = 0;
+            gc.markTime = markTime;
+            gc.sweepTime = t.nsecsElapsed();
+            gc.bytesFreed = largeItemsBefore - largeItemsAfter;
+            m_d->pendingGCProfiler = profiler;
+            m_d->hasPendingGCReport = true;
+            if (!hasPendingSweep())
+                reportGarbageCollection();
+        }
+        if (!incrementalSweep)
+            finishSweep();
+        const size_t usedAfter = getUsedMem();
+        const qint64 sweepTime = t.nsecsElapsed();
+        const uint largeItemCacheHits = m_d->largeItemCacheHits;
+        const uint largeItemCacheMisses = m_d->largeItemCacheMisses;
+        m_d->largeItemCacheHits = 0;
+        m_d->largeItemCacheMisses = 0;
+        m_d->lazilySweptChunks = 0;
+        m_d->lazySweepTime = 0;
+
+        if (m_d->gcStats) {
+            qDebug() << "========== GC ==========";
+            if (pendingChunks)
+                qDebug() << "Finished sweeping" << pendingChunks << "chunks of the last GC in" << pendingSweepTime / 1000 << "us.";
+            qDebug() << "Marked object in" << markTime / 1000000 << "ms.";
+            qDebug() << "Sweeped object in" << sweepTime / 1000000 << "ms.";
+            if (incrementalSweep)
+                qDebug() << "Left" << m_d->unsweptChunkCount << "chunks for incremental sweeping.";
+            qDebug() << "Allocated" << totalMem << "bytes in" << m_d->heapChunks.size() << "chunks.";
+            qDebug() << "Used memory before GC:" << usedBefore;
+            qDebug() << "Used memory after GC:" << usedAfter;
+            qDebug() << "Freed up bytes:" << (usedBefore - usedAfter);
+            qDebug() << "Released chunks:" << (chunksBefore - m_d->heapChunks.size());
+            qDebug() << "Decommitted memory in empty chunks:" << m_d->decommittedSize;
+            qDebug() << "Large item memory before GC:" << largeItemsBefore;
+            qDebug() << "Large item memory after GC:" << largeItemsAfter;
+            qDebug() << "Large item memory freed up:" << (largeItemsBefore - largeItemsAfter);
+            qDebug() << "Large items allocated since the last GC:" << (largeItemCacheHits + largeItemCacheMisses)
+                     << "of which" << largeItemCacheHits << "reused cached pages.";
+            qDebug() << "Large item pages kept for reuse:" << m_d->largeItemCacheSize << "bytes in"
+                     << m_d->largeItemCache.size() << "regions.";
+            dumpLargeItemStats();
+            qDebug() << "======== End GC ========";
+        }
     }
 
     memset(m_d->allocCount, 0, sizeof(m_d->allocCount));
     m_d->totalAlloc = 0;
     m_d->totalLargeItemsAllocated = 0;
+
+    m_d->engine->dropColdTierUpCode();
+
+    releaseMemory(/*inBackground*/true);
 }
 
 size_t MemoryManager::getUsedMem() const
@@ -553,12 +1269,8 @@ size_t MemoryManager::getUsedMem() const
     size_t usedMem = 0;
     for (QVector<PageAllocation>::const_iterator i = m_d->heapChunks.cbegin(), ei = m_d->heapChunks.cend(); i != ei; ++i) {
         Data::ChunkHeader *header = reinterpret_cast<Data::ChunkHeader *>(i->base());
-        for (char *item = header->itemStart; item <= header->itemEnd; item += header->itemSize) {
-            Heap::Base *m = reinterpret_cast<Heap::Base *>(item);
-            Q_ASSERT((qintptr) item % 16 == 0);
-            if (m->inUse())
-                usedMem += header->itemSize;
-        }
+        for (size_t word = 0, nWords = header->bitmapWords(); word < nWords; ++word)
+            usedMem += qPopulationCount(header->objectBitmap[word]) * header->itemSize;
     }
     return usedMem;
 }
@@ -571,6 +1283,28 @@ size_t MemoryManager::getAllocatedMem() const
     return total;
 }
 
+void MemoryManager::dumpLargeItemStats() const
+{
+    // live large items by type, biggest consumers first
+    QHash<const char *, QPair<uint, size_t> > byType;
+    for (Data::LargeItem *i = m_d->largeItems; i != 0; i = i->next) {
+        QPair<uint, size_t> &entry = byType[i->heapObject()->vtable()->className];
+        ++entry.first;
+        entry.second += i->size;
+    }
+
+    QVector<QPair<size_t, const char *> > sorted;
+    sorted.reserve(byType.size());
+    for (QHash<const char *, QPair<uint, size_t> >::const_iterator it = byType.cbegin(), end = byType.cend(); it != end; ++it)
+        sorted.append(qMakePair(it.value().second, it.key()));
+    std::sort(sorted.begin(), sorted.end());
+
+    for (int i = sorted.size() - 1; i >= 0; --i) {
+        qDebug() << "    " << sorted.at(i).second << ":" << byType.value(sorted.at(i).second).first
+                 << "large items," << sorted.at(i).first << "bytes";
+    }
+}
+
 size_t MemoryManager::getLargeItemsMem() const
 {
     size_t total = 0;
@@ -588,7 +1322,11 @@ MemoryManager::~MemoryManager()
 {
     delete m_persistentValues;
 
+    // nobody is listening anymore
+    m_d->hasPendingGCReport = false;
+    finishSweep();
     sweep(/*lastSweep*/true);
+    releaseMemory(/*inBackground*/false);
 
     delete m_weakValues;
 #ifdef V4_USE_VALGRIND
@@ -612,6 +1350,111 @@ void MemoryManager::dumpStats() const
 #endif // DETAILED_MM_STATS
 }
 
+bool MemoryManager::dumpHeapSnapshot(QIODevice *device)
+{
+    // Edges are found by letting each object mark its children and then taking them off the mark
+    // stack again. That needs a completely swept heap without any mark bits set.
+    if (!m_d->gcBlocked)
+        collectGarbage(/*incrementalSweep*/false);
+    else
+        finishSweep();
+    for (QV4::ExecutionContext *ctx = engine->currentContext; ctx; ctx = engine->parentContext(ctx))
+        ctx->d()->clearMarkBit();
+
+    HeapSnapshot snapshot;
+    const int root = snapshot.addSyntheticNode("");
+    const int engineRoots = snapshot.addSyntheticNode("(Engine roots)");
+    const int stackRoots = snapshot.addSyntheticNode("(JS stack)");
+    const int persistentRoots = snapshot.addSyntheticNode("(Persistent values)");
+    const int qobjectRoots = snapshot.addSyntheticNode("(QObject wrappers)");
+    const int firstHeapNode = snapshot.nodeCount();
+
+    // If the GC is blocked, this includes the garbage since the last collection.
+    for (QVector<PageAllocation>::const_iterator i = m_d->heapChunks.cbegin(), ei = m_d->heapChunks.cend(); i != ei; ++i) {
+        Data::ChunkHeader *header = reinterpret_cast<Data::ChunkHeader *>(i->base());
+        for (size_t word = 0, nWords = header->bitmapWords(); word < nWords; ++word) {
+            quint64 allocated = header->objectBitmap[word];
+            while (allocated) {
+                const uint bit = qCountTrailingZeroBits(allocated);
+                allocated &= allocated - 1;
+                Heap::Base *m = reinterpret_cast<Heap::Base *>(header->itemStart + ((word * 64 + bit) << 4));
+                quint64 size = header->itemSize;
+                if (m->vtable()->isString)
+                    size += static_cast<Heap::String *>(m)->retainedTextSize();
+                snapshot.addNode(m, size);
+            }
+        }
+    }
+    for (Data::LargeItem *i = m_d->largeItems; i; i = i->next)
+        snapshot.addNode(i->heapObject(), i->size);
+    const int lastHeapNode = snapshot.nodeCount();
+
+    Value *markBase = engine->jsStackTop;
+
+    snapshot.beginEdges(root);
+    snapshot.addEdge(engineRoots);
+    snapshot.addEdge(stackRoots);
+    snapshot.addEdge(persistentRoots);
+    snapshot.addEdge(qobjectRoots);
+
+    snapshot.beginEdges(engineRoots);
+    engine->markObjects();
+    while (engine->jsStackTop > markBase) {
+        Heap::Base *h = engine->popForGC();
+        h->clearMarkBit();
+        snapshot.addEdge(snapshot.nodeFor(h));
+    }
+    // the identifier table marks its strings without pushing them
+    for (int i = firstHeapNode; i < lastHeapNode; ++i) {
+        Heap::Base *h = snapshot.object(i);
+        if (h->isMarked()) {
+            h->clearMarkBit();
+            snapshot.addEdge(i);
+        }
+    }
+
+    snapshot.beginEdges(stackRoots);
+    for (Value *v = engine->jsStackBase; v < markBase; ++v) {
+        Managed *m = v->as<Managed>();
+        if (m && m->inUse() && !m->markBit()) {
+            m->d()->setMarkBit();
+            snapshot.addEdge(snapshot.nodeFor(m->d()));
+        }
+    }
+    for (Value *v = engine->jsStackBase; v < markBase; ++v) {
+        Managed *m = v->as<Managed>();
+        if (m && m->inUse())
+            m->d()->clearMarkBit();
+    }
+
+    snapshot.beginEdges(persistentRoots);
+    for (PersistentValueStorage::Iterator it = m_persistentValues->begin(); it != m_persistentValues->end(); ++it) {
+        if (Managed *m = (*it).as<Managed>())
+            snapshot.addEdge(snapshot.nodeFor(m->d()));
+    }
+
+    snapshot.beginEdges(qobjectRoots);
+    for (PersistentValueStorage::Iterator it = m_weakValues->begin(); it != m_weakValues->end(); ++it) {
+        QObjectWrapper *qobjectWrapper = (*it).as<QObjectWrapper>();
+        if (qobjectWrapper && keepQObjectWrapperAlive(qobjectWrapper))
+            snapshot.addEdge(snapshot.nodeFor(qobjectWrapper->d()));
+    }
+
+    // nodeCount() grows while we go, when objects outside of the heap are found
+    for (int i = firstHeapNode; i < snapshot.nodeCount(); ++i) {
+        Heap::Base *h = snapshot.object(i);
+        snapshot.beginEdges(i);
+        h->vtable()->markObjects(h, engine);
+        while (engine->jsStackTop > markBase) {
+            Heap::Base *child = engine->popForGC();
+            child->clearMarkBit();
+            snapshot.addEdge(snapshot.nodeFor(child));
+        }
+    }
+
+    return snapshot.write(device);
+}
+
 #ifdef DETAILED_MM_STATS
 void MemoryManager::willAllocate(std::size_t size)
 {
@@ -54,8 +54,14 @@
 
 QT_BEGIN_NAMESPACE
 
+class QIODevice;
+
 namespace QV4 {
 
+namespace Profiling {
+struct GarbageCollectionProperties;
+}
+
 struct GCDeletable;
 
 class Q_QML_EXPORT MemoryManager
@@ -104,12 +110,15 @@ public:
     }
 
     template <typename ObjectType>
-    typename ObjectType::Data *allocateObject(InternalClass *ic)
+    typename ObjectType::Data *allocateObject(InternalClass *ic, uint inlineSize = 0)
     {
+        // room for more members than the class has right now lets the object grow
+        // without needing a separate MemberData
+        inlineSize = qMax(inlineSize, ic->size);
         const int size = (sizeof(typename ObjectType::Data) + (sizeof(Value) - 1)) & ~(sizeof(Value) - 1);
-        typename ObjectType::Data *o = allocManaged<ObjectType>(size + ic->size*sizeof(Value));
+        typename ObjectType::Data *o = allocManaged<ObjectType>(size + inlineSize*sizeof(Value));
         o->internalClass = ic;
-        o->inlineMemberSize = ic->size;
+        o->inlineMemberSize = inlineSize;
         o->inlineMemberOffset = size/sizeof(Value);
         return o;
     }
@@ -156,6 +165,16 @@ public:
         return t->d();
     }
 
+    template <typename ObjectType>
+    typename ObjectType::Data *allocObjectWithInlineSize(InternalClass *ic, Object *prototype, uint inlineSize)
+    {
+        Scope scope(engine);
+        Scoped<ObjectType> t(scope, allocateObject<ObjectType>(ic, inlineSize));
+        t->d()->prototype = prototype->d();
+        (void)new (t->d()) typename ObjectType::Data();
+        return t->d();
+    }
+
     template <typename ObjectType, typename Arg1>
     typename ObjectType::Data *allocObject(InternalClass *ic, Object *prototype, Arg1 arg1)
     {
@@ -300,7 +319,22 @@ public:
     void setGCBlocked(bool blockGC);
     void runGC();
 
+    bool hasPendingSweep() const;
+    void continueSweep(int budgetMsecs);
+
+    // For hosts that know when they are idle, like the Quick render loop between two frames.
+    bool isGCDeferred() const;
+    void setGCDeferred(bool deferGC);
+    bool collectInIdleTime(int budgetMsecs);
+
+    // Called with the statistics of every collection once all of its garbage is swept. The
+    // timestamp is the start of the collection, QElapsedTimer::msecsSinceReference() in ns.
+    typedef void (*GarbageCollectionCallback)(const Profiling::GarbageCollectionProperties &properties, void *data);
+    void setGarbageCollectionCallback(GarbageCollectionCallback callback, void *data);
+
     void dumpStats() const;
+    // Runs a GC and writes the remaining object graph in the .heapsnapshot format of V8.
+    bool dumpHeapSnapshot(QIODevice *device);
 
     size_t getUsedMem() const;
     size_t getAllocatedMem() const;
@@ -318,9 +352,15 @@ protected:
 #endif // DETAILED_MM_STATS
 
 private:
+    void collectGarbage(bool incrementalSweep);
     void collectFromJSStack() const;
     void mark();
     void sweep(bool lastSweep = false);
+    void sweepNextChunk(uint pos);
+    void finishSweep();
+    void reportGarbageCollection();
+    void releaseMemory(bool inBackground);
+    void dumpLargeItemStats() const;
 
 public:
     QV4::ExecutionEngine *engine;
@@ -18,6 +18,7 @@ SOURCES += \
     $$PWD/qqmlstringconverters.cpp \
     $$PWD/qqmlparserstatus.cpp \
     $$PWD/qqmltypeloader.cpp \
+    $$PWD/qqmldiskcache.cpp \
     $$PWD/qqmlinfo.cpp \
     $$PWD/qqmlerror.cpp \
     $$PWD/qqmlvaluetype.cpp \
@@ -83,6 +84,7 @@ HEADERS += \
     $$PWD/qqmlproperty_p.h \
     $$PWD/qqmlcontext_p.h \
     $$PWD/qqmltypeloader_p.h \
+    $$PWD/qqmldiskcache_p.h \
     $$PWD/qqmllist.h \
     $$PWD/qqmllist_p.h \
     $$PWD/qqmldata_p.h \
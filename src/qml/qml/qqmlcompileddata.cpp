@@ -45,6 +45,7 @@
 #include <QtCore/qdebug.h>
 
 #include <private/qobject_p.h>
+#include <private/qv4isel_p.h>
 
 QT_BEGIN_NAMESPACE
 
@@ -70,6 +71,29 @@ QQmlCompiledData::~QQmlCompiledData()
 
     clear();
 
+    // The IR of the functions that are left to be compiled points into the property caches
+    // released below. If the functions can still be called, the compilation unit keeps them
+    // instead of compiling everything now.
+    if (compilationUnit->lazyCompiler) {
+        if (compilationUnit->count() > 1) {
+            QVector<QQmlRefPointer<QQmlRefCount> > &dependencies = compilationUnit->lazyCompilerDependencies;
+            for (QHash<int, TypeReference*>::ConstIterator resolvedType = resolvedTypes.constBegin(), end = resolvedTypes.constEnd();
+                 resolvedType != end; ++resolvedType) {
+                if (QQmlPropertyCache *cache = (*resolvedType)->propertyCache())
+                    dependencies.append(cache);
+            }
+            for (int ii = 0; ii < propertyCaches.count(); ++ii)
+                if (propertyCaches.at(ii))
+                    dependencies.append(propertyCaches.at(ii));
+            if (rootPropertyCache)
+                dependencies.append(rootPropertyCache);
+            if (importCache)
+                dependencies.append(importCache);
+        } else {
+            compilationUnit->releaseLazyCompiler();
+        }
+    }
+
     for (QHash<int, TypeReference*>::Iterator resolvedType = resolvedTypes.begin(), end = resolvedTypes.end();
          resolvedType != end; ++resolvedType) {
         if ((*resolvedType)->component)
@@ -0,0 +1,281 @@
+/****************************************************************************
+**
+** Copyright (C) 2016 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtQml module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#include "qqmldiskcache_p.h"
+
+#include <private/qv4engine_p.h>
+#include <private/qv4isel_p.h>
+#include <private/qv4script_p.h>
+#include <private/qqmlirbuilder_p.h>
+#include <QtQml/qqmlfile.h>
+
+#include <QtCore/qbuffer.h>
+#include <QtCore/qcryptographichash.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qfileinfo.h>
+#include <QtCore/qlibraryinfo.h>
+#include <QtCore/qsavefile.h>
+#include <QtCore/qstandardpaths.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+const char cacheMagic[] = "qv4cache";
+
+// Increase when the layout of this header or of compiled units changes
+const quint32 CacheVersion = 1;
+
+struct CacheHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 unitOffset;
+    quint32 unitSize;
+    quint32 codeOffset;
+    quint32 codeSize;
+    char key[20];
+    // of everything following the header, so that damaged files are never executed
+    char checksum[20];
+};
+
+// Units and code start on 16 byte boundaries of the file
+inline quint32 align(quint32 offset)
+{
+    return (offset + 15) & ~15u;
+}
+
+bool writePadding(QIODevice *device, quint32 offset)
+{
+    const qint64 padding = offset - device->pos();
+    return padding >= 0 && device->write(QByteArray(padding, '\0')) == padding;
+}
+
+// "qrc:/a.js" and "qrc:///a.js" are the same file, and both forms are common
+QString normalizedUrl(const QUrl &url)
+{
+    const QString path = QQmlFile::urlToLocalFileOrQrc(url);
+    return path.isEmpty() ? url.toString() : path;
+}
+
+struct EmptyCompilationUnit : public QV4::CompiledData::CompilationUnit
+{
+    virtual void linkBackendToEngine(QV4::ExecutionEngine *) {}
+};
+
+QQmlRefPointer<QV4::CompiledData::CompilationUnit> loadFile(QV4::ExecutionEngine *engine, const QString &path, const QByteArray &key)
+{
+    QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit;
+
+    QScopedPointer<QFile> file(new QFile(path));
+    if (!file->open(QIODevice::ReadOnly))
+        return unit;
+
+    const qint64 size = file->size();
+    if (size < qint64(sizeof(CacheHeader)) || size > qint64(UINT_MAX))
+        return unit;
+
+    // The code is relocated in place, so files are mapped copy on write. Resources can't be
+    // mapped like that and are read instead.
+    QByteArray contents;
+    uchar *mapping = 0;
+    if (!path.startsWith(QLatin1Char(':')))
+        mapping = file->map(0, size, QFileDevice::MapPrivateOption);
+    if (!mapping) {
+        contents = file->readAll();
+        if (contents.size() != size)
+            return unit;
+        mapping = reinterpret_cast<uchar *>(contents.data());
+    }
+
+    const CacheHeader *header = reinterpret_cast<const CacheHeader *>(mapping);
+    if (memcmp(header->magic, cacheMagic, sizeof(header->magic)) || header->version != CacheVersion
+            || key.size() != sizeof(header->key) || memcmp(header->key, key.constData(), sizeof(header->key)))
+        return unit;
+    if (header->unitOffset % 16 || header->codeOffset % 16
+            || header->unitOffset < sizeof(CacheHeader)
+            || header->unitSize < sizeof(QV4::CompiledData::Unit)
+            || quint64(header->unitOffset) + header->unitSize > header->codeOffset
+            || quint64(header->codeOffset) + header->codeSize != quint64(size))
+        return unit;
+    const QByteArray checksum = QCryptographicHash::hash(QByteArray::fromRawData(reinterpret_cast<const char *>(mapping) + sizeof(CacheHeader), size - sizeof(CacheHeader)),
+                                                         QCryptographicHash::Sha1);
+    if (memcmp(header->checksum, checksum.constData(), sizeof(header->checksum)))
+        return unit;
+
+    QV4::CompiledData::Unit *data = reinterpret_cast<QV4::CompiledData::Unit *>(mapping + header->unitOffset);
+    if (memcmp(data->magic, QV4::CompiledData::magic_str, sizeof(data->magic)) || data->unitSize != header->unitSize)
+        return unit;
+
+    unit.adopt(engine->iselFactory->createUnitForLoading());
+    if (!unit)
+        return unit;
+    unit->data = data;
+    if (contents.isNull())
+        unit->backingFile.reset(file.take());
+    else
+        unit->backingData = contents;
+
+    QString errorString;
+    if (!unit->loadCodeFromDisk(mapping + header->codeOffset, header->codeSize, &errorString))
+        unit = QQmlRefPointer<QV4::CompiledData::CompilationUnit>();
+    return unit;
+}
+
+}
+
+QByteArray QQmlDiskCache::key(QV4::ExecutionEngine *engine, const QUrl &url, const QByteArray &source)
+{
+    // Hashing and looking up every script only pays off for applications that load many of
+    // them on an interpreter-only platform, so they have to ask for it.
+    static const bool enabled = !qgetenv("QML_ENABLE_DISK_CACHE").isEmpty();
+    // Debug builds of the code contain instructions for the debugger
+    if (!enabled || engine->debugger || !engine->iselFactory->canLoadUnits())
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QT_VERSION_STR, sizeof(QT_VERSION_STR) - 1);
+    hash.addData(QLibraryInfo::build(), qstrlen(QLibraryInfo::build()));
+    hash.addData(normalizedUrl(url).toUtf8());
+    hash.addData(source);
+    return hash.result();
+}
+
+QString QQmlDiskCache::cacheFilePath(const QUrl &url)
+{
+    QString directory = QFile::decodeName(qgetenv("QML_DISK_CACHE_PATH"));
+    if (directory.isEmpty()) {
+        directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+        if (directory.isEmpty())
+            return QString();
+        directory += QLatin1String("/qmlcache");
+    }
+    const QByteArray name = QCryptographicHash::hash(normalizedUrl(url).toUtf8(), QCryptographicHash::Sha1).toHex();
+    return directory + QLatin1Char('/') + QString::fromLatin1(name) + QLatin1String(".jsc");
+}
+
+QString QQmlDiskCache::precompiledFilePath(const QUrl &url)
+{
+    const QString path = QQmlFile::urlToLocalFileOrQrc(url);
+    return path.isEmpty() ? QString() : path + QLatin1Char('c');
+}
+
+QQmlRefPointer<QV4::CompiledData::CompilationUnit> QQmlDiskCache::load(QV4::ExecutionEngine *engine, const QUrl &url, const QByteArray &key)
+{
+    QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit;
+    const QString precompiled = precompiledFilePath(url);
+    if (!precompiled.isEmpty())
+        unit = loadFile(engine, precompiled, key);
+    const QString cached = cacheFilePath(url);
+    if (!unit && !cached.isEmpty())
+        unit = loadFile(engine, cached, key);
+    return unit;
+}
+
+void QQmlDiskCache::save(const QV4::CompiledData::CompilationUnit *unit, const QUrl &url, const QByteArray &key)
+{
+    const QString path = cacheFilePath(url);
+    QString errorString;
+    if (!path.isEmpty() && QDir().mkpath(QFileInfo(path).absolutePath()))
+        writeFile(unit, path, key, &errorString);
+}
+
+QQmlRefPointer<QV4::CompiledData::CompilationUnit> QQmlDiskCache::compileScript(QV4::ExecutionEngine *engine, const QUrl &url, const QString &source, QList<QQmlError> *errors)
+{
+    QmlIR::Document irUnit(engine->debugger != 0);
+    QmlIR::ScriptDirectivesCollector collector(&irUnit.jsParserEngine, &irUnit.jsGenerator);
+
+    QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit = QV4::Script::precompile(&irUnit.jsModule, &irUnit.jsGenerator, engine, url, source, errors, &collector);
+    // No need to addref on unit, it's initial refcount is 1
+    if (!errors->isEmpty())
+        return QQmlRefPointer<QV4::CompiledData::CompilationUnit>();
+    if (!unit) {
+        unit.adopt(new EmptyCompilationUnit);
+    }
+    irUnit.javaScriptCompilationUnit = unit;
+    irUnit.imports = collector.imports;
+    if (collector.hasPragmaLibrary)
+        irUnit.unitFlags |= QV4::CompiledData::Unit::IsSharedLibrary;
+
+    QmlIR::QmlUnitGenerator qmlGenerator;
+    QV4::CompiledData::Unit *unitData = qmlGenerator.generate(irUnit);
+    Q_ASSERT(!unit->data);
+    // The js unit owns the data and will free the qml unit.
+    unit->data = unitData;
+    return unit;
+}
+
+bool QQmlDiskCache::writeFile(const QV4::CompiledData::CompilationUnit *unit, const QString &path, const QByteArray &key, QString *errorString)
+{
+    if (key.size() != sizeof(CacheHeader().key)) {
+        *errorString = QStringLiteral("Invalid cache key");
+        return false;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, cacheMagic, sizeof(header.magic));
+    header.version = CacheVersion;
+    header.unitOffset = align(sizeof(CacheHeader));
+    header.unitSize = unit->data->unitSize;
+    header.codeOffset = align(header.unitOffset + header.unitSize);
+    memcpy(header.key, key.constData(), sizeof(header.key));
+
+    // The file is assembled in memory first, for the checksum over everything after the header
+    QBuffer payload;
+    payload.open(QIODevice::WriteOnly);
+    payload.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!writePadding(&payload, header.unitOffset)
+            || payload.write(reinterpret_cast<const char *>(unit->data), header.unitSize) != header.unitSize
+            || !writePadding(&payload, header.codeOffset)
+            || !unit->saveCodeToDisk(&payload, errorString))
+        return false;
+
+    QByteArray contents = payload.buffer();
+    CacheHeader *completeHeader = reinterpret_cast<CacheHeader *>(contents.data());
+    completeHeader->codeSize = contents.size() - header.codeOffset;
+    const QByteArray checksum = QCryptographicHash::hash(QByteArray::fromRawData(contents.constData() + sizeof(CacheHeader), contents.size() - sizeof(CacheHeader)),
+                                                         QCryptographicHash::Sha1);
+    memcpy(completeHeader->checksum, checksum.constData(), sizeof(completeHeader->checksum));
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(contents) != contents.size() || !file.commit()) {
+        *errorString = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,89 @@
+/****************************************************************************
+**
+** Copyright (C) 2016 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the QtQml module of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+
+#ifndef QQMLDISKCACHE_P_H
+#define QQMLDISKCACHE_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include <QtCore/qbytearray.h>
+#include <QtCore/qlist.h>
+#include <QtCore/qurl.h>
+#include <QtQml/qqmlerror.h>
+
+#include <private/qtqmlglobal_p.h>
+#include <private/qqmlrefcount_p.h>
+#include <private/qv4compileddata_p.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace QV4 {
+class ExecutionEngine;
+}
+
+// Stores compiled JavaScript files, including the interpreter code, in the cache directory and
+// maps them back in on later loads. Files precompiled by qmlcachegen are picked up from next to
+// the source, for example from resources. Entries are keyed by the Qt build, the URL and the
+// source, so changed sources are recompiled. QML documents aren't cached, and JIT engines don't
+// use the cache, since only the interpreter's code can be stored. QML_ENABLE_DISK_CACHE turns
+// the cache on.
+class Q_QML_PRIVATE_EXPORT QQmlDiskCache
+{
+public:
+    // Returns an empty key if the cache can't be used for this engine
+    static QByteArray key(QV4::ExecutionEngine *engine, const QUrl &url, const QByteArray &source);
+
+    static QQmlRefPointer<QV4::CompiledData::CompilationUnit> load(QV4::ExecutionEngine *engine, const QUrl &url, const QByteArray &key);
+    static void save(const QV4::CompiledData::CompilationUnit *unit, const QUrl &url, const QByteArray &key);
+
+    // Compiles a JavaScript file the way the type loader does
+    static QQmlRefPointer<QV4::CompiledData::CompilationUnit> compileScript(QV4::ExecutionEngine *engine, const QUrl &url, const QString &source, QList<QQmlError> *errors);
+    static bool writeFile(const QV4::CompiledData::CompilationUnit *unit, const QString &path, const QByteArray &key, QString *errorString);
+
+    static QString cacheFilePath(const QUrl &url);
+    static QString precompiledFilePath(const QUrl &url);
+};
+
+QT_END_NAMESPACE
+
+#endif // QQMLDISKCACHE_P_H
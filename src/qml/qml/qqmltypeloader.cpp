@@ -44,6 +44,7 @@
 #include <private/qqmlprofiler_p.h>
 #include <private/qqmlmemoryprofiler_p.h>
 #include <private/qqmltypecompiler_p.h>
+#include <private/qqmldiskcache_p.h>
 
 #include <QtCore/qdir.h>
 #include <QtCore/qfile.h>
@@ -2264,6 +2265,10 @@ void QQmlTypeData::compile()
         setError(compiler.compilationErrors());
         m_compiledData->release();
         m_compiledData = 0;
+    } else if (m_compiledData->compilationUnit->lazyCompiler) {
+        // The unit keeps the document for as long as it keeps its lazy compiler
+        m_document->javaScriptCompilationUnit = QQmlRefPointer<QV4::CompiledData::CompilationUnit>();
+        m_compiledData->compilationUnit->lazyCompilerDocument.reset(m_document.take());
     }
 }
 
@@ -2590,40 +2595,28 @@ QQmlScriptData *QQmlScriptBlob::scriptData() const
     return m_scriptData;
 }
 
-struct EmptyCompilationUnit : public QV4::CompiledData::CompilationUnit
-{
-    virtual void linkBackendToEngine(QV4::ExecutionEngine *) {}
-};
-
 void QQmlScriptBlob::dataReceived(const Data &data)
 {
-    QString source = QString::fromUtf8(data.data(), data.size());
-
     QV4::ExecutionEngine *v4 = QV8Engine::getV4(m_typeLoader->engine());
-    QmlIR::Document irUnit(v4->debugger != 0);
-    QmlIR::ScriptDirectivesCollector collector(&irUnit.jsParserEngine, &irUnit.jsGenerator);
+
+    const QByteArray cacheKey = QQmlDiskCache::key(v4, finalUrl(), QByteArray::fromRawData(data.data(), data.size()));
+    if (!cacheKey.isEmpty()) {
+        QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit = QQmlDiskCache::load(v4, finalUrl(), cacheKey);
+        if (unit) {
+            initializeFromCompilationUnit(unit);
+            return;
+        }
+    }
 
     QList<QQmlError> errors;
-    QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit = QV4::Script::precompile(&irUnit.jsModule, &irUnit.jsGenerator, v4, finalUrl(), source, &errors, &collector);
-    // No need to addref on unit, it's initial refcount is 1
-    source.clear();
+    QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit = QQmlDiskCache::compileScript(v4, finalUrl(), QString::fromUtf8(data.data(), data.size()), &errors);
     if (!errors.isEmpty()) {
         setError(errors);
         return;
     }
-    if (!unit) {
-        unit.adopt(new EmptyCompilationUnit);
-    }
-    irUnit.javaScriptCompilationUnit = unit;
-    irUnit.imports = collector.imports;
-    if (collector.hasPragmaLibrary)
-        irUnit.unitFlags |= QV4::CompiledData::Unit::IsSharedLibrary;
 
-    QmlIR::QmlUnitGenerator qmlGenerator;
-    QV4::CompiledData::Unit *unitData = qmlGenerator.generate(irUnit);
-    Q_ASSERT(!unit->data);
-    // The js unit owns the data and will free the qml unit.
-    unit->data = unitData;
+    if (!cacheKey.isEmpty())
+        QQmlDiskCache::save(unit, finalUrl(), cacheKey);
 
     initializeFromCompilationUnit(unit);
 }
@@ -1468,9 +1468,28 @@ QV4::ReturnedValue QQmlXMLHttpRequest::jsonResponseBody(QV4::ExecutionEngine* en
         Scope scope(engine);
 
         QJsonParseError error;
-        const QString& jtext = responseBody();
-        JsonParser parser(scope.engine, jtext.constData(), jtext.length());
-        ScopedValue jsonObject(scope, parser.parse(&error));
+        ScopedValue jsonObject(scope);
+#ifndef QT_NO_TEXTCODEC
+        if (!m_textCodec)
+            m_textCodec = findTextCodec();
+        if (m_textCodec && m_textCodec->mibEnum() != 106) { // anything but UTF-8
+            const QString& jtext = responseBody();
+            JsonParser<QChar> parser(scope.engine, jtext.constData(), jtext.length());
+            jsonObject = parser.parse(&error);
+        } else
+#endif
+        {
+            // parse UTF-8 right from the received data, skipping a byte order mark
+            const QByteArray &body = rawResponseBody();
+            const uchar *data = reinterpret_cast<const uchar *>(body.constData());
+            int length = body.length();
+            if (length >= 3 && data[0] == 0xef && data[1] == 0xbb && data[2] == 0xbf) {
+                data += 3;
+                length -= 3;
+            }
+            JsonParser<uchar> parser(scope.engine, data, length);
+            jsonObject = parser.parse(&error);
+        }
         if (error.error != QJsonParseError::NoError)
             return engine->throwSyntaxError(QStringLiteral("JSON.parse: Parse error"));
 
@@ -1329,6 +1329,7 @@ QV4::Heap::ConsoleObject::ConsoleObject()
     o->defineDefaultProperty(QStringLiteral("count"), QV4::ConsoleObject::method_count);
     o->defineDefaultProperty(QStringLiteral("profile"), QV4::ConsoleObject::method_profile);
     o->defineDefaultProperty(QStringLiteral("profileEnd"), QV4::ConsoleObject::method_profileEnd);
+    o->defineDefaultProperty(QStringLiteral("takeHeapSnapshot"), QV4::ConsoleObject::method_takeHeapSnapshot);
     o->defineDefaultProperty(QStringLiteral("time"), QV4::ConsoleObject::method_time);
     o->defineDefaultProperty(QStringLiteral("timeEnd"), QV4::ConsoleObject::method_timeEnd);
     o->defineDefaultProperty(QStringLiteral("trace"), QV4::ConsoleObject::method_trace);
@@ -1486,6 +1487,38 @@ QV4::ReturnedValue ConsoleObject::method_profileEnd(CallContext *ctx)
     return QV4::Encode::undefined();
 }
 
+QV4::ReturnedValue ConsoleObject::method_takeHeapSnapshot(CallContext *ctx)
+{
+    QV4::ExecutionEngine *v4 = ctx->d()->engine;
+
+    // first argument: file to write to. Defaults to a time stamped file in the working directory.
+    QString fileName;
+    if (ctx->argc() > 0)
+        fileName = ctx->args()[0].toQStringNoThrow();
+    if (fileName.isEmpty()) {
+        fileName = QStringLiteral("Heap-%1.heapsnapshot")
+                .arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyyMMddThhmmss")));
+    }
+
+    QV4::StackFrame frame = v4->currentStackFrame();
+    const QByteArray baSource = frame.source.toUtf8();
+    const QByteArray baFunction = frame.function.toUtf8();
+    QMessageLogger logger(baSource.constData(), frame.line, baFunction.constData());
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        logger.warning("Cannot write heap snapshot to %s: %s", qPrintable(fileName),
+                       qPrintable(file.errorString()));
+    } else if (!v4->memoryManager->dumpHeapSnapshot(&file)) {
+        logger.warning("Writing heap snapshot to %s failed: %s", qPrintable(fileName),
+                       qPrintable(file.errorString()));
+    } else {
+        logger.debug("Heap snapshot written to %s.", qPrintable(fileName));
+    }
+
+    return QV4::Encode::undefined();
+}
+
 QV4::ReturnedValue ConsoleObject::method_time(CallContext *ctx)
 {
     if (ctx->argc() != 1)
@@ -132,6 +132,7 @@ struct ConsoleObject : Object
     static ReturnedValue method_info(CallContext *ctx);
     static ReturnedValue method_profile(CallContext *ctx);
     static ReturnedValue method_profileEnd(CallContext *ctx);
+    static ReturnedValue method_takeHeapSnapshot(CallContext *ctx);
     static ReturnedValue method_time(CallContext *ctx);
     static ReturnedValue method_timeEnd(CallContext *ctx);
     static ReturnedValue method_count(CallContext *ctx);
@@ -60,7 +60,10 @@
 #include <QtCore/qabstractanimation.h>
 #include <QtCore/QLibraryInfo>
 #include <QtCore/QRunnable>
+#include <QtCore/qelapsedtimer.h>
 #include <QtQml/qqmlincubator.h>
+#include <private/qv8engine_p.h>
+#include <private/qv4mm_p.h>
 
 #include <QtQuick/private/qquickpixmapcache_p.h>
 
@@ -98,8 +101,8 @@ class QQuickWindowIncubationController : public QObject, public QQmlIncubationCo
     Q_OBJECT
 
 public:
-    QQuickWindowIncubationController(QSGRenderLoop *loop)
-        : m_renderLoop(loop), m_timer(0)
+    QQuickWindowIncubationController(QSGRenderLoop *loop, QQuickWindow *window)
+        : m_renderLoop(loop), m_timer(0), m_timeUsed(0)
     {
         // Allow incubation for 1/3 of a frame.
         m_incubation_time = qMax(1, int(1000 / QGuiApplication::primaryScreen()->refreshRate()) / 3);
@@ -109,6 +112,9 @@ public:
             connect(animationDriver, SIGNAL(stopped()), this, SLOT(animationStopped()));
             connect(m_renderLoop, SIGNAL(timeToIncubate()), this, SLOT(incubate()));
         }
+
+        // Every render loop emits this after a frame, from the render thread in the threaded one
+        connect(window, SIGNAL(frameSwapped()), this, SLOT(collectGarbage()));
     }
 
 protected:
@@ -130,6 +136,8 @@ protected:
 public slots:
     void incubate() {
         if (incubatingObjectCount()) {
+            QElapsedTimer timer;
+            timer.start();
             if (m_renderLoop->interleaveIncubation()) {
                 incubateFor(m_incubation_time);
             } else {
@@ -137,11 +145,26 @@ public slots:
                 if (incubatingObjectCount())
                     incubateAgain();
             }
+            m_timeUsed += int(timer.elapsed());
         }
     }
 
     void animationStopped() { incubate(); }
 
+    // Give what incubation left of its time since the last frame to the garbage collector, right
+    // after a frame is out. While animations are interleaved with the frames, the collections
+    // triggered by allocations are put off so that they mostly happen here.
+    void collectGarbage() {
+        const int budget = m_incubation_time - m_timeUsed;
+        m_timeUsed = 0;
+        QQmlEngine *qmlEngine = engine();
+        if (!qmlEngine)
+            return;
+        QV4::MemoryManager *memoryManager = QV8Engine::getV4(qmlEngine)->memoryManager;
+        memoryManager->setGCDeferred(m_renderLoop->interleaveIncubation());
+        memoryManager->collectInIdleTime(budget);
+    }
+
 protected:
     void incubatingObjectCountChanged(int count) Q_DECL_OVERRIDE
     {
@@ -153,6 +176,8 @@ private:
     QSGRenderLoop *m_renderLoop;
     int m_incubation_time;
     int m_timer;
+    // Spent incubating since the last frame
+    int m_timeUsed;
 };
 
 #include "qquickwindow.moc"
@@ -3338,7 +3363,7 @@ QQmlIncubationController *QQuickWindow::incubationController() const
         return 0; // TODO: make sure that this is safe
 
     if (!d->incubationController)
-        d->incubationController = new QQuickWindowIncubationController(d->windowManager);
+        d->incubationController = new QQuickWindowIncubationController(d->windowManager, const_cast<QQuickWindow*>(this));
     return d->incubationController;
 }
 
@@ -0,0 +1,16 @@
+import QtQuick 2.0
+
+Item {
+    Timer {
+        running: true
+        interval: 1
+        onTriggered: {
+            var garbage = [];
+            for (var i = 0; i < 1000; ++i)
+                garbage.push({ index: i });
+            garbage = null;
+            gc();
+            Qt.quit();
+        }
+    }
+}
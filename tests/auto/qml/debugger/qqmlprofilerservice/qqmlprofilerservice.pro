@@ -22,4 +22,5 @@ OTHER_FILES += \
     data/TestImage_2x2.png \
     data/signalSourceLocation.qml \
     data/javascript.qml \
-    data/timer.qml
+    data/timer.qml \
+    data/gc.qml
@@ -56,7 +56,7 @@ struct QQmlProfilerData
     int column;         //used by RangeLocation
     int framerate;      //used by animation events
     int animationcount; //used by animation events
-    qint64 amount;      //used by heap events
+    qint64 amount;      //used by heap events, mark time of GC events
 
     QByteArray toByteArray() const;
 };
@@ -76,6 +76,7 @@ public:
         PixmapCacheEvent,
         SceneGraphFrame,
         MemoryAllocation,
+        GarbageCollection,
 
         MaximumMessage
     };
@@ -142,6 +143,7 @@ public:
     QVector<QQmlProfilerData> qmlMessages;
     QVector<QQmlProfilerData> javascriptMessages;
     QVector<QQmlProfilerData> jsHeapMessages;
+    QVector<QQmlProfilerData> gcMessages;
     QVector<QQmlProfilerData> asynchronousMessages;
     QVector<QQmlProfilerData> pixmapMessages;
 
@@ -215,6 +217,7 @@ private slots:
     void signalSourceLocation();
     void javascript();
     void flushInterval();
+    void garbageCollection();
 };
 
 #define VERIFY(type, position, expected, checks) QVERIFY(verify(type, position, expected, checks))
@@ -337,6 +340,22 @@ void QQmlProfilerClient::messageReceived(const QByteArray &message)
         stream >> data.amount;
         break;
     }
+    case QQmlProfilerClient::GarbageCollection: {
+        qint64 sweepTime;
+        qint64 bytesFreed;
+        qint64 unmanagedHeapSize;
+        QVector<quint32> itemsInUse;
+        QVector<quint32> availableItems;
+        stream >> data.amount >> sweepTime >> bytesFreed >> unmanagedHeapSize >> itemsInUse
+               >> availableItems;
+        QVERIFY(data.amount >= 0);
+        QVERIFY(sweepTime >= 0);
+        QVERIFY(unmanagedHeapSize >= 0);
+        QCOMPARE(itemsInUse.size(), availableItems.size());
+        for (int i = 0; i < itemsInUse.size(); ++i)
+            QVERIFY(itemsInUse[i] <= availableItems[i]);
+        break;
+    }
     default:
         QString failMsg = QString("Unknown message type:") + data.messageType;
         QFAIL(qPrintable(failMsg));
@@ -350,6 +369,8 @@ void QQmlProfilerClient::messageReceived(const QByteArray &message)
         asynchronousMessages.append(data);
     else if (data.messageType == QQmlProfilerClient::MemoryAllocation)
         jsHeapMessages.append(data);
+    else if (data.messageType == QQmlProfilerClient::GarbageCollection)
+        gcMessages.append(data);
     else if (data.detailType == QQmlProfilerClient::Javascript)
         javascriptMessages.append(data);
     else
@@ -768,6 +789,23 @@ void tst_QQmlProfilerService::flushInterval()
     checkJsHeap();
 }
 
+void tst_QQmlProfilerService::garbageCollection()
+{
+    connect(true, "gc.qml");
+
+    m_client->setTraceState(true);
+
+    checkTraceReceived();
+    checkJsHeap();
+    QVERIFY2(m_client->gcMessages.count() > 0, "no garbage collection messages received");
+
+    qint64 lastTimestamp = -1;
+    foreach (const QQmlProfilerData &message, m_client->gcMessages) {
+        QVERIFY(message.time >= lastTimestamp);
+        lastTimestamp = message.time;
+    }
+}
+
 QTEST_MAIN(tst_QQmlProfilerService)
 
 #include "tst_qqmlprofilerservice.moc"
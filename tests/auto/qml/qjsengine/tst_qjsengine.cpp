@@ -39,10 +39,22 @@
 #include <qgraphicsitem.h>
 #include <qstandarditemmodel.h>
 #include <QtCore/qnumeric.h>
+#include <QtCore/qjsonarray.h>
+#include <QtCore/qjsondocument.h>
+#include <QtCore/qjsonobject.h>
+#include <QtCore/qtemporarydir.h>
 #include <qqmlengine.h>
 #include <qqmlcomponent.h>
 #include <stdlib.h>
+#include <private/qjsvalue_p.h>
+#include <private/qqmlcompiler_p.h>
+#include <private/qqmlcomponent_p.h>
 #include <private/qv4alloca_p.h>
+#include <private/qv4functionobject_p.h>
+#include <private/qv4isel_p.h>
+#include <private/qv4mm_p.h>
+#include <private/qv4profiling_p.h>
+#include <private/qv8engine_p.h>
 
 #ifdef Q_CC_MSVC
 #define NO_INLINE __declspec(noinline)
@@ -137,14 +149,36 @@ private slots:
     void dateConversionJSQt();
     void dateConversionQtJS();
     void functionPrototypeExtensions();
+    void builtinFunctionLength_data();
+    void builtinFunctionLength();
     void threadedEngine();
 
     void functionDeclarationsInConditionals();
 
     void arrayPop_QTBUG_35979();
+    void arrayUnshiftAfterPop();
+    void denseArrayOperations();
 
     void regexpLastMatch();
     void indexedAccesses();
+    void megamorphicPropertyAccess();
+    void preallocatedInlineMembers();
+    void dictionaryModeObjects();
+    void dictionaryModeDeletes();
+    void dictionaryModeSealAndFreeze();
+    void enumerationCache();
+    void stableArraySort_data();
+    void stableArraySort();
+    void stableArraySortKeepsOrder();
+    void arraySortWithInconsistentComparator_data();
+    void arraySortWithInconsistentComparator();
+    void jsonRecords();
+    void stringBuilding_data();
+    void stringBuilding();
+    void longStringKeys();
+    void lazyFunctionCompilation();
+    void tieredCompilation();
+    void lazyCompilerRelease();
 
     void prototypeChainGc();
     void prototypeChainGc_QTBUG38299();
@@ -177,6 +211,11 @@ private slots:
     void tracing();
     void asserts();
     void exceptions();
+    void heapSnapshot();
+    void idleTimeGarbageCollection();
+    void garbageCollectionCallback();
+    void garbageCollectionStress_data();
+    void garbageCollectionStress();
 
     void installGarbageCollectionFunctions();
 
@@ -2941,6 +2980,47 @@ void tst_QJSEngine::functionPrototypeExtensions()
     QCOMPARE(props.property("length").toInt(), 0);
 }
 
+void tst_QJSEngine::builtinFunctionLength_data()
+{
+    QTest::addColumn<QString>("function");
+    QTest::addColumn<bool>("hasLength");
+    QTest::addColumn<int>("length");
+
+    QTest::newRow("Math.max") << "Math.max" << true << 2;
+    QTest::newRow("Array.prototype.push") << "Array.prototype.push" << true << 1;
+    QTest::newRow("String.prototype.slice") << "String.prototype.slice" << true << 2;
+    QTest::newRow("parseInt") << "parseInt" << true << 2;
+    QTest::newRow("Object.keys") << "Object.keys" << true << 1;
+    QTest::newRow("__proto__ getter") << "Object.getOwnPropertyDescriptor(Object.prototype, '__proto__').get" << false << 0;
+    QTest::newRow("__proto__ setter") << "Object.getOwnPropertyDescriptor(Object.prototype, '__proto__').set" << false << 0;
+    QTest::newRow("thrower") << "(function() { 'use strict'; return Object.getOwnPropertyDescriptor(arguments, 'callee').get; })()" << false << 0;
+}
+
+void tst_QJSEngine::builtinFunctionLength()
+{
+    QFETCH(QString, function);
+    QFETCH(bool, hasLength);
+    QFETCH(int, length);
+
+    // Accessors and the thrower have no length property of their own, other builtins have one
+    // that can't be changed
+    QJSEngine engine;
+    QJSValue f = engine.evaluate(function);
+    QVERIFY(f.isCallable());
+    QCOMPARE(engine.evaluate("(function(f) { return f.hasOwnProperty('length'); })").call(QJSValueList() << f).toBool(), hasLength);
+    QCOMPARE(engine.evaluate("(function(f) { return f.hasOwnProperty('name'); })").call(QJSValueList() << f).toBool(), true);
+    if (hasLength) {
+        // created with the pre-built shape, without any transitions for name and length
+        const QV4::Object *o = QJSValuePrivate::getValue(&f)->as<QV4::Object>();
+        QVERIFY(o);
+        QCOMPARE(o->internalClass(), QV8Engine::getV4(&engine)->simpleScriptFunctionClass);
+
+        QCOMPARE(f.property("length").toInt(), length);
+        f.setProperty("length", 42);
+        QCOMPARE(f.property("length").toInt(), length);
+    }
+}
+
 class ThreadedTestEngine : public QThread {
     Q_OBJECT;
 
@@ -2997,6 +3077,40 @@ void tst_QJSEngine::arrayPop_QTBUG_35979()
     QCOMPARE(result.toString(), QString("1,3"));
 }
 
+void tst_QJSEngine::arrayUnshiftAfterPop()
+{
+    QJSEngine eng;
+    // array literals are allocated with exactly their length, which is not a power of two
+    QJSValue result = eng.evaluate(""
+            "var x = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10]\n"
+            "x.pop()\n"
+            "x.unshift(0)\n"
+            "x.join()\n");
+    QCOMPARE(result.toString(), QString("0,1,2,3,4,5,6,7,8,9"));
+
+    result = eng.evaluate(""
+            "var y = [1, 2, 3, 4, 5, 6, 7]\n"
+            "y.pop()\n"
+            "y.pop()\n"
+            "y.unshift(-1, 0)\n"
+            "y.join()\n");
+    QCOMPARE(result.toString(), QString("-1,0,1,2,3,4,5"));
+}
+
+void tst_QJSEngine::denseArrayOperations()
+{
+    QJSEngine eng;
+    eng.evaluate("var y = [1, 2.5, -3, 2.5, , 1]");
+
+    // holes are skipped and there is no type conversion
+    QCOMPARE(eng.evaluate("y.lastIndexOf(2.5)").toInt(), 3);
+    QCOMPARE(eng.evaluate("y.lastIndexOf(1, 4)").toInt(), 0);
+    QCOMPARE(eng.evaluate("y.lastIndexOf(undefined)").toInt(), -1);
+    QCOMPARE(eng.evaluate("y.lastIndexOf('1')").toInt(), -1);
+
+    QCOMPARE(eng.evaluate("y.join(';')").toString(), QString("1;2.5;-3;2.5;;1"));
+}
+
 void tst_QJSEngine::regexpLastMatch()
 {
     QJSEngine eng;
@@ -3072,6 +3186,532 @@ void tst_QJSEngine::indexedAccesses()
     QVERIFY(v.isUndefined());
 }
 
+void tst_QJSEngine::megamorphicPropertyAccess()
+{
+    QJSEngine engine;
+    // getX(), setX() and setLength() see more shapes than their lookups can hold
+    engine.evaluate(""
+            "function getX(o) { return o.x; }\n"
+            "function setX(o, v) { o.x = v; }\n"
+            "function setLength(o, v) { o.length = v; }\n"
+            "var objects = [];\n"
+            "for (var i = 0; i < 8; ++i) {\n"
+            "    var o = {};\n"
+            "    o['p' + i] = i;\n"
+            "    o.x = i;\n"
+            "    o.length = i;\n"
+            "    objects.push(o);\n"
+            "}\n"
+            "for (var round = 0; round < 3; ++round) {\n"
+            "    for (var i = 0; i < objects.length; ++i) {\n"
+            "        setX(objects[i], getX(objects[i]) + 1);\n"
+            "        setLength(objects[i], i);\n"
+            "    }\n"
+            "}\n");
+    QCOMPARE(engine.evaluate("getX(objects[7])").toInt(), 10);
+    QCOMPARE(engine.evaluate("objects[7].length").toInt(), 7);
+
+    // Inherited properties
+    engine.evaluate("var proto = { x: 'proto' }; var inherited = Object.create(proto);");
+    QCOMPARE(engine.evaluate("getX(inherited)").toString(), QString("proto"));
+    engine.evaluate("proto.x = 'changed'");
+    QCOMPARE(engine.evaluate("getX(inherited)").toString(), QString("changed"));
+    engine.evaluate("setX(inherited, 'own')");
+    QCOMPARE(engine.evaluate("getX(inherited)").toString(), QString("own"));
+    QCOMPARE(engine.evaluate("proto.x").toString(), QString("changed"));
+
+    // Read-only properties
+    engine.evaluate("var frozen = Object.freeze({ x: 'frozen' }); getX(frozen); setX(frozen, 'thawed');");
+    QCOMPARE(engine.evaluate("getX(frozen)").toString(), QString("frozen"));
+
+    // The length of arrays is special
+    engine.evaluate("var arr = [1, 2, 3, 4]; setLength(arr, 2);");
+    QCOMPARE(engine.evaluate("arr.length").toInt(), 2);
+    QCOMPARE(engine.evaluate("arr.join('')").toString(), QString("12"));
+
+    // Objects of the same shape with different prototypes
+    QCOMPARE(engine.evaluate("getX(Object.create({ x: 'a' }))").toString(), QString("a"));
+    QCOMPARE(engine.evaluate("getX(Object.create({ x: 'b' }))").toString(), QString("b"));
+}
+
+void tst_QJSEngine::preallocatedInlineMembers()
+{
+    QJSEngine engine;
+    engine.evaluate(""
+            "function Point(x, y) { this.x = x; this.y = y; this.z = x + y; }\n"
+            "var points = [];\n"
+            "for (var i = 0; i < 20; ++i)\n"
+            "    points.push(new Point(i, 2 * i));\n"
+            "Object.defineProperty(points[5], 'y', { get: function() { return 'accessor'; } });\n"
+            "points[5].w = 'added';\n");
+    QCOMPARE(engine.evaluate("points[5].x").toInt(), 5);
+    QCOMPARE(engine.evaluate("points[5].y").toString(), QString("accessor"));
+    QCOMPARE(engine.evaluate("points[5].z").toInt(), 15);
+    QCOMPARE(engine.evaluate("points[5].w").toString(), QString("added"));
+    QCOMPARE(engine.evaluate("points[19].z").toInt(), 57);
+    QCOMPARE(engine.evaluate("Object.keys(points[19]).join()").toString(), QString("x,y,z"));
+
+    // JSON.parse() creates its objects with room for the members of the previous one
+    engine.evaluate("var parsed = JSON.parse('[{\"a\":1,\"b\":2},{\"a\":3,\"b\":4,\"c\":5},{\"d\":6}]');");
+    QCOMPARE(engine.evaluate("JSON.stringify(parsed[0])").toString(), QString("{\"a\":1,\"b\":2}"));
+    QCOMPARE(engine.evaluate("JSON.stringify(parsed[1])").toString(), QString("{\"a\":3,\"b\":4,\"c\":5}"));
+    QCOMPARE(engine.evaluate("JSON.stringify(parsed[2])").toString(), QString("{\"d\":6}"));
+}
+
+void tst_QJSEngine::dictionaryModeObjects()
+{
+    QJSEngine engine;
+    // Many properties and deletions turn map into a dictionary
+    engine.evaluate(""
+            "var map = {};\n"
+            "for (var i = 0; i < 300; ++i)\n"
+            "    map['key' + i] = i;\n"
+            "for (var i = 0; i < 300; i += 2)\n"
+            "    delete map['key' + i];\n"
+            "map.key4 = 'again';\n");
+    QCOMPARE(engine.evaluate("Object.keys(map).length").toInt(), 151);
+    QCOMPARE(engine.evaluate("map.key1").toInt(), 1);
+    QVERIFY(engine.evaluate("map.key2").isUndefined());
+    QCOMPARE(engine.evaluate("map.key4").toString(), QString("again"));
+    QCOMPARE(engine.evaluate("map.key299").toInt(), 299);
+
+    engine.evaluate(""
+            "var small = {};\n"
+            "for (var i = 0; i < 20; ++i)\n"
+            "    small['p' + i] = i;\n"
+            "delete small.p3; delete small.p10;\n"
+            "Object.defineProperty(small, 'p5', { get: function() { return 'getter'; } });\n");
+    QCOMPARE(engine.evaluate("Object.keys(small).length").toInt(), 18);
+    QVERIFY(engine.evaluate("small.p3").isUndefined());
+    QCOMPARE(engine.evaluate("small.p5").toString(), QString("getter"));
+
+    // Lookups through a dictionary prototype see its changes
+    engine.evaluate(""
+            "var derived = Object.create(small);\n"
+            "var sum = 0;\n"
+            "for (var i = 0; i < 10; ++i)\n"
+            "    sum += derived.p19;\n"
+            "small.p19 = 1;\n"
+            "for (var i = 0; i < 10; ++i)\n"
+            "    sum += derived.p19;\n");
+    QCOMPARE(engine.evaluate("sum").toInt(), 200);
+
+    engine.evaluate("Object.freeze(small); small.p0 = 'ignored';");
+    QCOMPARE(engine.evaluate("small.p0").toInt(), 0);
+    QVERIFY(engine.evaluate("Object.isFrozen(small)").toBool());
+    QVERIFY(engine.evaluate("Object.isSealed(small)").toBool());
+
+    engine.collectGarbage();
+    QCOMPARE(engine.evaluate("map.key299 + small.p19").toInt(), 300);
+}
+
+void tst_QJSEngine::dictionaryModeDeletes()
+{
+    QJSEngine engine;
+    // Deleted members leave holes until the dictionary gets compacted
+    engine.evaluate(""
+            "var cache = {};\n"
+            "for (var i = 0; i < 1000; ++i) {\n"
+            "    cache['k' + i] = i;\n"
+            "    if (i >= 200) delete cache['k' + (i - 200)];\n"
+            "}\n");
+    QCOMPARE(engine.evaluate("Object.keys(cache).length").toInt(), 200);
+    QCOMPARE(engine.evaluate("Object.keys(cache)[0]").toString(), QString("k800"));
+    QCOMPARE(engine.evaluate("Object.keys(cache)[199]").toString(), QString("k999"));
+    QVERIFY(engine.evaluate("cache.k799").isUndefined());
+    QCOMPARE(engine.evaluate("cache.k900").toInt(), 900);
+
+    // A removed member comes back at the end
+    engine.evaluate("cache.k0 = 'back';");
+    QCOMPARE(engine.evaluate("Object.keys(cache)[200]").toString(), QString("k0"));
+    QCOMPARE(engine.evaluate("cache.k0").toString(), QString("back"));
+
+    // Turning a member into an accessor keeps its position, holes or not
+    engine.evaluate(""
+            "var o = {};\n"
+            "for (var i = 0; i < 40; ++i)\n"
+            "    o['p' + i] = i;\n"
+            "delete o.p1; delete o.p2;\n"
+            "Object.defineProperty(o, 'p20', { get: function() { return 'getter'; }, enumerable: true, configurable: true });\n"
+            "Object.defineProperty(o, 'p30', { value: 'data', enumerable: true, configurable: true });\n");
+    QCOMPARE(engine.evaluate("Object.keys(o).length").toInt(), 38);
+    QCOMPARE(engine.evaluate("Object.keys(o).indexOf('p20')").toInt(), 18);
+    QCOMPARE(engine.evaluate("o.p20").toString(), QString("getter"));
+    QCOMPARE(engine.evaluate("o.p21").toInt(), 21);
+    QCOMPARE(engine.evaluate("o.p30").toString(), QString("data"));
+    engine.evaluate("Object.defineProperty(o, 'p20', { value: 'data again' });");
+    QCOMPARE(engine.evaluate("o.p20").toString(), QString("data again"));
+    QCOMPARE(engine.evaluate("Object.keys(o).indexOf('p20')").toInt(), 18);
+    QCOMPARE(engine.evaluate("o.p39").toInt(), 39);
+
+    engine.collectGarbage();
+    QCOMPARE(engine.evaluate("cache.k999 + o.p39").toInt(), 1038);
+}
+
+void tst_QJSEngine::dictionaryModeSealAndFreeze()
+{
+    QJSEngine engine;
+    engine.evaluate(""
+            "function makeMap() {\n"
+            "    var map = {};\n"
+            "    for (var i = 0; i < 200; ++i)\n"
+            "        map['key' + i] = i;\n"
+            "    return map;\n"
+            "}\n"
+            "var sealed = makeMap();\n"
+            "var frozen = makeMap();\n");
+
+    // Asking doesn't change anything
+    QVERIFY(!engine.evaluate("Object.isSealed(sealed)").toBool());
+    QVERIFY(!engine.evaluate("Object.isFrozen(frozen)").toBool());
+    engine.evaluate("sealed.key1 = 'changed'; delete frozen.key2;");
+    QCOMPARE(engine.evaluate("sealed.key1").toString(), QString("changed"));
+    QVERIFY(engine.evaluate("frozen.key2").isUndefined());
+
+    engine.evaluate("Object.seal(sealed); sealed.key3 = 'changed'; delete sealed.key4; sealed.extra = 1;");
+    QVERIFY(engine.evaluate("Object.isSealed(sealed)").toBool());
+    QVERIFY(!engine.evaluate("Object.isFrozen(sealed)").toBool());
+    QCOMPARE(engine.evaluate("sealed.key3").toString(), QString("changed"));
+    QCOMPARE(engine.evaluate("sealed.key4").toInt(), 4);
+    QVERIFY(engine.evaluate("sealed.extra").isUndefined());
+
+    engine.evaluate("Object.freeze(frozen); frozen.key3 = 'changed'; delete frozen.key4; frozen.extra = 1;");
+    QVERIFY(engine.evaluate("Object.isFrozen(frozen)").toBool());
+    QVERIFY(engine.evaluate("Object.isSealed(frozen)").toBool());
+    QCOMPARE(engine.evaluate("frozen.key3").toInt(), 3);
+    QCOMPARE(engine.evaluate("frozen.key4").toInt(), 4);
+    QVERIFY(engine.evaluate("frozen.extra").isUndefined());
+    QCOMPARE(engine.evaluate("Object.keys(frozen).length").toInt(), 199);
+
+    // Other objects of the same size still start out extensible
+    QVERIFY(engine.evaluate("Object.isExtensible(makeMap())").toBool());
+}
+
+void tst_QJSEngine::enumerationCache()
+{
+    QJSEngine engine;
+    engine.evaluate("function keysOf(o) { var keys = []; for (var k in o) keys.push(k); return keys.join(''); }");
+
+    // The second and third loop use the cached keys of the shape
+    for (int i = 0; i < 3; ++i)
+        QCOMPARE(engine.evaluate("keysOf({ a: 1, b: 2, c: 3 })").toString(), QString("abc"));
+
+    engine.evaluate("var o = { a: 1, b: 2, c: 3 }; Object.defineProperty(o, 'b', { enumerable: false });");
+    QCOMPARE(engine.evaluate("keysOf(o)").toString(), QString("ac"));
+    QCOMPARE(engine.evaluate("Object.keys(o).join('')").toString(), QString("ac"));
+
+    engine.evaluate("Object.defineProperty(o, 'd', { get: function() { return 4; }, enumerable: true }); o.e = 5;");
+    QCOMPARE(engine.evaluate("keysOf(o)").toString(), QString("acde"));
+    engine.evaluate("delete o.a");
+    QCOMPARE(engine.evaluate("keysOf(o)").toString(), QString("cde"));
+
+    // Own keys come first, and shadowed ones only once
+    engine.evaluate("var derived = Object.create(o); derived.x = 1; derived.c = 2;");
+    QCOMPARE(engine.evaluate("keysOf(derived)").toString(), QString("xcde"));
+    QCOMPARE(engine.evaluate("Object.keys(derived).join('')").toString(), QString("xc"));
+
+    // Dictionary objects
+    engine.evaluate(""
+            "var map = {};\n"
+            "for (var i = 0; i < 200; ++i)\n"
+            "    map['k' + i] = i;\n");
+    QCOMPARE(engine.evaluate("Object.keys(map).length").toInt(), 200);
+    engine.evaluate("Object.defineProperty(map, 'k0', { enumerable: false }); delete map.k1;");
+    QCOMPARE(engine.evaluate("Object.keys(map).length").toInt(), 198);
+    QCOMPARE(engine.evaluate("Object.keys(map)[0]").toString(), QString("k2"));
+}
+
+void tst_QJSEngine::stableArraySort_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<QString>("expected");
+
+    QTest::newRow("numeric") << "[3, -1.5, 10, 2, 0].sort(function(a, b) { return a - b; }).join(' ')" << "-1.5 0 2 3 10";
+    QTest::newRow("reversed numeric") << "[3, -1.5, 10, 2, 0].sort(function(x, y) { return y - x; }).join(' ')" << "10 3 2 0 -1.5";
+    QTest::newRow("numeric on strings") << "['3', 1, '20', 2].sort(function(a, b) { return a - b; }).join(' ')" << "1 2 3 20";
+    QTest::newRow("default") << "[10, 9, 1, 'b', 'a'].sort().join(' ')" << "1 10 9 a b";
+    QTest::newRow("holes and undefined")
+            << "var holes = [3, undefined, , 1, , 2]; holes.sort();"
+               "[holes.length, 2 in holes, 3 in holes, 4 in holes, holes.join(' ')].join()"
+            << "6,true,true,false,1 2 3   ";
+    QTest::newRow("after unshift") << "var shifted = [5, 4, 3]; shifted.unshift(6); shifted.sort().join(' ')" << "3 4 5 6";
+    QTest::newRow("sparse")
+            << "var sparse = []; sparse[1000] = 'c'; sparse[10] = 'b'; sparse[5] = 'a'; sparse.sort();"
+               "[sparse.length, sparse[0], sparse[1], sparse[2], 3 in sparse, 1000 in sparse].join()"
+            << "1001,a,b,c,false,false";
+    QTest::newRow("array-like object")
+            << "var object = { length: 11, 0: 'y', 10: 'x', 20: 'w' }; Array.prototype.sort.call(object);"
+               "[object[0], object[1], object[10], object[20]].join()"
+            << "x,y,,w";
+    QTest::newRow("sparse array-like object")
+            << "var sparseObject = { length: 3 }; sparseObject[5000] = 'q'; sparseObject[2] = 'b'; sparseObject[0] = 'c';"
+               "Array.prototype.sort.call(sparseObject);"
+               "[sparseObject[0], sparseObject[1], sparseObject[2], sparseObject[5000]].join()"
+            << "b,c,,q";
+    QTest::newRow("throwing comparator")
+            << "(function() { try { [1, 2, 3].sort(function() { throw 'thrown'; }); return 'not thrown'; } catch (e) { return e; } })()"
+            << "thrown";
+    QTest::newRow("throwing comparator on sparse array-like object")
+            << "var throwing = { length: 3 }; throwing[5000] = 'q'; throwing[2] = 'b'; throwing[0] = 'c';"
+               "try { Array.prototype.sort.call(throwing, function() { throw 'thrown'; }); } catch (e) {}"
+               "[throwing[5000], throwing.length].join()"
+            << "q,3";
+    QTest::newRow("throwing toString on sparse array-like object")
+            << "var throwingKey = { length: 3 }; throwingKey[5000] = 'q'; throwingKey[0] = 'c';"
+               "throwingKey[2] = { toString: function() { throw 'thrown'; } };"
+               "try { Array.prototype.sort.call(throwingKey); } catch (e) {}"
+               "[throwingKey[5000], throwingKey.length].join()"
+            << "q,3";
+}
+
+void tst_QJSEngine::stableArraySort()
+{
+    QFETCH(QString, expression);
+    QFETCH(QString, expected);
+
+    QJSEngine engine;
+    QCOMPARE(engine.evaluate(expression).toString(), expected);
+}
+
+void tst_QJSEngine::stableArraySortKeepsOrder()
+{
+    QJSEngine engine;
+    engine.evaluate(""
+            "var rows = [];\n"
+            "for (var i = 0; i < 100; ++i)\n"
+            "    rows.push({ key: i % 3, id: i });\n"
+            "rows.sort(function(a, b) { return a.key - b.key; });\n");
+    QJSValue rows = engine.globalObject().property("rows");
+    QCOMPARE(rows.property("length").toInt(), 100);
+    for (int i = 1; i < 100; ++i) {
+        QJSValue previous = rows.property(i - 1);
+        QJSValue row = rows.property(i);
+        // Rows with the same key keep their order
+        if (previous.property("key").toInt() == row.property("key").toInt())
+            QVERIFY(previous.property("id").toInt() < row.property("id").toInt());
+        else
+            QVERIFY(previous.property("key").toInt() < row.property("key").toInt());
+    }
+}
+
+void tst_QJSEngine::arraySortWithInconsistentComparator_data()
+{
+    QTest::addColumn<QString>("comparator");
+
+    QTest::newRow("random") << QString::fromLatin1("function() { return Math.random() - 0.5; }");
+    QTest::newRow("always less") << QString::fromLatin1("function() { return -1; }");
+    QTest::newRow("always greater") << QString::fromLatin1("function() { return 1; }");
+    QTest::newRow("NaN") << QString::fromLatin1("function(a, b) { return a < 250 ? NaN : a - b; }");
+    QTest::newRow("changing") << QString::fromLatin1("function(a, b) { ++calls; return calls % 3 ? a - b : b - a; }");
+}
+
+void tst_QJSEngine::arraySortWithInconsistentComparator()
+{
+    QFETCH(QString, comparator);
+
+    QJSEngine engine;
+    engine.evaluate("var calls = 0;\n"
+                    "var values = [];\n"
+                    "for (var i = 0; i < 500; ++i)\n"
+                    "    values.push((i * 7919) % 500);\n"
+                    "var sorted = values.slice();\n");
+    QJSValue result = engine.evaluate("sorted.sort(" + comparator + ").length");
+    QVERIFY(!result.isError());
+    QCOMPARE(result.toInt(), 500);
+
+    // Whatever the order, the result has to be a permutation of the input
+    result = engine.evaluate("function numeric(a, b) { return a - b; }\n"
+                             "sorted.sort(numeric).join() === values.slice().sort(numeric).join()");
+    QVERIFY(result.toBool());
+}
+
+void tst_QJSEngine::jsonRecords()
+{
+    QJSEngine engine;
+    // Records that mostly share their shape, with escapes, reordered keys, array indexes and
+    // duplicate keys in between
+    engine.evaluate(""
+            "var records = JSON.parse('[{\"id\":1,\"name\":\"a\",\"tags\":[\"x\"]},'\n"
+            "                         + '{\"id\":2,\"name\":\"b\\\\u00e9\",\"tags\":[]},'\n"
+            "                         + '{\"i\\\\u0064\":3,\"name\":\"c\",\"tags\":[\"y\",\"z\"]},'\n"
+            "                         + '{\"name\":\"d\",\"id\":4},'\n"
+            "                         + '{\"id\":5,\"0\":\"index\",\"name\":\"e\",\"name\":\"f\"},'\n"
+            "                         + '{\"id\":6,\"name\":\"g\",\"tags\":null,\"extra\":true}]');\n"
+            "function describe(r) { return r.id + r.name + Object.keys(r).join('/'); }\n");
+    QCOMPARE(engine.evaluate("records.length").toInt(), 6);
+    QCOMPARE(engine.evaluate("describe(records[0])").toString(), QString("1aid/name/tags"));
+    QCOMPARE(engine.evaluate("describe(records[1])").toString(), QString::fromUtf8("2b\xc3\xa9id/name/tags"));
+    QCOMPARE(engine.evaluate("describe(records[2])").toString(), QString("3cid/name/tags"));
+    QCOMPARE(engine.evaluate("describe(records[3])").toString(), QString("4dname/id"));
+    QCOMPARE(engine.evaluate("describe(records[4])").toString(), QString("5f0/id/name"));
+    QCOMPARE(engine.evaluate("describe(records[5])").toString(), QString("6gid/name/tags/extra"));
+
+    QCOMPARE(engine.evaluate("JSON.stringify(records[1])").toString(),
+             QString::fromUtf8("{\"id\":2,\"name\":\"b\xc3\xa9\",\"tags\":[]}"));
+    QCOMPARE(engine.evaluate("JSON.stringify(records[4])").toString(),
+             QString("{\"0\":\"index\",\"id\":5,\"name\":\"f\"}"));
+
+    // Values that are left out or become null, and escapes
+    QCOMPARE(engine.evaluate("JSON.stringify({ a: [1, undefined, function() {}, 'q\"\\\\\\n'], b: undefined, c: { d: 1.5 } })").toString(),
+             QString("{\"a\":[1,null,null,\"q\\\"\\\\\\n\"],\"c\":{\"d\":1.5}}"));
+    QCOMPARE(engine.evaluate("JSON.stringify({ a: [1, { b: 2 }], e: {} , f: [] }, null, 2)").toString(),
+             QString("{\n  \"a\": [\n    1,\n    {\n      \"b\": 2\n    }\n  ],\n  \"e\": {},\n  \"f\": []\n}"));
+}
+
+void tst_QJSEngine::stringBuilding_data()
+{
+    QTest::addColumn<QString>("expression");
+    QTest::addColumn<QString>("expected");
+
+    const QString line = QStringLiteral("['a', 1, -2.5, true, false, null, undefined, rope.substr(0, 3), 'b' + 'c']");
+    QTest::newRow("join primitives") << QString("%1.join()").arg(line) << "a,1,-2.5,true,false,,,xxx,bc";
+    QTest::newRow("join primitives without separator") << QString("%1.join('')").arg(line) << "a1-2.5truefalsexxxbc";
+    QTest::newRow("join primitives with long separator") << QString("%1.join(' - ')").arg(line) << "a - 1 - -2.5 - true - false -  -  - xxx - bc";
+    QTest::newRow("join holes") << "[1, , 3].join(':')" << "1::3";
+    QTest::newRow("join objects") << "[1, { toString: function() { return 'o'; } }, [2, 3]].join()" << "1,o,2,3";
+    QTest::newRow("join ropes") << "String([rope, rope].join('').length)" << "2048";
+    QTest::newRow("append in a loop")
+            << "var s = ''; for (var i = 0; i < 1000; ++i) s += i % 10; s.length + '|' + s.substr(990)"
+            << "1000|0123456789";
+}
+
+void tst_QJSEngine::stringBuilding()
+{
+    QFETCH(QString, expression);
+    QFETCH(QString, expected);
+
+    QJSEngine engine;
+    // rope is built by repeated concatenation
+    engine.evaluate("var rope = 'x'; for (var i = 0; i < 10; ++i) rope += rope;");
+    QCOMPARE(engine.evaluate(expression).toString(), expected);
+}
+
+void tst_QJSEngine::longStringKeys()
+{
+    QJSEngine engine;
+    QJSValue result = engine.evaluate(QString::fromUtf8(""
+            "var o = { abcdefghijklmnopqrstuvwxyz0123456789: 1, 'abcdefghijklmnopqrstuvwxyz012345678\xc3\xa9': 2 };\n"
+            "var a = 'abcdefghijklmnopq', b = 'rstuvwxyz012345678';\n"
+            "o[a + b + '9'] += 10;\n"
+            "o[a + b + '\\u00e9'] += 20;\n"
+            "o[a + b + '0'] = 3;\n"
+            "[o.abcdefghijklmnopqrstuvwxyz0123456789, o['abcdefghijklmnopqrstuvwxyz012345678\xc3\xa9'],\n"
+            " o.abcdefghijklmnopqrstuvwxyz0123456780, (a + b + '9') === 'abcdefghijklmnopqrstuvwxyz0123456789',\n"
+            " (a + b + '9') === (a + b + '8'), Object.keys(o).length].join()"));
+    QCOMPARE(result.toString(), QString::fromLatin1("11,22,3,true,false,3"));
+}
+
+void tst_QJSEngine::lazyFunctionCompilation()
+{
+    QJSEngine engine;
+    // inner() is compiled while outer() runs, and adds strings, lookups, constants, a regular
+    // expression and an object literal class to the compilation unit
+    QJSValue result = engine.evaluate(
+            "var o = { first: 1.5 };\n"
+            "function outer(x) {\n"
+            "    var before = o.first + 0.25;\n"
+            "    function inner(y) {\n"
+            "        var match = /b+(c)/i.exec(y);\n"
+            "        var literal = { lazyName: match[1], count: 2.75 };\n"
+            "        return literal.lazyName + literal.count;\n"
+            "    }\n"
+            "    var s = inner(x);\n"
+            "    return [before, s, o.first + 0.25, inner('xBBC')].join();\n"
+            "}\n"
+            "function notCalledYet() { return /unused/.test('unused') + { unused: 3.5 }.unused; }\n"
+            "outer('abbc')");
+    QCOMPARE(result.toString(), QString::fromLatin1("1.75,c2.75,1.75,C2.75"));
+    QCOMPARE(engine.evaluate("outer('cbc')").toString(), QString::fromLatin1("1.75,c2.75,1.75,C2.75"));
+    QCOMPARE(engine.globalObject().property("notCalledYet").call().toNumber(), 4.5);
+}
+
+void tst_QJSEngine::tieredCompilation()
+{
+    QJSEngine engine;
+    // fib() tiers up while interpreted calls of it are still running, and sum() tiers up after
+    // its loop ran often enough
+    QJSValue result = engine.evaluate(
+            "function fib(n) { return n < 2 ? n : fib(n - 1) + fib(n - 2); }\n"
+            "function sum(n) { var s = 0; for (var i = 0; i < n; ++i) s += i * 0.5; return s; }\n"
+            "var sums = [sum(2000), sum(2000), sum(10)];\n"
+            "[fib(20), sums.join()].join(';')");
+    QCOMPARE(result.toString(), QString::fromLatin1("6765;999500,999500,22.5"));
+
+    QJSValue add = engine.evaluate("(function(a, b) { return { sum: a + b }.sum; })");
+    for (int i = 0; i < 10; ++i)
+        QCOMPARE(add.call(QJSValueList() << i << 1).toInt(), i + 1);
+
+    // With an empty tier-up window, every garbage collection ends a window. A function that didn't
+    // run during a whole window loses its IR and stays interpreted.
+    const QByteArray previousWindow = qgetenv("QV4_JIT_TIER_UP_WINDOW");
+    qputenv("QV4_JIT_TIER_UP_WINDOW", "0");
+    QJSEngine windowEngine;
+    if (previousWindow.isNull())
+        qunsetenv("QV4_JIT_TIER_UP_WINDOW");
+    else
+        qputenv("QV4_JIT_TIER_UP_WINDOW", previousWindow);
+
+    QJSValue twice = windowEngine.evaluate("(function(a) { var r = []; for (var i = 0; i < 3; ++i) r.push(a * 2); return r.join(); })");
+    const QV4::FunctionObject *function = QJSValuePrivate::getValue(&twice)->as<QV4::FunctionObject>();
+    QVERIFY(function);
+    QV4::CompiledData::CompilationUnit *unit = function->function()->compilationUnit;
+    const bool tiered = QV8Engine::getV4(&windowEngine)->interpreterISelFactory;
+    // Two calls, one per window, are below the call threshold
+    QCOMPARE(twice.call(QJSValueList() << 1).toString(), QString::fromLatin1("2,2,2"));
+    windowEngine.collectGarbage();
+    QCOMPARE(twice.call(QJSValueList() << 2).toString(), QString::fromLatin1("4,4,4"));
+    windowEngine.collectGarbage();
+    // Without tier-up, the unit let go of its lazy compiler when the function was compiled
+    QCOMPARE(bool(unit->lazyCompiler), tiered);
+    windowEngine.collectGarbage();
+    QVERIFY(!unit->lazyCompiler);
+    for (int i = 0; i < 10; ++i)
+        QCOMPARE(twice.call(QJSValueList() << i).toString(), QString::fromLatin1("%1,%1,%1").arg(i * 2));
+}
+
+void tst_QJSEngine::lazyCompilerRelease()
+{
+    // Without tier-up, the instruction selection is only kept for the functions that are compiled
+    // when first called
+    const QByteArray previousThreshold = qgetenv("QV4_JIT_CALL_THRESHOLD");
+    qputenv("QV4_JIT_CALL_THRESHOLD", "0");
+    QQmlEngine engine;
+    if (previousThreshold.isNull())
+        qunsetenv("QV4_JIT_CALL_THRESHOLD");
+    else
+        qputenv("QV4_JIT_CALL_THRESHOLD", previousThreshold);
+
+    QJSValue functions = engine.evaluate(
+            "function first() { return 1; }\n"
+            "function second() { function inner() { return 2; } return inner(); }\n"
+            "[first, second]");
+    QJSValue first = functions.property(0);
+    const QV4::FunctionObject *function = QJSValuePrivate::getValue(&first)->as<QV4::FunctionObject>();
+    QVERIFY(function);
+    QV4::CompiledData::CompilationUnit *unit = function->function()->compilationUnit;
+    QVERIFY(unit->lazyCompiler);
+    QCOMPARE(first.call().toInt(), 1);
+    QVERIFY(unit->lazyCompiler);
+    QCOMPARE(functions.property(1).call().toInt(), 2);
+    QVERIFY(!unit->lazyCompiler);
+
+    // The context scope function of a QML unit is never called, so it must not be left pending
+    QQmlComponent component(&engine);
+    component.setData("import QtQml 2.0\n"
+                      "QtObject {\n"
+                      "    property int value: 3\n"
+                      "    function twice() { return value * 2; }\n"
+                      "}", QUrl());
+    QScopedPointer<QObject> object(component.create());
+    QVERIFY(object);
+    QV4::CompiledData::CompilationUnit *qmlUnit = QQmlComponentPrivate::get(&component)->cc->compilationUnit.data();
+    QVERIFY(qmlUnit->lazyCompiler);
+    QVariant result;
+    QVERIFY(QMetaObject::invokeMethod(object.data(), "twice", Q_RETURN_ARG(QVariant, result)));
+    QCOMPARE(result.toInt(), 6);
+    QVERIFY(!qmlUnit->lazyCompiler);
+}
+
 void tst_QJSEngine::prototypeChainGc()
 {
     QJSEngine engine;
@@ -3683,6 +4323,228 @@ void tst_QJSEngine::exceptions()
     engine.evaluate("console.exception('Exception 1')");
 }
 
+void tst_QJSEngine::heapSnapshot()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.path() + QStringLiteral("/test.heapsnapshot");
+
+    QJSEngine engine;
+    engine.installExtensions(QJSEngine::ConsoleExtension);
+    engine.evaluate("var holder = { payload: 'heapSnapshotMarker', list: [1, 2, 3] };");
+    QJSValue result = engine.evaluate(QStringLiteral("console.takeHeapSnapshot('%1')").arg(fileName));
+    QVERIFY(!result.isError());
+
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QJsonParseError error;
+    const QJsonObject snapshot = QJsonDocument::fromJson(file.readAll(), &error).object();
+    QCOMPARE(error.error, QJsonParseError::NoError);
+
+    const QJsonObject meta = snapshot.value("snapshot").toObject().value("meta").toObject();
+    const int nodeFieldCount = meta.value("node_fields").toArray().size();
+    const int edgeFieldCount = meta.value("edge_fields").toArray().size();
+    QCOMPARE(nodeFieldCount, 6);
+    QCOMPARE(edgeFieldCount, 3);
+
+    const QJsonArray nodes = snapshot.value("nodes").toArray();
+    const QJsonArray edges = snapshot.value("edges").toArray();
+    const QJsonArray strings = snapshot.value("strings").toArray();
+    const int nodeCount = snapshot.value("snapshot").toObject().value("node_count").toInt();
+    QCOMPARE(nodes.size(), nodeCount * nodeFieldCount);
+    QCOMPARE(edges.size(),
+             snapshot.value("snapshot").toObject().value("edge_count").toInt() * edgeFieldCount);
+    QVERIFY(strings.contains(QStringLiteral("heapSnapshotMarker")));
+
+    // the edge counts of the nodes have to add up, and all edges point to the start of a node
+    int totalEdges = 0;
+    for (int i = 0; i < nodes.size(); i += nodeFieldCount)
+        totalEdges += nodes.at(i + 4).toInt();
+    QCOMPARE(totalEdges * edgeFieldCount, edges.size());
+    for (int i = 0; i < edges.size(); i += edgeFieldCount) {
+        const int toNode = edges.at(i + 2).toInt();
+        QVERIFY(toNode >= 0 && toNode < nodes.size());
+        QCOMPARE(toNode % nodeFieldCount, 0);
+    }
+}
+
+void tst_QJSEngine::idleTimeGarbageCollection()
+{
+    QJSEngine engine;
+    QV4::MemoryManager *memoryManager = QV8Engine::getV4(&engine)->memoryManager;
+
+    QVERIFY(!memoryManager->isGCDeferred());
+    memoryManager->setGCDeferred(true);
+    QVERIFY(memoryManager->isGCDeferred());
+    QVERIFY(!memoryManager->collectInIdleTime(0));
+
+    // Allocations don't collect while deferred ones pile up, so that a collection is due when
+    // there is idle time again
+    memoryManager->setGCBlocked(true);
+    QJSValue survivors = engine.evaluate(
+            "var survivors = [];\n"
+            "for (var i = 0; i < 100000; ++i) {\n"
+            "    var o = { index: i, name: 'item' + i };\n"
+            "    if (i % 10 == 0) survivors.push(o);\n"
+            "}\n"
+            "survivors");
+    memoryManager->setGCBlocked(false);
+    QVERIFY(memoryManager->collectInIdleTime(1000));
+
+    for (int i = 0; i < 1000 && memoryManager->hasPendingSweep(); ++i)
+        memoryManager->collectInIdleTime(1);
+    QVERIFY(!memoryManager->hasPendingSweep());
+
+    // Collections that allocations trigger while GC is deferred keep the survivors as well
+    engine.evaluate("for (var i = 0; i < 200000; ++i) var garbage = { index: i, name: 'garbage' + i };");
+    memoryManager->setGCDeferred(false);
+
+    QCOMPARE(survivors.property("length").toInt(), 10000);
+    for (int i = 0; i < 10000; i += 999) {
+        QJSValue item = survivors.property(i);
+        QCOMPARE(item.property("index").toInt(), i * 10);
+        QCOMPARE(item.property("name").toString(), QStringLiteral("item%1").arg(i * 10));
+    }
+}
+
+static void recordGarbageCollection(const QV4::Profiling::GarbageCollectionProperties &properties, void *data)
+{
+    static_cast<QVector<QV4::Profiling::GarbageCollectionProperties> *>(data)->append(properties);
+}
+
+void tst_QJSEngine::garbageCollectionCallback()
+{
+    QJSEngine engine;
+    QV4::MemoryManager *memoryManager = QV8Engine::getV4(&engine)->memoryManager;
+    QVector<QV4::Profiling::GarbageCollectionProperties> collections;
+    memoryManager->setGarbageCollectionCallback(recordGarbageCollection, &collections);
+
+    engine.evaluate("for (var i = 0; i < 10000; ++i) var garbage = { index: i, name: 'garbage' + i };");
+    engine.collectGarbage();
+    QVERIFY(!collections.isEmpty());
+    QVERIFY(collections.last().bytesFreed > 0);
+    QCOMPARE(collections.last().itemsInUse.size(), collections.last().availableItems.size());
+
+    // A lazily swept collection is reported once its last chunk is swept
+    collections.clear();
+    memoryManager->setGCBlocked(true);
+    engine.evaluate("for (var i = 0; i < 100000; ++i) var garbage = { index: i, name: 'garbage' + i };");
+    memoryManager->setGCBlocked(false);
+    QVERIFY(memoryManager->collectInIdleTime(1000));
+    QCOMPARE(collections.isEmpty(), memoryManager->hasPendingSweep());
+    for (int i = 0; i < 1000 && memoryManager->hasPendingSweep(); ++i)
+        memoryManager->collectInIdleTime(1);
+    QVERIFY(!memoryManager->hasPendingSweep());
+    QCOMPARE(collections.size(), 1);
+    QVERIFY(collections.last().bytesFreed > 0);
+    QVERIFY(collections.last().sweepTime > 0);
+
+    memoryManager->setGarbageCollectionCallback(0, 0);
+}
+
+void tst_QJSEngine::garbageCollectionStress_data()
+{
+    QTest::addColumn<QStringList>("environment");
+    QTest::addColumn<int>("count");
+
+    QTest::newRow("default") << QStringList() << 2000;
+    QTest::newRow("aggressive") << (QStringList() << "QV4_MM_AGGRESSIVE_GC=1") << 100;
+    QTest::newRow("no incremental sweep") << (QStringList() << "QV4_MM_NO_INCREMENTAL_SWEEP=1") << 2000;
+    QTest::newRow("keep empty chunks") << (QStringList() << "QV4_MM_EMPTY_CHUNK_POLICY=0") << 2000;
+    QTest::newRow("decommit empty chunks") << (QStringList() << "QV4_MM_EMPTY_CHUNK_POLICY=1") << 2000;
+    QTest::newRow("release empty chunks") << (QStringList() << "QV4_MM_EMPTY_CHUNK_POLICY=2") << 2000;
+    QTest::newRow("compaction") << (QStringList() << "QV4_MM_COMPACTION_THRESHOLD=50") << 2000;
+    QTest::newRow("no large item cache") << (QStringList() << "QV4_MM_LARGE_ITEM_CACHE_SIZE=0") << 2000;
+    QTest::newRow("small chunks") << (QStringList() << "QV4_MM_MAXBLOCK_SHIFT=1" << "QV4_MM_MAX_CHUNK_SIZE=65536") << 2000;
+    QTest::newRow("aggressive, release and compaction")
+            << (QStringList() << "QV4_MM_AGGRESSIVE_GC=1" << "QV4_MM_EMPTY_CHUNK_POLICY=2" << "QV4_MM_COMPACTION_THRESHOLD=50")
+            << 100;
+}
+
+void tst_QJSEngine::garbageCollectionStress()
+{
+    QFETCH(QStringList, environment);
+    QFETCH(int, count);
+
+    // The memory manager reads its settings when the engine is created
+    QList<QPair<QByteArray, QByteArray> > previousEnvironment;
+    foreach (const QString &setting, environment) {
+        const QByteArray name = setting.section(QLatin1Char('='), 0, 0).toLatin1();
+        previousEnvironment << qMakePair(name, qgetenv(name.constData()));
+        qputenv(name.constData(), setting.section(QLatin1Char('='), 1).toLatin1());
+    }
+    QJSEngine engine;
+    for (int i = previousEnvironment.size() - 1; i >= 0; --i) {
+        if (previousEnvironment.at(i).second.isNull())
+            qunsetenv(previousEnvironment.at(i).first.constData());
+        else
+            qputenv(previousEnvironment.at(i).first.constData(), previousEnvironment.at(i).second);
+    }
+
+    // Items of several size classes, arrays whose storage is a large item of up to a few pages,
+    // and strings with unmanaged data. Every fourth one survives.
+    engine.evaluate(
+            "function makeItem(i) {\n"
+            "    switch (i % 6) {\n"
+            "    case 0: return { index: i };\n"
+            "    case 1: return { index: i, a: i + 1, b: i + 2, c: i + 3, d: i + 4, e: i + 5, f: i + 6, g: i + 7 };\n"
+            "    case 2: return 'string' + i;\n"
+            "    case 3: var a = new Array(100 + (i % 50) * 40); for (var j = 0; j < a.length; ++j) a[j] = i + j; return a;\n"
+            "    case 4: return [i, i + 1, i + 2];\n"
+            "    case 5: return new Array(65).join('s' + i);\n"
+            "    }\n"
+            "}\n"
+            "function checkItem(i, item) {\n"
+            "    switch (i % 6) {\n"
+            "    case 0: return item.index === i;\n"
+            "    case 1: return item.index === i && item.d === i + 4 && item.g === i + 7;\n"
+            "    case 2: return item === 'string' + i;\n"
+            "    case 3:\n"
+            "        if (item.length !== 100 + (i % 50) * 40) return false;\n"
+            "        for (var j = 0; j < item.length; ++j) { if (item[j] !== i + j) return false; }\n"
+            "        return true;\n"
+            "    case 4: return item.length === 3 && item[0] === i && item[2] === i + 2;\n"
+            "    case 5: return item.length === 64 * ('s' + i).length && item.lastIndexOf('s' + i) === item.length - ('s' + i).length;\n"
+            "    }\n"
+            "}\n"
+            "var survivors = [];\n"
+            "function allocate(count) {\n"
+            "    for (var i = 0; i < count; ++i) {\n"
+            "        var item = makeItem(i);\n"
+            "        if (i % 4 == 0) survivors.push([i, item]);\n"
+            "    }\n"
+            "}\n"
+            "function failedSurvivors() {\n"
+            "    var failed = 0;\n"
+            "    for (var k = 0; k < survivors.length; ++k) {\n"
+            "        if (!checkItem(survivors[k][0], survivors[k][1])) ++failed;\n"
+            "    }\n"
+            "    return failed;\n"
+            "}\n");
+    QJSValue allocate = engine.globalObject().property("allocate");
+    QJSValue failedSurvivors = engine.globalObject().property("failedSurvivors");
+    QVERIFY(allocate.isCallable());
+    QVERIFY(failedSurvivors.isCallable());
+
+    const int survivorsPerRound = count / 4;
+    for (int round = 0; round < 3; ++round) {
+        allocate.call(QJSValueList() << count);
+        engine.collectGarbage();
+        QCOMPARE(failedSurvivors.call().toInt(), 0);
+    }
+    QCOMPARE(engine.evaluate("survivors.length").toInt(), 3 * survivorsPerRound);
+
+    // Leaves chunks sparse or empty, which then get decommitted, released or compacted, and
+    // filled again
+    engine.evaluate("survivors = survivors.filter(function(survivor, k) { return k % 2 == 0; })");
+    engine.collectGarbage();
+    QCOMPARE(failedSurvivors.call().toInt(), 0);
+    allocate.call(QJSValueList() << count);
+    engine.collectGarbage();
+    QCOMPARE(failedSurvivors.call().toInt(), 0);
+    QCOMPARE(engine.evaluate("survivors.length").toInt(), (3 * survivorsPerRound + 1) / 2 + survivorsPerRound);
+}
+
 void tst_QJSEngine::installGarbageCollectionFunctions()
 {
     QJSEngine engine;
@@ -327,6 +327,7 @@ private slots:
     void writeUnregisteredQObjectProperty();
     void switchExpression();
     void qtbug_46022();
+    void manyBindings();
 
 private:
 //    static void propertyVarWeakRefCallback(v8::Persistent<v8::Value> object, void* parameter);
@@ -7889,6 +7890,35 @@ void tst_qqmlecmascript::qtbug_46022()
     QCOMPARE(obj->property("test2").toBool(), true);
 }
 
+void tst_qqmlecmascript::manyBindings()
+{
+    // Enough binding functions for the type compiler to optimize them on several threads, with
+    // lookups that resolve through the property caches
+    const int count = 64;
+    QByteArray qml = "import QtQml 2.0\nQtObject {\n"
+                     "    property QtObject child: QtObject { property int value: 7 }\n"
+                     "    property int p0: 0\n";
+    for (int i = 1; i < count; ++i) {
+        qml += "    property int p" + QByteArray::number(i) + ": p" + QByteArray::number(i - 1)
+                + " + " + QByteArray::number(i) + "\n";
+        qml += "    property int q" + QByteArray::number(i) + ": child.value * " + QByteArray::number(i) + "\n";
+        qml += "    property string s" + QByteArray::number(i) + ": \"s\" + q" + QByteArray::number(i) + "\n";
+    }
+    qml += "}\n";
+
+    QQmlComponent component(&engine);
+    component.setData(qml, QUrl());
+    QScopedPointer<QObject> obj(component.create());
+    QVERIFY2(obj != 0, qPrintable(component.errorString()));
+
+    for (int i = 1; i < count; ++i) {
+        const QByteArray index = QByteArray::number(i);
+        QCOMPARE(obj->property(QByteArray("p" + index).constData()).toInt(), i * (i + 1) / 2);
+        QCOMPARE(obj->property(QByteArray("q" + index).constData()).toInt(), 7 * i);
+        QCOMPARE(obj->property(QByteArray("s" + index).constData()).toString(), QString::fromLatin1("s%1").arg(7 * i));
+    }
+}
+
 QTEST_MAIN(tst_qqmlecmascript)
 
 #include "tst_qqmlecmascript.moc"
@@ -33,16 +33,31 @@
 
 #include <QtTest/QtTest>
 #include <QtQml/qqmlengine.h>
+#include <QtQml/qqmlcomponent.h>
+#include <QtCore/qcryptographichash.h>
 #include <QtQuick/qquickview.h>
 #include <QtQuick/qquickitem.h>
+#include <private/qqmldiskcache_p.h>
+#include <private/qv8engine_p.h>
+#include <private/qv4isel_moth_p.h>
 #include "../../shared/util.h"
 
 class tst_QQMLTypeLoader : public QQmlDataTest
 {
     Q_OBJECT
+public:
+    tst_QQMLTypeLoader()
+    {
+        // Only interpreter code can be cached, so the engines of all tests use the interpreter.
+        // The backend is chosen once, when the first engine is created.
+        qputenv("QV4_FORCE_INTERPRETER", "1");
+        qputenv("QML_ENABLE_DISK_CACHE", "1");
+    }
 
 private slots:
     void testLoadComplete();
+    void diskCachedScripts();
+    void precompiledScripts();
 };
 
 void tst_QQMLTypeLoader::testLoadComplete()
@@ -62,6 +77,104 @@ void tst_QQMLTypeLoader::testLoadComplete()
     delete window;
 }
 
+static bool writeFile(const QString &path, const QByteArray &contents)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(contents) == contents.size();
+}
+
+static int loadValue(const QString &path)
+{
+    QQmlEngine engine;
+    QQmlComponent component(&engine, QUrl::fromLocalFile(path));
+    QScopedPointer<QObject> object(component.create());
+    return object ? object->property("value").toInt() : -1;
+}
+
+void tst_QQMLTypeLoader::diskCachedScripts()
+{
+    QTemporaryDir cacheDir;
+    QTemporaryDir sourceDir;
+    QVERIFY(cacheDir.isValid());
+    QVERIFY(sourceDir.isValid());
+    qputenv("QML_DISK_CACHE_PATH", QFile::encodeName(cacheDir.path()));
+
+    const QString scriptPath = sourceDir.path() + QLatin1String("/script.js");
+    const QString qmlPath = sourceDir.path() + QLatin1String("/main.qml");
+    QVERIFY(writeFile(qmlPath, "import QtQml 2.0\n"
+                               "import \"script.js\" as Script\n"
+                               "QtObject { property int value: Script.value(10) }\n"));
+    QVERIFY(writeFile(scriptPath, "function value(x) { var s = 0; for (var i = 0; i < x; ++i) s += i; return s < 40 ? s + 'x' : s - 3; }\n"));
+
+    QCOMPARE(loadValue(qmlPath), 42);
+    QCOMPARE(loadValue(qmlPath), 42);
+
+    const QString cacheFile = QQmlDiskCache::cacheFilePath(QUrl::fromLocalFile(scriptPath));
+    QVERIFY(QFile::exists(cacheFile));
+
+    // A changed source must not pick up the stale entry
+    QVERIFY(writeFile(scriptPath, "function value(x) { return x * 4; }\n"));
+    QCOMPARE(loadValue(qmlPath), 40);
+    QCOMPARE(loadValue(qmlPath), 40);
+
+    // Neither must a corrupted one be used
+    QFile file(cacheFile);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.seek(file.size() / 2));
+    file.write(QByteArray(int(file.size() / 2), '\xff'));
+    file.close();
+    QCOMPARE(loadValue(qmlPath), 40);
+
+    qunsetenv("QML_DISK_CACHE_PATH");
+}
+
+void tst_QQMLTypeLoader::precompiledScripts()
+{
+    QTemporaryDir cacheDir;
+    QTemporaryDir sourceDir;
+    QVERIFY(cacheDir.isValid());
+    QVERIFY(sourceDir.isValid());
+    qputenv("QML_DISK_CACHE_PATH", QFile::encodeName(cacheDir.path()));
+
+    const QString scriptPath = sourceDir.path() + QLatin1String("/script.js");
+    const QString qmlPath = sourceDir.path() + QLatin1String("/main.qml");
+    const QUrl scriptUrl = QUrl::fromLocalFile(scriptPath);
+    const QByteArray source = ".pragma library\nvar base = 40;\nfunction value(x) { return base + x / 5; }\n";
+    QVERIFY(writeFile(qmlPath, "import QtQml 2.0\n"
+                               "import \"script.js\" as Script\n"
+                               "QtObject { property int value: Script.value(10) }\n"));
+    QVERIFY(writeFile(scriptPath, source));
+
+    // What qmlcachegen does, with the interpreter, whose code can be stored
+    {
+        QV4::ExecutionEngine v4(new QV4::Moth::ISelFactory);
+        QList<QQmlError> errors;
+        QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit = QQmlDiskCache::compileScript(&v4, scriptUrl, QString::fromUtf8(source), &errors);
+        QVERIFY(errors.isEmpty());
+        const QByteArray key = QQmlDiskCache::key(&v4, scriptUrl, source);
+        QString errorString;
+        QVERIFY2(QQmlDiskCache::writeFile(unit, QQmlDiskCache::precompiledFilePath(scriptUrl), key, &errorString), qPrintable(errorString));
+        QCOMPARE(QQmlDiskCache::precompiledFilePath(scriptUrl), scriptPath + QLatin1Char('c'));
+
+        QQmlRefPointer<QV4::CompiledData::CompilationUnit> loaded = QQmlDiskCache::load(&v4, scriptUrl, key);
+        QVERIFY(loaded);
+        QVERIFY(loaded->data->flags & QV4::CompiledData::Unit::IsSharedLibrary);
+        QCOMPARE(loaded->data->functionTableSize, unit->data->functionTableSize);
+        QCOMPARE(loaded->fileName(), unit->fileName());
+        QVERIFY(!QQmlDiskCache::load(&v4, scriptUrl, QCryptographicHash::hash("stale", QCryptographicHash::Sha1)));
+    }
+
+    QCOMPARE(loadValue(qmlPath), 42);
+    // The precompiled file was used, so nothing was compiled and written to the cache
+    QVERIFY(QDir(cacheDir.path()).entryList(QDir::Files).isEmpty());
+
+    // A changed source must not use the precompiled file
+    QVERIFY(writeFile(scriptPath, "function value(x) { return x; }\n"));
+    QCOMPARE(loadValue(qmlPath), 10);
+
+    qunsetenv("QML_DISK_CACHE_PATH");
+}
+
 QTEST_MAIN(tst_QQMLTypeLoader)
 
 #include "tst_qqmltypeloader.moc"
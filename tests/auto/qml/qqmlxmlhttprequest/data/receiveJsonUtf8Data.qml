@@ -0,0 +1,25 @@
+import QtQuick 2.0
+
+QtObject {
+    property string url;
+    property bool result: false
+
+    Component.onCompleted: {
+        var request = new XMLHttpRequest();
+        request.open("GET", url, true);
+        request.responseType = "json";
+
+        request.onreadystatechange = function() {
+            if (request.readyState == XMLHttpRequest.DONE) {
+                // "Ã©" in UTF-16 and "é" in UTF-8 share their code units
+                var records = request.response;
+                result = records.length == 2
+                        && records[0]["Ã©"] === 1 && records[0].name === "café"
+                        && records[1]["é"] === 2 && records[1].name === "€"
+                        && !("Ã©" in records[1]);
+            }
+        }
+
+        request.send(null);
+    }
+}
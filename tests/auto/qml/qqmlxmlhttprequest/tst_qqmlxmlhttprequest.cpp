@@ -89,6 +89,7 @@ private slots:
     void getAllResponseHeaders_args();
     void getBinaryData();
     void getJsonData();
+    void getJsonUtf8Data();
     void status();
     void status_data();
     void statusText();
@@ -871,6 +872,24 @@ void tst_qqmlxmlhttprequest::getJsonData()
     QTRY_VERIFY(object->property("result").toBool());
 }
 
+// The UTF-8 response is parsed without converting it first, after skipping the byte order mark
+void tst_qqmlxmlhttprequest::getJsonUtf8Data()
+{
+    TestHTTPServer server;
+    QVERIFY2(server.listen(), qPrintable(server.errorString()));
+    QVERIFY(server.wait(testFileUrl("receive_json_utf8_data.expect"),
+                        testFileUrl("receive_binary_data.reply"),
+                        testFileUrl("json_utf8.data")));
+
+    QQmlComponent component(&engine, testFileUrl("receiveJsonUtf8Data.qml"));
+    QScopedPointer<QObject> object(component.beginCreate(engine.rootContext()));
+    QVERIFY(!object.isNull());
+    object->setProperty("url", server.urlString("/json_utf8.data"));
+    component.completeCreate();
+
+    QTRY_VERIFY(object->property("result").toBool());
+}
+
 void tst_qqmlxmlhttprequest::status()
 {
     QFETCH(QUrl, replyUrl);
@@ -96,6 +96,8 @@ private slots:
     void toStringHandle();
 #endif
     void castValueToQreal();
+    void stringKeyLookup_data();
+    void stringKeyLookup();
 #if 0 // no native functions for now
     void nativeCall();
 #endif
@@ -437,6 +439,42 @@ void tst_QJSEngine::castValueToQreal()
     }
 }
 
+void tst_QJSEngine::stringKeyLookup_data()
+{
+    QTest::addColumn<int>("keyLength");
+    QTest::newRow("8 characters") << 8;
+    QTest::newRow("32 characters") << 32;
+    QTest::newRow("128 characters") << 128;
+    QTest::newRow("1024 characters") << 1024;
+}
+
+// Every lookup builds a new key, so the hash and the comparison with the stored key can't be
+// taken from a cache.
+void tst_QJSEngine::stringKeyLookup()
+{
+    QFETCH(int, keyLength);
+    newEngine();
+    QJSValue run = m_engine->evaluate(QString::fromLatin1(
+            "(function(length) {\n"
+            "    var prefix = new Array(length - 2).join('k');\n"
+            "    var o = {};\n"
+            "    for (var i = 100; i < 200; ++i)\n"
+            "        o[prefix + i] = i;\n"
+            "    return function() {\n"
+            "        var sum = 0;\n"
+            "        for (var i = 100; i < 200; ++i)\n"
+            "            sum += o[prefix + i];\n"
+            "        return sum;\n"
+            "    };\n"
+            "})")).call(QJSValueList() << keyLength);
+    QVERIFY(run.isCallable());
+    QCOMPARE(run.call().toInt(), 14950);
+
+    QBENCHMARK {
+        (void)run.call();
+    }
+}
+
 #if 0
 static QJSValue native_function(QScriptContext *, QJSEngine *)
 {
@@ -0,0 +1,276 @@
+/****************************************************************************
+**
+** Copyright (C) 2015 The Qt Company Ltd.
+** Contact: http://www.qt.io/licensing/
+**
+** This file is part of the tools applications of the Qt Toolkit.
+**
+** $QT_BEGIN_LICENSE:LGPL21$
+** Commercial License Usage
+** Licensees holding valid commercial Qt licenses may use this file in
+** accordance with the commercial license agreement provided with the
+** Software or, alternatively, in accordance with the terms contained in
+** a written agreement between you and The Qt Company. For licensing terms
+** and conditions see http://www.qt.io/terms-conditions. For further
+** information use the contact form at http://www.qt.io/contact-us.
+**
+** GNU Lesser General Public License Usage
+** Alternatively, this file may be used under the terms of the GNU Lesser
+** General Public License version 2.1 or version 3 as published by the Free
+** Software Foundation and appearing in the file LICENSE.LGPLv21 and
+** LICENSE.LGPLv3 included in the packaging of this file. Please review the
+** following information to ensure the GNU Lesser General Public License
+** requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+** http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+**
+** As a special exception, The Qt Company gives you certain additional
+** rights. These rights are described in The Qt Company LGPL Exception
+** version 1.1, included in the file LGPL_EXCEPTION.txt in this package.
+**
+** $QT_END_LICENSE$
+**
+****************************************************************************/
+
+#include <private/qqmldiskcache_p.h>
+#include <private/qv4engine_p.h>
+#include <private/qv4isel_moth_p.h>
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QCommandLineParser>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QXmlStreamReader>
+#include <QtCore/QXmlStreamWriter>
+
+#include <stdio.h>
+
+QT_USE_NAMESPACE
+
+namespace {
+
+struct ResourceEntry
+{
+    QString prefix;
+    QString alias;
+    QString file;
+};
+
+bool isJavaScriptFile(const QString &fileName)
+{
+    return fileName.endsWith(QLatin1String(".js"), Qt::CaseInsensitive);
+}
+
+bool isQmlFile(const QString &fileName)
+{
+    return fileName.endsWith(QLatin1String(".qml"), Qt::CaseInsensitive);
+}
+
+void printError(const QString &message)
+{
+    fprintf(stderr, "qmlcachegen: %s\n", qPrintable(message));
+}
+
+// Compiles the script at sourcePath as if it was loaded from url and writes the result in the
+// format the disk cache of the type loader reads.
+bool compileScript(QV4::ExecutionEngine *engine, const QString &sourcePath, const QUrl &url, const QString &outputPath)
+{
+    QFile file(sourcePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        printError(sourcePath + QLatin1String(": ") + file.errorString());
+        return false;
+    }
+    const QByteArray source = file.readAll();
+
+    const QByteArray key = QQmlDiskCache::key(engine, url, source);
+    if (key.isEmpty()) {
+        printError(QLatin1String("The disk cache is disabled in this environment"));
+        return false;
+    }
+
+    QList<QQmlError> errors;
+    QQmlRefPointer<QV4::CompiledData::CompilationUnit> unit = QQmlDiskCache::compileScript(engine, url, QString::fromUtf8(source), &errors);
+    if (!errors.isEmpty()) {
+        foreach (const QQmlError &error, errors)
+            fprintf(stderr, "%s\n", qPrintable(error.toString()));
+        return false;
+    }
+
+    QString errorString;
+    if (!QDir().mkpath(QFileInfo(outputPath).absolutePath())) {
+        printError(QLatin1String("Cannot create directory for ") + outputPath);
+        return false;
+    }
+    if (!QQmlDiskCache::writeFile(unit, outputPath, key, &errorString)) {
+        printError(outputPath + QLatin1String(": ") + errorString);
+        return false;
+    }
+    return true;
+}
+
+bool readResourceFile(const QString &qrcPath, QList<ResourceEntry> *entries)
+{
+    QFile file(qrcPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        printError(qrcPath + QLatin1String(": ") + file.errorString());
+        return false;
+    }
+
+    QXmlStreamReader reader(&file);
+    QString prefix;
+    while (!reader.atEnd()) {
+        if (reader.readNext() != QXmlStreamReader::StartElement)
+            continue;
+        if (reader.name() == QLatin1String("qresource")) {
+            prefix = reader.attributes().value(QLatin1String("prefix")).toString();
+        } else if (reader.name() == QLatin1String("file")) {
+            ResourceEntry entry;
+            entry.prefix = prefix;
+            entry.alias = reader.attributes().value(QLatin1String("alias")).toString();
+            entry.file = reader.readElementText().trimmed();
+            if (entry.alias.isEmpty())
+                entry.alias = entry.file;
+            entries->append(entry);
+        }
+    }
+    if (reader.hasError()) {
+        printError(qrcPath + QLatin1String(": ") + reader.errorString());
+        return false;
+    }
+    return true;
+}
+
+// Compiles all scripts listed in a resource file and writes a new resource file next to the
+// compiled scripts, which adds them under the path of their source plus 'c'. Adding that file
+// to the application lets the type loader find the compiled scripts.
+bool compileResourceFile(QV4::ExecutionEngine *engine, const QString &qrcPath, const QString &outputDirectory)
+{
+    QList<ResourceEntry> entries;
+    if (!readResourceFile(qrcPath, &entries))
+        return false;
+
+    const QFileInfo qrcInfo(qrcPath);
+    const QDir sourceDirectory = qrcInfo.absoluteDir();
+    const QDir outputDir(outputDirectory.isEmpty() ? sourceDirectory.absolutePath() : outputDirectory);
+
+    QList<ResourceEntry> compiled;
+    bool success = true;
+    foreach (const ResourceEntry &entry, entries) {
+        if (!isJavaScriptFile(entry.file))
+            continue;
+
+        QString resourcePath = QDir::cleanPath(entry.prefix + QLatin1Char('/') + entry.alias);
+        if (!resourcePath.startsWith(QLatin1Char('/')))
+            resourcePath.prepend(QLatin1Char('/'));
+        const QUrl url(QLatin1String("qrc:") + resourcePath);
+
+        ResourceEntry output;
+        output.prefix = entry.prefix;
+        output.alias = entry.alias + QLatin1Char('c');
+        output.file = QDir::cleanPath(entry.file) + QLatin1Char('c');
+        if (!compileScript(engine, sourceDirectory.filePath(entry.file), url, outputDir.filePath(output.file))) {
+            success = false;
+            continue;
+        }
+        compiled.append(output);
+    }
+    if (!success)
+        return false;
+
+    const QString outputQrcPath = outputDir.filePath(qrcInfo.completeBaseName() + QLatin1String("_qmlcache.qrc"));
+    QFile outputQrc(outputQrcPath);
+    if (!outputQrc.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        printError(outputQrcPath + QLatin1String(": ") + outputQrc.errorString());
+        return false;
+    }
+
+    QXmlStreamWriter writer(&outputQrc);
+    writer.setAutoFormatting(true);
+    writer.writeStartElement(QLatin1String("RCC"));
+    for (int i = 0; i < compiled.count(); ) {
+        const QString prefix = compiled.at(i).prefix;
+        writer.writeStartElement(QLatin1String("qresource"));
+        if (!prefix.isEmpty())
+            writer.writeAttribute(QLatin1String("prefix"), prefix);
+        for (; i < compiled.count() && compiled.at(i).prefix == prefix; ++i) {
+            writer.writeStartElement(QLatin1String("file"));
+            writer.writeAttribute(QLatin1String("alias"), compiled.at(i).alias);
+            writer.writeCharacters(compiled.at(i).file);
+            writer.writeEndElement();
+        }
+        writer.writeEndElement();
+    }
+    writer.writeEndElement();
+    writer.writeEndDocument();
+    return true;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationVersion(QLatin1String(QT_VERSION_STR));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QLatin1String("Compiles the JavaScript files of a QML application ahead of time.\n\n"
+                                                   "For a file foo.js, foo.jsc is written, which is loaded instead of compiling foo.js "
+                                                   "as long as the source and the Qt build stay the same. For a resource file, "
+                                                   "all listed scripts are compiled and a resource file adding the results is written. "
+                                                   "QML documents are still compiled when they are loaded.\n\n"
+                                                   "The compiled files are only used when QML_ENABLE_DISK_CACHE is set, by engines "
+                                                   "running the interpreter, on the Qt build that wrote them: the key of each file includes the Qt version and build "
+                                                   "configuration, including the architecture. When cross-compiling, run the qmlcachegen "
+                                                   "built for the target on the target or under emulation, for example as a deployment "
+                                                   "step. Files written by another build are ignored and the sources compiled instead."));
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption outputDirectoryOption(QStringList() << QLatin1String("o") << QLatin1String("output-directory"),
+                                             QLatin1String("Write compiled files to <directory> instead of next to the sources."),
+                                             QLatin1String("directory"));
+    parser.addOption(outputDirectoryOption);
+    QCommandLineOption urlOption(QLatin1String("url"),
+                                 QLatin1String("The URL the single script file is loaded from at run-time. Defaults to its file URL."),
+                                 QLatin1String("url"));
+    parser.addOption(urlOption);
+    parser.addPositionalArgument(QLatin1String("files"), QLatin1String("JavaScript or resource files to compile."), QLatin1String("files..."));
+
+    parser.process(app);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty())
+        parser.showHelp(1);
+    if (parser.isSet(urlOption) && (files.count() != 1 || !isJavaScriptFile(files.first()))) {
+        printError(QLatin1String("--url requires exactly one JavaScript file"));
+        return 1;
+    }
+
+    const QString outputDirectory = parser.value(outputDirectoryOption);
+
+    // The interpreter's code is position independent, which is what the disk cache stores. Only
+    // engines running the interpreter load it, the JIT compiles scripts from their source.
+    QV4::ExecutionEngine engine(new QV4::Moth::ISelFactory);
+
+    bool success = true;
+    foreach (const QString &file, files) {
+        if (file.endsWith(QLatin1String(".qrc"), Qt::CaseInsensitive)) {
+            success &= compileResourceFile(&engine, file, outputDirectory);
+        } else if (isJavaScriptFile(file)) {
+            const QUrl url = parser.isSet(urlOption) ? QUrl(parser.value(urlOption))
+                                                     : QUrl::fromLocalFile(QFileInfo(file).absoluteFilePath());
+            const QString outputPath = outputDirectory.isEmpty() ? file + QLatin1Char('c')
+                                                                 : QDir(outputDirectory).filePath(QFileInfo(file).fileName() + QLatin1Char('c'));
+            success &= compileScript(&engine, file, url, outputPath);
+        } else if (isQmlFile(file)) {
+            // The type loader can't build a QML document from a compiled unit yet, see
+            // QmlIR::IRLoader, so there is nothing it could load
+            fprintf(stderr, "qmlcachegen: %s: QML documents can't be precompiled yet, skipping\n", qPrintable(file));
+        } else {
+            printError(file + QLatin1String(": unknown file type"));
+            success = false;
+        }
+    }
+
+    return success ? 0 : 1;
+}
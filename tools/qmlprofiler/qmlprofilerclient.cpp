@@ -220,6 +220,9 @@ void QmlProfilerClient::messageReceived(const QByteArray &data)
         qint64 delta;
         stream >> type >> delta;
         emit memoryAllocation((QQmlProfilerDefinitions::MemoryType)type, time, delta);
+    } else if (messageType == QQmlProfilerDefinitions::GarbageCollection) {
+        // The trace file format has no place for GC pauses yet. Skip them.
+        return;
     } else {
         int range;
         stream >> range;
@@ -64,7 +64,8 @@ static const char *MESSAGE_STRINGS[] = {
     "Complete",
     "PixmapCache",
     "SceneGraph",
-    "MemoryAllocation"
+    "MemoryAllocation",
+    "GarbageCollection"
 };
 
 Q_STATIC_ASSERT(sizeof(MESSAGE_STRINGS) ==
@@ -10,7 +10,8 @@ qmlimportscanner.CONFIG = host_build
     SUBDIRS += \
         qml \
         qmlprofiler \
-        qmllint
+        qmllint \
+        qmlcachegen
     qtHaveModule(quick) {
         !static: SUBDIRS += qmlscene qmlplugindump
         qtHaveModule(widgets): SUBDIRS += qmleasing
@@ -26,6 +27,7 @@ qmleasing.depends = qmlimportscanner
 # qmlscene is needed by the autotests.
 # qmltestrunner may be useful for manual testing.
 # qmlplugindump cannot be a build tool, because it loads target plugins.
+# qmlcachegen cannot be a build tool, because it writes code for the target's interpreter.
 # The other apps are mostly "desktop" tools and are thus excluded.
 qtNomakeTools( \
     qmlprofiler \